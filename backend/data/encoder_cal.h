@@ -2,17 +2,147 @@
 #define ENCODER_CAL_H
 
 #include <cJSON.h>
+#include <esp_attr.h>
 #include <esp_err.h>
+#include <esp_rom_crc.h>
+#include <nvs.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 #include "../encoder.h"
 #include "../utils.h"
 
-static cJSON *encoder_cal_to_json(const encoder_state_t *state) {
-  cJSON *root = cJSON_CreateObject();
-  if (!root) return NULL;
-  cJSON_AddNumberToObject(root, "cal_state", state->cal_state);
-  cJSON_AddNumberToObject(root, "cal_dir", state->cal_dir);
-  cJSON_AddNumberToObject(root, "max_distance", state->max_distance);
-  return root;
+/*
+ * Calibration is stored as a fixed-size binary record: in NVS for cold boots, and in RTC memory
+ * that survives warm resets. Besides the calibrated range the record keeps the logical position
+ * (start_count and the position offset). The RTC record follows every position update, so a warm
+ * reset resumes tracking where it was. NVS is only written when the calibration changes, to spare
+ * the flash a write per rep, so after a cold boot the position is where the bar was at that change
+ * and may need zeroing. The JSON files are only read to import calibrations saved by older
+ * firmware.
+ */
+
+#define ENCODER_CAL_NVS_NAMESPACE "encoder_cal"
+#define ENCODER_CAL_RECORD_MAGIC 0x4C414345 // "ECAL"
+#define ENCODER_CAL_RECORD_VERSION 1
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  uint8_t cal_state;
+  uint8_t cal_dir;
+  uint8_t resolution;
+  uint8_t reserved;
+  int32_t start_count;
+  int32_t max_distance;
+  int32_t position; // raw_count + offset when the record was written
+  uint32_t crc;     // CRC32 of everything above
+} encoder_cal_record_t;
+
+static RTC_NOINIT_ATTR encoder_cal_record_t encoder_cal_rtc_records[ENCODER_MAX_COUNT];
+
+static inline uint32_t encoder_cal_record_crc(const encoder_cal_record_t *record) {
+  return esp_rom_crc32_le(0, (const uint8_t *) record, offsetof(encoder_cal_record_t, crc));
+}
+
+static void encoder_cal_record_from_state(encoder_cal_record_t *record,
+                                          const encoder_state_t *state) {
+  memset(record, 0, sizeof(*record));
+  record->magic = ENCODER_CAL_RECORD_MAGIC;
+  record->version = ENCODER_CAL_RECORD_VERSION;
+  record->size = sizeof(*record);
+  record->cal_state = (uint8_t) state->cal_state;
+  record->cal_dir = (uint8_t) state->cal_dir;
+  record->resolution = (uint8_t) state->resolution;
+  record->start_count = state->start_count;
+  record->max_distance = state->max_distance;
+  record->position = state->raw_count + state->offset;
+  record->crc = encoder_cal_record_crc(record);
+}
+
+// Same calibration, whatever the position; the position alone is not worth a flash write
+static bool encoder_cal_record_same_calibration(const encoder_cal_record_t *a,
+                                                const encoder_cal_record_t *b) {
+  return a->cal_state == b->cal_state && a->cal_dir == b->cal_dir &&
+         a->resolution == b->resolution && a->start_count == b->start_count &&
+         a->max_distance == b->max_distance;
+}
+
+static bool encoder_cal_record_valid(const encoder_cal_record_t *record) {
+  return record->magic == ENCODER_CAL_RECORD_MAGIC &&
+         record->version == ENCODER_CAL_RECORD_VERSION && record->size == sizeof(*record) &&
+         record->cal_state <= CAL_DONE && record->crc == encoder_cal_record_crc(record);
+}
+
+// Counters restart at zero, so the saved position becomes the offset
+static void encoder_cal_record_to_state(const encoder_cal_record_t *record,
+                                        encoder_state_t *state) {
+  memset(state, 0, sizeof(*state));
+  state->cal_state = (calibration_state_t) record->cal_state;
+  state->cal_dir = (rotation_dir_t) record->cal_dir;
+  state->resolution = record->resolution;
+  state->start_count = record->start_count;
+  state->max_distance = record->max_distance;
+  state->offset = record->position;
+  state->calibrated = CAL_MIN;
+}
+
+static inline void encoder_cal_nvs_key(uint8_t id, char *key, size_t key_len) {
+  snprintf(key, key_len, "enc%u", (unsigned) id);
+}
+
+esp_err_t encoder_cal_load_nvs(uint8_t id, encoder_state_t *state) {
+  if (!state) return ESP_ERR_INVALID_ARG;
+
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(ENCODER_CAL_NVS_NAMESPACE, NVS_READONLY, &handle);
+  if (err != ESP_OK) return err;
+
+  char key[8];
+  encoder_cal_nvs_key(id, key, sizeof(key));
+  encoder_cal_record_t record;
+  size_t len = sizeof(record);
+  err = nvs_get_blob(handle, key, &record, &len);
+  nvs_close(handle);
+  if (err != ESP_OK) return err;
+  if (len != sizeof(record) || !encoder_cal_record_valid(&record)) return ESP_ERR_INVALID_CRC;
+
+  encoder_cal_record_to_state(&record, state);
+  return ESP_OK;
+}
+
+esp_err_t encoder_cal_save_nvs(uint8_t id, const encoder_state_t *state) {
+  if (!state) return ESP_ERR_INVALID_ARG;
+
+  encoder_cal_record_t record;
+  encoder_cal_record_from_state(&record, state);
+
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(ENCODER_CAL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) return err;
+
+  char key[8];
+  encoder_cal_nvs_key(id, key, sizeof(key));
+  // NVS skips the flash write when the blob is unchanged
+  err = nvs_set_blob(handle, key, &record, sizeof(record));
+  if (err == ESP_OK) err = nvs_commit(handle);
+  nvs_close(handle);
+  return err;
+}
+
+// Cheap enough to call on every position update; only RAM is written
+static inline void encoder_cal_save_rtc(uint8_t id, const encoder_state_t *state) {
+  if (!state || id >= ENCODER_MAX_COUNT) return;
+  encoder_cal_record_from_state(&encoder_cal_rtc_records[id], state);
+}
+
+esp_err_t encoder_cal_load_rtc(uint8_t id, encoder_state_t *state) {
+  if (!state || id >= ENCODER_MAX_COUNT) return ESP_ERR_INVALID_ARG;
+  if (!encoder_cal_record_valid(&encoder_cal_rtc_records[id])) return ESP_ERR_NOT_FOUND;
+
+  encoder_cal_record_to_state(&encoder_cal_rtc_records[id], state);
+  return ESP_OK;
 }
 
 static void encoder_cal_from_json(encoder_state_t *state, const cJSON *root) {
@@ -20,13 +150,16 @@ static void encoder_cal_from_json(encoder_state_t *state, const cJSON *root) {
   const cJSON *cal_state = cJSON_GetObjectItem(root, "cal_state");
   const cJSON *cal_dir = cJSON_GetObjectItem(root, "cal_dir");
   const cJSON *max_distance = cJSON_GetObjectItem(root, "max_distance");
+  const cJSON *resolution = cJSON_GetObjectItem(root, "resolution");
   if (cJSON_IsNumber(cal_state)) state->cal_state = (calibration_state_t)cal_state->valueint;
   if (cJSON_IsNumber(cal_dir)) state->cal_dir = (rotation_dir_t)cal_dir->valueint;
   if (cJSON_IsNumber(max_distance)) state->max_distance = max_distance->valueint;
+  state->resolution = cJSON_IsNumber(resolution) ? resolution->valueint : ENCODER_RESOLUTION_1X;
   state->start_count = 0;
-  state->calibrated = 0.0;
+  state->calibrated = CAL_MIN;
 }
 
+// Imports a calibration saved as JSON by older firmware
 esp_err_t encoder_cal_load_file(const char *path, encoder_state_t *state) {
     if (!state || !path) return ESP_ERR_INVALID_ARG;
     cJSON *root = cjson_read_from_file(path);
@@ -36,14 +169,4 @@ esp_err_t encoder_cal_load_file(const char *path, encoder_state_t *state) {
     return ESP_OK;
 }
 
-esp_err_t encoder_cal_save_file(const char *path, const encoder_state_t *state) {
-    if (!state || !path) return ESP_ERR_INVALID_ARG;
-    cJSON *root = encoder_cal_to_json(state);
-    if (!root) return ESP_ERR_NO_MEM;
-    int res = cjson_save_to_file(root, path);
-    cJSON_Delete(root);
-    return res == 0 ? ESP_OK : ESP_FAIL;
-}
-
-
 #endif
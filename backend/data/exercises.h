@@ -8,6 +8,8 @@
 #include <uuid.h>
 
 #define EXERCISE_DEFAULT_REP_BAND 10.0
+#define EXERCISE_DEFAULT_VELOCITY_LOSS 0.0
+#define EXERCISE_VELOCITY_LOSS_KEEP -1.0 // exercises_add(): leave the stored value untouched
 
 typedef enum { EXERCISE_SINGULAR, EXERCISE_ALTERNATING, EXERCISE_UNKNOWN } exercise_type_t;
 
@@ -106,7 +108,8 @@ int exercises_add(cJSON *root,
                   double thresholdPercentage,
                   exercise_type_t type,
                   const char *category_id,
-                  double rep_band) {
+                  double rep_band,
+                  double velocity_loss) {
   cJSON *exercises = cJSON_GetObjectItemCaseSensitive(root, "exercises");
   if (!cJSON_IsArray(exercises)) {
     return EXIT_FAILURE;
@@ -153,6 +156,17 @@ int exercises_add(cJSON *root,
                                   cJSON_CreateNumber(rep_band));
       }
 
+      if (velocity_loss >= 0) {
+        cJSON *velocity_loss_item = cJSON_GetObjectItemCaseSensitive(exercise, "velocityLoss");
+        if (cJSON_IsNumber(velocity_loss_item)) {
+          velocity_loss_item->valuedouble = velocity_loss;
+        } else if (velocity_loss_item) {
+          cJSON_ReplaceItemInObject(exercise, "velocityLoss", cJSON_CreateNumber(velocity_loss));
+        } else {
+          cJSON_AddNumberToObject(exercise, "velocityLoss", velocity_loss);
+        }
+      }
+
       return EXIT_SUCCESS;
     }
   }
@@ -162,6 +176,8 @@ int exercises_add(cJSON *root,
   cJSON_AddNumberToObject(new_exercise, "thresholdPercentage", thresholdPercentage);
   cJSON_AddStringToObject(new_exercise, "type", exercise_type_to_string(type));
   cJSON_AddNumberToObject(new_exercise, "repBand", rep_band);
+  cJSON_AddNumberToObject(new_exercise, "velocityLoss",
+                          velocity_loss >= 0 ? velocity_loss : EXERCISE_DEFAULT_VELOCITY_LOSS);
   if (category_id && strlen(category_id) > 0) {
     cJSON_AddStringToObject(new_exercise, "categoryId", category_id);
   }
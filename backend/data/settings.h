@@ -2,10 +2,15 @@
 #define SETTINGS_H
 
 #include <cJSON.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #define DEBOUNCE_MS 100
 #define CALIBRATION_DEBOUNCE_STEPS_DEFAULT 25
+#define ENCODER_DRIVER_DEFAULT "gpio"
+#define ENCODER_SAMPLE_PERIOD_MS_DEFAULT 5
+#define ENCODER_RESOLUTION_DEFAULT 1
+#define WS_FRAME_RATE_DEFAULT 60
 #define DEFAULT_HOSTNAME "esp-lift.arpa"
 
 typedef struct {
@@ -15,6 +20,11 @@ typedef struct {
 
   int debounce_interval;
   int calibration_debounce_steps;
+  const char *encoder_driver;
+  int encoder_sample_period_ms;
+  int encoder_resolution;
+  bool rep_on_return; // report reps at the end of the cycle, with eccentric kinematics
+  int ws_frame_rate;  // WebSocket flushes per second; positions coalesce in between
 } settings_t;
 
 static inline void settings_extract_hostname(cJSON *settings_json, char *out, size_t out_len) {
@@ -32,6 +42,11 @@ static inline void settings_extract_hostname(cJSON *settings_json, char *out, si
 int config_load_settings(cJSON *root, settings_t *settings) {
   settings->debounce_interval = DEBOUNCE_MS;
   settings->calibration_debounce_steps = CALIBRATION_DEBOUNCE_STEPS_DEFAULT;
+  settings->encoder_driver = ENCODER_DRIVER_DEFAULT;
+  settings->encoder_sample_period_ms = ENCODER_SAMPLE_PERIOD_MS_DEFAULT;
+  settings->encoder_resolution = ENCODER_RESOLUTION_DEFAULT;
+  settings->rep_on_return = false;
+  settings->ws_frame_rate = WS_FRAME_RATE_DEFAULT;
 
   const cJSON *network = cJSON_GetObjectItem(root, "network");
   if (cJSON_IsObject(network)) {
@@ -51,16 +66,38 @@ int config_load_settings(cJSON *root, settings_t *settings) {
     const cJSON *debounce_interval = cJSON_GetObjectItem(movement, "debounceInterval");
     const cJSON *calibration_debounce_steps =
       cJSON_GetObjectItem(movement, "calibrationDebounceSteps");
+    const cJSON *encoder_driver = cJSON_GetObjectItem(movement, "encoderDriver");
+    const cJSON *encoder_sample_period = cJSON_GetObjectItem(movement, "encoderSamplePeriod");
+    const cJSON *encoder_resolution = cJSON_GetObjectItem(movement, "encoderResolution");
+    const cJSON *rep_on_return = cJSON_GetObjectItem(movement, "repOnReturn");
+    const cJSON *ws_frame_rate = cJSON_GetObjectItem(movement, "wsFrameRate");
 
     settings->debounce_interval = cJSON_IsNumber(debounce_interval) ? debounce_interval->valueint : DEBOUNCE_MS;
     settings->calibration_debounce_steps = cJSON_IsNumber(calibration_debounce_steps)
       ? calibration_debounce_steps->valueint
       : CALIBRATION_DEBOUNCE_STEPS_DEFAULT;
+    settings->encoder_driver =
+      cJSON_IsString(encoder_driver) ? encoder_driver->valuestring : ENCODER_DRIVER_DEFAULT;
+    settings->encoder_sample_period_ms = cJSON_IsNumber(encoder_sample_period)
+      ? encoder_sample_period->valueint
+      : ENCODER_SAMPLE_PERIOD_MS_DEFAULT;
+    settings->encoder_resolution = cJSON_IsNumber(encoder_resolution)
+      ? encoder_resolution->valueint
+      : ENCODER_RESOLUTION_DEFAULT;
+    settings->rep_on_return = cJSON_IsTrue(rep_on_return);
+    settings->ws_frame_rate =
+      cJSON_IsNumber(ws_frame_rate) ? ws_frame_rate->valueint : WS_FRAME_RATE_DEFAULT;
   }
 
   return EXIT_SUCCESS;
 }
 
+static void settings_put_item(cJSON *dst, const char *key, const cJSON *item) {
+  cJSON *copy = cJSON_Duplicate(item, 1);
+  if (!copy) return;
+  if (!cJSON_ReplaceItemInObject(dst, key, copy)) cJSON_AddItemToObject(dst, key, copy);
+}
+
 int config_change_settings(cJSON *root, cJSON *patch) {
   const cJSON *network = cJSON_GetObjectItem(patch, "network");
   if (cJSON_IsObject(network)) {
@@ -92,6 +129,26 @@ int config_change_settings(cJSON *root, cJSON *patch) {
     if ((item = cJSON_GetObjectItem(movement, "calibrationDebounceSteps")))
       if (cJSON_IsNumber(item))
         cJSON_ReplaceItemInObject(dst, "calibrationDebounceSteps", cJSON_Duplicate(item, 1));
+
+    if ((item = cJSON_GetObjectItem(movement, "encoderDriver")))
+      if (cJSON_IsString(item))
+        settings_put_item(dst, "encoderDriver", item);
+
+    if ((item = cJSON_GetObjectItem(movement, "encoderSamplePeriod")))
+      if (cJSON_IsNumber(item))
+        settings_put_item(dst, "encoderSamplePeriod", item);
+
+    if ((item = cJSON_GetObjectItem(movement, "encoderResolution")))
+      if (cJSON_IsNumber(item))
+        settings_put_item(dst, "encoderResolution", item);
+
+    if ((item = cJSON_GetObjectItem(movement, "repOnReturn")))
+      if (cJSON_IsBool(item))
+        settings_put_item(dst, "repOnReturn", item);
+
+    if ((item = cJSON_GetObjectItem(movement, "wsFrameRate")))
+      if (cJSON_IsNumber(item))
+        settings_put_item(dst, "wsFrameRate", item);
   }
 
   return EXIT_SUCCESS;
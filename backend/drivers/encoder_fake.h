@@ -0,0 +1,167 @@
+#ifndef ENCODER_FAKE_H
+#define ENCODER_FAKE_H
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+
+#include "../encoder.h"
+#endif
+
+#include "quadrature.h"
+
+/*
+ * Software backend with no hardware attached. A simulated shaft drives the A/B channel levels
+ * and they go through the same quadrature decoding as the GPIO backend, which lets the
+ * calibration and rep pipeline run on the linux target or without encoders wired. As a driver
+ * the shaft repeats encoder_fake_default_rep, sampled like the PCNT backend. The simulator
+ * itself has no IDF dependencies, so the host tests use it directly; the driver glue below is
+ * only built for ESP-IDF.
+ */
+
+#define ENCODER_FAKE_RESOLUTION_1X 1
+#define ENCODER_FAKE_RESOLUTION_4X 4
+#define ENCODER_FAKE_SAMPLE_PERIOD_MS_DEFAULT 5
+#define ENCODER_FAKE_TASK_STACK 2048
+
+typedef struct {
+  uint8_t phase; // position in the forward AB sequence
+  uint8_t ab;
+  int resolution;
+  int32_t position; // shaft position in channel edges from the start
+  int32_t count;
+  uint32_t illegal_transitions;
+} encoder_fake_t;
+
+// One rep of simulated motion: a rest at the bottom, a rise, a hold at the top and a descent
+typedef struct {
+  int32_t stroke_edges; // bottom to top
+  uint32_t rest_ms;
+  uint32_t up_ms;
+  uint32_t top_ms;
+  uint32_t down_ms;
+} encoder_fake_rep_t;
+
+static const encoder_fake_rep_t encoder_fake_default_rep = {
+  .stroke_edges = 4000, .rest_ms = 1500, .up_ms = 800, .top_ms = 300, .down_ms = 1200};
+
+static const uint8_t encoder_fake_sequence[4] = {0x0, 0x2, 0x3, 0x1};
+
+static inline void encoder_fake_init(encoder_fake_t *fake, int resolution) {
+  *fake = (encoder_fake_t) {.ab = encoder_fake_sequence[0], .resolution = resolution};
+}
+
+// Sets the channel levels and decodes the transition; returns the count change
+static inline int32_t encoder_fake_set_phase(encoder_fake_t *fake, uint8_t phase) {
+  uint8_t previous_ab = fake->ab;
+  fake->phase = phase & 3;
+  fake->ab = encoder_fake_sequence[fake->phase];
+
+  int8_t delta = fake->resolution == ENCODER_FAKE_RESOLUTION_4X
+                   ? quadrature_decode_4x(previous_ab, fake->ab)
+                   : quadrature_decode_1x(previous_ab, fake->ab);
+  if (delta == QUAD_ILLEGAL) {
+    fake->illegal_transitions++;
+    return 0;
+  }
+  fake->count += delta;
+  return delta;
+}
+
+/**
+ * Turns the shaft by edges channel edges, forward when positive. Returns the decoded count
+ * change: edges at 4x, a quarter of that at 1x.
+ */
+static inline int32_t encoder_fake_move(encoder_fake_t *fake, int32_t edges) {
+  int32_t decoded = 0;
+  int8_t step = edges < 0 ? -1 : 1;
+  for (int32_t i = edges < 0 ? -edges : edges; i > 0; i--) {
+    decoded += encoder_fake_set_phase(fake, (uint8_t) (fake->phase + step));
+  }
+  fake->position += edges;
+  return decoded;
+}
+
+// Turns the shaft to position channel edges from the start; returns the decoded count change
+static inline int32_t encoder_fake_move_to(encoder_fake_t *fake, int32_t position) {
+  return encoder_fake_move(fake, position - fake->position);
+}
+
+static inline uint32_t encoder_fake_rep_ms(const encoder_fake_rep_t *rep) {
+  return rep->rest_ms + rep->up_ms + rep->top_ms + rep->down_ms;
+}
+
+/**
+ * Shaft position, in edges above the bottom, at ms into the rep. Rise and descent are linear.
+ */
+static inline int32_t encoder_fake_rep_position(const encoder_fake_rep_t *rep, uint32_t ms) {
+  if (ms < rep->rest_ms) return 0;
+  ms -= rep->rest_ms;
+  if (ms < rep->up_ms) return (int32_t) ((int64_t) rep->stroke_edges * ms / rep->up_ms);
+  ms -= rep->up_ms;
+  if (ms < rep->top_ms) return rep->stroke_edges;
+  ms -= rep->top_ms;
+  if (ms < rep->down_ms) {
+    return rep->stroke_edges - (int32_t) ((int64_t) rep->stroke_edges * ms / rep->down_ms);
+  }
+  return 0;
+}
+
+/**
+ * Flips both channels at once, as a missed edge would look to the decoder.
+ */
+static inline int32_t encoder_fake_glitch(encoder_fake_t *fake) {
+  return encoder_fake_set_phase(fake, (uint8_t) (fake->phase + 2));
+}
+
+#ifdef ESP_PLATFORM
+
+static void encoder_fake_sample_task(void *arg) {
+  encoder_t *enc = (encoder_t *) arg;
+  encoder_fake_t *fake = (encoder_fake_t *) enc->driver_ctx;
+
+  int period_ms = enc->config.sample_period_ms > 0 ? enc->config.sample_period_ms
+                                                   : ENCODER_FAKE_SAMPLE_PERIOD_MS_DEFAULT;
+  TickType_t period_ticks = pdMS_TO_TICKS(period_ms);
+  if (period_ticks == 0) period_ticks = 1;
+  TickType_t started = xTaskGetTickCount();
+  TickType_t last_wake = started;
+  uint32_t rep_ms = encoder_fake_rep_ms(&encoder_fake_default_rep);
+
+  while (1) {
+    vTaskDelayUntil(&last_wake, period_ticks);
+
+    uint32_t ms = (uint32_t) pdTICKS_TO_MS(xTaskGetTickCount() - started) % rep_ms;
+    int32_t decoded =
+      encoder_fake_move_to(fake, encoder_fake_rep_position(&encoder_fake_default_rep, ms));
+    enc->state.illegal_transitions = fake->illegal_transitions;
+    if (decoded != 0) encoder_push_sample(enc, fake->count);
+  }
+}
+
+static esp_err_t encoder_fake_start(encoder_t *enc) {
+  encoder_fake_t *fake = calloc(1, sizeof(encoder_fake_t));
+  if (!fake) return ESP_ERR_NO_MEM;
+  encoder_fake_init(fake, enc->config.resolution == ENCODER_RESOLUTION_4X
+                            ? ENCODER_FAKE_RESOLUTION_4X
+                            : ENCODER_FAKE_RESOLUTION_1X);
+  enc->driver_ctx = fake;
+
+  if (xTaskCreate(encoder_fake_sample_task, "encoder_fake_sample", ENCODER_FAKE_TASK_STACK, enc, 6,
+                  NULL) != pdPASS) {
+    enc->driver_ctx = NULL;
+    free(fake);
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+static const encoder_driver_t encoder_driver_fake = {.name = "fake", .start = encoder_fake_start};
+
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef ENCODER_GPIO_H
+#define ENCODER_GPIO_H
+
+#include <driver/gpio.h>
+#include <esp_attr.h>
+#include <esp_err.h>
+#include <stdlib.h>
+
+#include "../encoder.h"
+#include "quadrature.h"
+
+/*
+ * Interrupt-per-edge backend. At 1x one falling edge on pin_a is one count and pin_b picks the
+ * direction. At 4x both channels interrupt on every edge and the transition table in
+ * quadrature.h decodes the previous/current AB pair; transitions where both channels flipped are
+ * counted as illegal. The ISR only updates the count and pushes it to the sample ring;
+ * calibration runs in the encoder service task.
+ */
+
+typedef struct {
+  uint8_t quad_state;
+} encoder_gpio_ctx_t;
+
+static inline uint8_t IRAM_ATTR encoder_gpio_read_ab(encoder_t *enc) {
+  return (uint8_t) ((gpio_get_level(enc->config.pin_a) << 1) | gpio_get_level(enc->config.pin_b));
+}
+
+static inline void IRAM_ATTR encoder_gpio_apply(encoder_t *enc, int32_t delta_raw) {
+  encoder_push_sample_from_isr(enc, enc->isr_count + delta_raw);
+}
+
+static void IRAM_ATTR encoder_gpio_rotation_handler(void *arg) {
+  encoder_t *enc = (encoder_t *) arg;
+  encoder_gpio_apply(enc, gpio_get_level(enc->config.pin_b) ? 1 : -1);
+}
+
+static void IRAM_ATTR encoder_gpio_quadrature_handler(void *arg) {
+  encoder_t *enc = (encoder_t *) arg;
+  encoder_gpio_ctx_t *ctx = (encoder_gpio_ctx_t *) enc->driver_ctx;
+
+  uint8_t ab = encoder_gpio_read_ab(enc);
+  int8_t delta_raw = quadrature_decode_4x(ctx->quad_state, ab);
+  ctx->quad_state = ab;
+
+  if (delta_raw == QUAD_ILLEGAL) {
+    enc->state.illegal_transitions++;
+    return;
+  }
+  if (delta_raw == 0) return;
+
+  encoder_gpio_apply(enc, delta_raw);
+}
+
+static esp_err_t encoder_gpio_start(encoder_t *enc) {
+  bool quadrature = enc->config.resolution == ENCODER_RESOLUTION_4X;
+
+  gpio_config_t io_conf = {};
+  io_conf.intr_type = GPIO_INTR_NEGEDGE;
+  io_conf.pin_bit_mask =
+    ((1ULL << (uint64_t) enc->config.pin_a) | (1ULL << (uint64_t) enc->config.pin_b) |
+     (1ULL << (uint64_t) enc->config.pin_z));
+  io_conf.mode = GPIO_MODE_INPUT;
+  esp_err_t err = gpio_config(&io_conf);
+  if (err != ESP_OK) return err;
+
+  err = gpio_install_isr_service(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;
+
+  if (quadrature) {
+    encoder_gpio_ctx_t *ctx = calloc(1, sizeof(encoder_gpio_ctx_t));
+    if (!ctx) return ESP_ERR_NO_MEM;
+    ctx->quad_state = encoder_gpio_read_ab(enc);
+    enc->driver_ctx = ctx;
+
+    gpio_set_intr_type(enc->config.pin_a, GPIO_INTR_ANYEDGE);
+    gpio_set_intr_type(enc->config.pin_b, GPIO_INTR_ANYEDGE);
+    err = gpio_isr_handler_add(enc->config.pin_a, encoder_gpio_quadrature_handler, enc);
+    if (err == ESP_OK) {
+      err = gpio_isr_handler_add(enc->config.pin_b, encoder_gpio_quadrature_handler, enc);
+    }
+  } else {
+    err = gpio_isr_handler_add(enc->config.pin_a, encoder_gpio_rotation_handler, enc);
+  }
+  if (err != ESP_OK) return err;
+
+  return gpio_isr_handler_add(enc->config.pin_z, encoder_index_handler, enc);
+}
+
+static const encoder_driver_t encoder_driver_gpio = {.name = "gpio", .start = encoder_gpio_start};
+
+#endif
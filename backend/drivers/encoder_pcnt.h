@@ -0,0 +1,148 @@
+#ifndef ENCODER_PCNT_H
+#define ENCODER_PCNT_H
+
+#include <driver/gpio.h>
+#include <driver/pulse_cnt.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+
+#include "../encoder.h"
+
+/*
+ * Pulse-counter backend: edges are counted in hardware and a periodic task pushes the count
+ * to the sample ring when it changed, so the CPU cost no longer scales with cable speed.
+ * At 4x a second channel decodes the edges of pin_b as well. The hardware decoder has no notion
+ * of an illegal transition, so illegal_transitions stays at zero; the glitch filter covers bounce.
+ * Only the once-per-revolution index pulse still uses a GPIO interrupt.
+ */
+
+#define ENCODER_PCNT_TAG "ENCODER_PCNT"
+#define ENCODER_PCNT_LIMIT 10000
+#define ENCODER_PCNT_GLITCH_NS 1000
+#define ENCODER_PCNT_SAMPLE_PERIOD_MS_DEFAULT 5
+#define ENCODER_PCNT_TASK_STACK 3072
+
+typedef struct {
+  pcnt_unit_handle_t unit;
+  pcnt_channel_handle_t chan_a, chan_b;
+  int last_count;
+} encoder_pcnt_ctx_t;
+
+static void encoder_pcnt_sample_task(void *arg) {
+  encoder_t *enc = (encoder_t *) arg;
+  encoder_pcnt_ctx_t *ctx = (encoder_pcnt_ctx_t *) enc->driver_ctx;
+
+  int period_ms = enc->config.sample_period_ms > 0 ? enc->config.sample_period_ms
+                                                   : ENCODER_PCNT_SAMPLE_PERIOD_MS_DEFAULT;
+  TickType_t period_ticks = pdMS_TO_TICKS(period_ms);
+  if (period_ticks == 0) period_ticks = 1;
+  TickType_t last_wake = xTaskGetTickCount();
+
+  while (1) {
+    vTaskDelayUntil(&last_wake, period_ticks);
+
+    int count = 0;
+    if (pcnt_unit_get_count(ctx->unit, &count) != ESP_OK) continue;
+
+    if (count == ctx->last_count) continue;
+    ctx->last_count = count;
+
+    encoder_push_sample(enc, (int32_t) count);
+  }
+}
+
+static esp_err_t encoder_pcnt_start(encoder_t *enc) {
+  encoder_pcnt_ctx_t *ctx = calloc(1, sizeof(encoder_pcnt_ctx_t));
+  if (!ctx) return ESP_ERR_NO_MEM;
+  bool enabled = false, started = false, index_isr = false;
+
+  pcnt_unit_config_t unit_config = {.low_limit = -ENCODER_PCNT_LIMIT,
+                                    .high_limit = ENCODER_PCNT_LIMIT,
+                                    .flags.accum_count = 1};
+  esp_err_t err = pcnt_new_unit(&unit_config, &ctx->unit);
+  if (err != ESP_OK) goto fail;
+
+  pcnt_glitch_filter_config_t filter_config = {.max_glitch_ns = ENCODER_PCNT_GLITCH_NS};
+  if ((err = pcnt_unit_set_glitch_filter(ctx->unit, &filter_config)) != ESP_OK) goto fail;
+
+  // Same semantics as the GPIO backend: count falling edges of A, B high means forward
+  pcnt_chan_config_t chan_config = {.edge_gpio_num = enc->config.pin_a,
+                                    .level_gpio_num = enc->config.pin_b};
+  if ((err = pcnt_new_channel(ctx->unit, &chan_config, &ctx->chan_a)) != ESP_OK) goto fail;
+  pcnt_channel_handle_t chan = ctx->chan_a;
+  if ((err = pcnt_channel_set_edge_action(chan, PCNT_CHANNEL_EDGE_ACTION_HOLD,
+                                          PCNT_CHANNEL_EDGE_ACTION_INCREASE)) != ESP_OK)
+    goto fail;
+  if ((err = pcnt_channel_set_level_action(chan, PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                           PCNT_CHANNEL_LEVEL_ACTION_INVERSE)) != ESP_OK)
+    goto fail;
+
+  if (enc->config.resolution == ENCODER_RESOLUTION_4X) {
+    if ((err = pcnt_channel_set_edge_action(chan, PCNT_CHANNEL_EDGE_ACTION_DECREASE,
+                                            PCNT_CHANNEL_EDGE_ACTION_INCREASE)) != ESP_OK)
+      goto fail;
+
+    pcnt_chan_config_t chan_b_config = {.edge_gpio_num = enc->config.pin_b,
+                                        .level_gpio_num = enc->config.pin_a};
+    if ((err = pcnt_new_channel(ctx->unit, &chan_b_config, &ctx->chan_b)) != ESP_OK) goto fail;
+    pcnt_channel_handle_t chan_b = ctx->chan_b;
+    if ((err = pcnt_channel_set_edge_action(chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                            PCNT_CHANNEL_EDGE_ACTION_DECREASE)) != ESP_OK)
+      goto fail;
+    if ((err = pcnt_channel_set_level_action(chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                             PCNT_CHANNEL_LEVEL_ACTION_INVERSE)) != ESP_OK)
+      goto fail;
+  }
+
+  // Watch points at the limits let the driver extend the 16-bit hardware counter
+  if ((err = pcnt_unit_add_watch_point(ctx->unit, -ENCODER_PCNT_LIMIT)) != ESP_OK) goto fail;
+  if ((err = pcnt_unit_add_watch_point(ctx->unit, ENCODER_PCNT_LIMIT)) != ESP_OK) goto fail;
+
+  if ((err = pcnt_unit_enable(ctx->unit)) != ESP_OK) goto fail;
+  enabled = true;
+  if ((err = pcnt_unit_clear_count(ctx->unit)) != ESP_OK) goto fail;
+  if ((err = pcnt_unit_start(ctx->unit)) != ESP_OK) goto fail;
+  started = true;
+
+  gpio_config_t io_conf = {};
+  io_conf.intr_type = GPIO_INTR_NEGEDGE;
+  io_conf.pin_bit_mask = 1ULL << (uint64_t) enc->config.pin_z;
+  io_conf.mode = GPIO_MODE_INPUT;
+  if ((err = gpio_config(&io_conf)) != ESP_OK) goto fail;
+
+  err = gpio_install_isr_service(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) goto fail;
+  if ((err = gpio_isr_handler_add(enc->config.pin_z, encoder_index_handler, enc)) != ESP_OK)
+    goto fail;
+  index_isr = true;
+
+  enc->driver_ctx = ctx;
+
+  if (xTaskCreate(encoder_pcnt_sample_task, "encoder_pcnt_sample", ENCODER_PCNT_TASK_STACK, enc,
+                  6, NULL) != pdPASS) {
+    err = ESP_ERR_NO_MEM;
+    goto fail;
+  }
+
+  return ESP_OK;
+
+fail:
+  ESP_LOGE(ENCODER_PCNT_TAG, "PCNT setup failed: %s", esp_err_to_name(err));
+  // Undo in reverse; the unit can only be deleted once disabled and without channels
+  if (index_isr) gpio_isr_handler_remove(enc->config.pin_z);
+  if (started) pcnt_unit_stop(ctx->unit);
+  if (enabled) pcnt_unit_disable(ctx->unit);
+  if (ctx->chan_b) pcnt_del_channel(ctx->chan_b);
+  if (ctx->chan_a) pcnt_del_channel(ctx->chan_a);
+  if (ctx->unit) pcnt_del_unit(ctx->unit);
+  enc->driver_ctx = NULL;
+  free(ctx);
+  return err;
+}
+
+static const encoder_driver_t encoder_driver_pcnt = {.name = "pcnt", .start = encoder_pcnt_start};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef QUADRATURE_H
+#define QUADRATURE_H
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_attr.h>
+#define QUADRATURE_TABLE_ATTR DRAM_ATTR
+#else
+#define QUADRATURE_TABLE_ATTR
+#endif
+
+/*
+ * Quadrature decoding shared by the GPIO backend and the fake encoder. AB = (A << 1) | B; moving
+ * forward the channels run 00, 10, 11, 01. At 1x only falling edges of A count, with B high
+ * meaning forward; at 4x every edge counts and a transition where both channels flipped is
+ * reported as QUAD_ILLEGAL. Free of IDF dependencies so it builds in the host tests.
+ */
+
+#define QUAD_ILLEGAL 2
+
+// Indexed by (previous AB << 2) | current AB
+static const QUADRATURE_TABLE_ATTR int8_t quadrature_table[16] = {
+  0,  -1, 1,  QUAD_ILLEGAL, //
+  1,  0,  QUAD_ILLEGAL, -1, //
+  -1, QUAD_ILLEGAL, 0,  1,  //
+  QUAD_ILLEGAL, 1,  -1, 0,
+};
+
+static inline int8_t quadrature_decode_4x(uint8_t previous_ab, uint8_t ab) {
+  return quadrature_table[((previous_ab & 3) << 2) | (ab & 3)];
+}
+
+static inline int8_t quadrature_decode_1x(uint8_t previous_ab, uint8_t ab) {
+  if (!(previous_ab & 2) || (ab & 2)) return 0;
+  return (ab & 1) ? 1 : -1;
+}
+
+#endif
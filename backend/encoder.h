@@ -1,30 +1,78 @@
 #ifndef ENCODER_H
 #define ENCODER_H
 
-#include <driver/gpio.h>
 #include <esp_attr.h>
+#include <esp_err.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <sdkconfig.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
-#define CAL_MIN 0.0
-#define CAL_MAX 100.0
+#if CONFIG_IDF_TARGET_LINUX
+typedef int gpio_num_t;
+#else
+#include <driver/gpio.h>
+#endif
+
+#include "encoder_ring.h"
+#include "encoder_velocity.h"
+#include "fixed.h"
+#include "seqlock.h"
+
+#define CAL_MIN Q16_FROM_INT(0)
+#define CAL_MAX Q16_FROM_INT(100)
+
+#define ENCODER_RESOLUTION_1X 1
+#define ENCODER_RESOLUTION_4X 4
 
 typedef enum { CAL_IDLE, CAL_SEEK_MAX, CAL_DONE } calibration_state_t;
 typedef enum { DIR_NONE = 0, DIR_POSITIVE, DIR_NEGATIVE } rotation_dir_t;
-typedef enum { EVENT_ROTATION, EVENT_CALIBRATION_CHANGE } encoder_event_type_t;
+typedef enum { EVENT_ROTATION, EVENT_CALIBRATION_CHANGE, EVENT_SAMPLE } encoder_event_type_t;
+
+typedef enum { ENCODER_CMD_RESET_CALIBRATION, ENCODER_CMD_ZERO } encoder_command_t;
+
+#define ENCODER_CMD_BIT(cmd) (1u << (cmd))
+// Sizes the registry and the tables kept per encoder: RTC calibration records, WebSocket
+// latest-value slots, telemetry payload. 8 is headroom over the two wired stations for a few
+// hundred bytes. The service task's wake-up takes one notification bit per encoder, so at most 32
+#define ENCODER_MAX_COUNT 8
+_Static_assert(ENCODER_MAX_COUNT <= 32, "one bit per encoder in the task notification value");
+#define ENCODER_DRAIN_BATCH 32
+#define ENCODER_TASK_STACK 4096
+#define ENCODER_VELOCITY_POLL_MS 50
 
 struct encoder_event_t;
+struct encoder_t;
+
+/**
+ * Counting backend. start() is called once the encoder is allocated and must begin reporting
+ * absolute raw counts through encoder_push_sample_from_isr() or encoder_push_sample().
+ */
+typedef struct {
+  const char *name;
+  esp_err_t (*start)(struct encoder_t *enc);
+} encoder_driver_t;
+
 typedef struct {
+  const char *name;
+  const encoder_driver_t *driver;
   gpio_num_t pin_a, pin_b, pin_z;
   int debounce_interval;
+  int sample_period_ms;
+  int resolution;
   int32_t calibration_debounce_steps;
   void (*on_event_cb)(struct encoder_event_t *event);
 } encoder_config_t;
 
+/*
+ * Written by the encoder service task inside a seqlock write section; read it through
+ * encoder_snapshot(). z_seen and illegal_transitions are single words updated from the ISR.
+ */
 typedef struct {
   volatile int32_t raw_count;
   volatile int32_t offset;
@@ -38,90 +86,120 @@ typedef struct {
   volatile int32_t reverse_accum;
 
   volatile bool z_seen;
+  volatile uint32_t illegal_transitions;
+  int32_t resolution;
 
-  volatile double calibrated;
+  volatile q16_t calibrated;
+  volatile q16_t velocity;     // calibrated units per second
+  volatile q16_t acceleration; // calibrated units per second squared
 } encoder_state_t;
 
-typedef struct {
+typedef struct encoder_t {
+  uint8_t id; // index into the encoder registry and per-encoder handler tables
   encoder_state_t state;
   encoder_config_t config;
-  QueueHandle_t queue;
+  void *driver_ctx;
+
+  // Producer side, owned by the driver
+  encoder_ring_t ring;
+  volatile int32_t isr_count;
+
+  // Consumer side, owned by the encoder service task
+  seqlock_t seq; // guards state
+  atomic_uint pending_commands;
+  int64_t last_sample_us;
+  uint32_t seen_overruns; // ring.overruns already resynced
+  TickType_t debounce_ticks;
+  bool rotation_pending;
+  int64_t first_valid_us; // time since boot of the first calibrated position, 0 until then
+  encoder_velocity_t velocity_est;
 } encoder_t;
 
 typedef struct encoder_event_t {
   encoder_t *source;
   encoder_event_type_t type;
+  int64_t timestamp_us;
+  q16_t calibrated;
+  q16_t velocity;
+  q16_t acceleration;
 } encoder_event_t;
 
+/*
+ * All encoders are served by one task. Producers wake it by setting the bit of their encoder id
+ * in its notification value.
+ */
+typedef struct {
+  encoder_t *encoders[ENCODER_MAX_COUNT];
+  atomic_uint count;
+  TaskHandle_t service_task;
+} encoder_registry_t;
+
+static encoder_registry_t encoder_registry = {0};
+
+static inline size_t encoder_count(void) { return atomic_load(&encoder_registry.count); }
+
+static inline encoder_t *encoder_get(size_t id) {
+  return id < encoder_count() ? encoder_registry.encoders[id] : NULL;
+}
+
 static inline rotation_dir_t detect_dir(int32_t delta) {
   if (delta > 0) return DIR_POSITIVE;
   if (delta < 0) return DIR_NEGATIVE;
   return DIR_NONE;
 }
 
-static void event_consumer_task(void *arg) {
-  QueueHandle_t queue = (QueueHandle_t) arg;
-  encoder_event_t event;
-
-  while (1) {
-    if (!xQueueReceive(queue, &event, portMAX_DELAY)) continue;
-
-    event.source->config.on_event_cb(&event);
+/**
+ * Publishes a new absolute raw count from the driver. The only work done in interrupt context
+ * is appending to the sample ring and waking the service task when the ring was empty.
+ */
+static inline void IRAM_ATTR encoder_push_sample_from_isr(encoder_t *enc, int32_t raw_count) {
+  enc->isr_count = raw_count;
+  if (encoder_ring_push(&enc->ring, (uint32_t) esp_timer_get_time(), raw_count)) {
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(encoder_registry.service_task, 1u << enc->id, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
   }
 }
 
-static inline bool should_send_callback(encoder_t *enc, encoder_event_type_t type, uint32_t now) {
-  uint32_t debounce_ticks = pdMS_TO_TICKS(enc->config.debounce_interval);
-
-  if ((now - enc->state.last_time) >= debounce_ticks || type == EVENT_CALIBRATION_CHANGE) {
-    enc->state.last_time = now;
-    return true;
+static inline void encoder_push_sample(encoder_t *enc, int32_t raw_count) {
+  enc->isr_count = raw_count;
+  if (encoder_ring_push(&enc->ring, (uint32_t) esp_timer_get_time(), raw_count)) {
+    xTaskNotify(encoder_registry.service_task, 1u << enc->id, eSetBits);
   }
-
-  return false;
-}
-
-static inline void send_callback(encoder_t *enc, encoder_event_type_t type) {
-  uint32_t now = xTaskGetTickCount();
-
-  if (!should_send_callback(enc, type, now)) return;
-
-  encoder_event_t event = {.source = enc, .type = type};
-  xQueueSend(enc->queue, &event, 0);
 }
 
-static inline void send_callback_from_isr(encoder_t *enc, encoder_event_type_t type) {
-  uint32_t now = xTaskGetTickCountFromISR();
-
-  if (!should_send_callback(enc, type, now)) return;
-
-  encoder_event_t event = {.source = enc, .type = type};
-  xQueueSendFromISR(enc->queue, &event, NULL);
+/**
+ * Queues a state change for the service task, which is the only writer of encoder_state_t.
+ */
+static inline void encoder_post_command(encoder_t *enc, encoder_command_t cmd) {
+  atomic_fetch_or(&enc->pending_commands, ENCODER_CMD_BIT(cmd));
+  if (encoder_registry.service_task) {
+    xTaskNotify(encoder_registry.service_task, 1u << enc->id, eSetBits);
+  }
 }
 
-static inline void send_callback_now(encoder_t *enc, encoder_event_type_t type) {
-  encoder_event_t event = {.source = enc, .type = type};
-  xQueueSend(enc->queue, &event, 0);
-}
+static inline void encoder_write_begin(encoder_t *enc) { seqlock_write_begin(&enc->seq); }
 
-static inline void set_cal_state(encoder_t *encoder, calibration_state_t cal_state) {
-  calibration_state_t current_state = encoder->state.cal_state;
-  encoder->state.cal_state = cal_state;
-  if (current_state != cal_state) {
-    send_callback(encoder, EVENT_CALIBRATION_CHANGE);
-  }
-}
+static inline void encoder_write_end(encoder_t *enc) { seqlock_write_end(&enc->seq); }
 
-static inline void set_cal_state_from_isr(encoder_t *encoder, calibration_state_t cal_state) {
-  calibration_state_t current_state = encoder->state.cal_state;
-  encoder->state.cal_state = cal_state;
-  if (current_state != cal_state) {
-    send_callback_from_isr(encoder, EVENT_CALIBRATION_CHANGE);
+/**
+ * Copies a coherent encoder_state_t without disabling interrupts. Retries while the service task
+ * is mid-write; yields a tick in that case so a higher-priority reader cannot starve the writer.
+ */
+static inline void encoder_snapshot(encoder_t *enc, encoder_state_t *out) {
+  while (1) {
+    unsigned start = seqlock_read_begin(&enc->seq);
+    if (start & 1) {
+      vTaskDelay(1);
+      continue;
+    }
+    *out = enc->state;
+    if (!seqlock_read_retry(&enc->seq, start)) return;
   }
 }
 
-static inline void encoder_calibration_step(encoder_t *enc, int32_t delta_raw) {
-  if (delta_raw == 0) return;
+static inline bool encoder_calibration_step(encoder_t *enc, int32_t delta_raw) {
+  if (delta_raw == 0) return false;
 
   int32_t debounce_steps = enc->config.calibration_debounce_steps;
   if (debounce_steps < 0) debounce_steps = 0;
@@ -146,7 +224,8 @@ static inline void encoder_calibration_step(encoder_t *enc, int32_t delta_raw) {
         (enc->state.cal_dir == DIR_POSITIVE ? enc->state.reverse_accum : -enc->state.reverse_accum);
       enc->state.max_distance = 0;
       enc->state.reverse_accum = 0;
-      set_cal_state_from_isr(enc, CAL_SEEK_MAX);
+      enc->state.cal_state = CAL_SEEK_MAX;
+      return true;
     }
     break;
 
@@ -158,7 +237,8 @@ static inline void encoder_calibration_step(encoder_t *enc, int32_t delta_raw) {
     } else {
       enc->state.reverse_accum += step;
       if (enc->state.reverse_accum >= debounce_steps && enc->state.max_distance > 0) {
-        set_cal_state_from_isr(enc, CAL_DONE);
+        enc->state.cal_state = CAL_DONE;
+        return true;
       }
     }
     break;
@@ -166,6 +246,8 @@ static inline void encoder_calibration_step(encoder_t *enc, int32_t delta_raw) {
   case CAL_DONE:
     break;
   }
+
+  return false;
 }
 
 static inline void encoder_update_calibrated(encoder_t *enc) {
@@ -181,85 +263,263 @@ static inline void encoder_update_calibrated(encoder_t *enc) {
     dist = -dist;
   }
 
-  double norm = (double) dist / (double) enc->state.max_distance;
-  enc->state.calibrated = CAL_MIN + norm * (CAL_MAX - CAL_MIN);
+  enc->state.calibrated =
+    CAL_MIN + (q16_t) (((int64_t) dist * (CAL_MAX - CAL_MIN)) / enc->state.max_distance);
 }
 
-static void IRAM_ATTR rotation_handler(void *arg) {
-  encoder_t *enc = (encoder_t *) arg;
-
-  int32_t prev_raw = enc->state.raw_count;
-
-  if (gpio_get_level(enc->config.pin_b))
-    enc->state.raw_count++;
-  else
-    enc->state.raw_count--;
-
-  int32_t delta_raw = enc->state.raw_count - prev_raw;
-
-  encoder_calibration_step(enc, delta_raw);
+/**
+ * Applies a raw count delta and refreshes the calibrated position. Returns true when the
+ * calibration state changed. Called from the service task only.
+ */
+static inline bool encoder_advance(encoder_t *enc, int32_t delta_raw) {
+  enc->state.raw_count += delta_raw;
+  bool cal_changed = encoder_calibration_step(enc, delta_raw);
   encoder_update_calibrated(enc);
+  return cal_changed;
+}
 
-  send_callback_from_isr(enc, EVENT_ROTATION);
+static inline void encoder_update_velocity(encoder_t *enc, int64_t timestamp_us) {
+  if (enc->state.cal_state == CAL_DONE) {
+    encoder_velocity_update(&enc->velocity_est, timestamp_us, enc->state.raw_count,
+                            enc->state.max_distance,
+                            enc->state.cal_dir == DIR_NEGATIVE ? -1 : 1);
+  } else {
+    encoder_velocity_reset(&enc->velocity_est);
+  }
+  enc->state.velocity = enc->velocity_est.velocity;
+  enc->state.acceleration = enc->velocity_est.acceleration;
 }
 
-static void IRAM_ATTR reset_handler(void *arg) {
-  encoder_t *enc = (encoder_t *) arg;
-  if (enc->state.cal_state < CAL_DONE) return;
+static void encoder_dispatch(encoder_t *enc, encoder_event_type_t type, int64_t timestamp_us) {
+  encoder_event_t event = {.source = enc,
+                           .type = type,
+                           .timestamp_us = timestamp_us,
+                           .calibrated = enc->state.calibrated,
+                           .velocity = enc->state.velocity,
+                           .acceleration = enc->state.acceleration};
+  enc->config.on_event_cb(&event);
+}
 
-  int32_t logical_before = enc->state.raw_count + enc->state.offset;
+static void encoder_consume_sample(encoder_t *enc, uint32_t timestamp_us, int32_t raw_count) {
+  // Samples are in order, so the 32-bit timestamp can be widened from the previous one. An older
+  // one would wrap the clock ~71 minutes ahead; keep the previous time instead.
+  uint32_t elapsed_us = timestamp_us - (uint32_t) enc->last_sample_us;
+  if ((int32_t) elapsed_us > 0) enc->last_sample_us += elapsed_us;
 
-  enc->state.raw_count = 0;
-  enc->state.offset = logical_before;
-  enc->state.z_seen = true;
+  int32_t delta_raw = raw_count - enc->state.raw_count;
+  if (delta_raw == 0) return;
+
+  encoder_write_begin(enc);
+  bool cal_changed = encoder_advance(enc, delta_raw);
+  encoder_update_velocity(enc, enc->last_sample_us);
+  encoder_write_end(enc);
+
+  if (cal_changed) {
+    if (enc->state.cal_state == CAL_DONE && enc->first_valid_us == 0) {
+      enc->first_valid_us = enc->last_sample_us;
+      ESP_LOGI("ENCODER", "Encoder %u position valid %lld ms after boot", (unsigned) enc->id,
+               (long long) (enc->first_valid_us / 1000));
+    }
+    encoder_dispatch(enc, EVENT_CALIBRATION_CHANGE, enc->last_sample_us);
+  }
+  encoder_dispatch(enc, EVENT_SAMPLE, enc->last_sample_us);
 }
 
-void encoder_reset_calibration(encoder_t *enc) {
+// Returns true when the calibration state changed
+static bool encoder_apply_reset_calibration(encoder_t *enc) {
   ESP_LOGI("ENCODER", "Cleared calibration");
-  set_cal_state(enc, CAL_IDLE);
+  bool changed = enc->state.cal_state != CAL_IDLE;
+
+  encoder_write_begin(enc);
+  enc->state.cal_state = CAL_IDLE;
   enc->state.cal_dir = DIR_NONE;
   enc->state.start_count = enc->state.raw_count + enc->state.offset;
   enc->state.max_distance = 0;
   enc->state.reverse_accum = 0;
   enc->state.z_seen = false;
   enc->state.calibrated = CAL_MIN;
-}
+  enc->state.velocity = 0;
+  enc->state.acceleration = 0;
+  encoder_write_end(enc);
 
-void encoder_zero_calibrated(encoder_t *enc) {
-  if (!enc) return;
+  encoder_velocity_reset(&enc->velocity_est);
+  return changed;
+}
 
+static void encoder_apply_zero(encoder_t *enc) {
   ESP_LOGI("ENCODER", "Zeroed calibrated position");
+  encoder_write_begin(enc);
   enc->state.offset = enc->state.start_count - enc->state.raw_count;
   enc->state.reverse_accum = 0;
   enc->state.calibrated = CAL_MIN;
-  send_callback_now(enc, EVENT_ROTATION);
+  encoder_write_end(enc);
+}
+
+/**
+ * Returns how long the encoder can be left alone when no new samples arrive: until its trailing
+ * rotation event is due, or the velocity poll interval while the bar is moving.
+ */
+static TickType_t encoder_service_timeout(encoder_t *enc) {
+  TickType_t wait = portMAX_DELAY;
+  if (enc->state.velocity != 0 || enc->state.acceleration != 0) {
+    wait = pdMS_TO_TICKS(ENCODER_VELOCITY_POLL_MS);
+  }
+  if (enc->rotation_pending) {
+    TickType_t elapsed = xTaskGetTickCount() - enc->state.last_time;
+    TickType_t remaining = elapsed >= enc->debounce_ticks ? 0 : enc->debounce_ticks - elapsed;
+    if (remaining < wait) wait = remaining;
+  }
+  return wait;
+}
+
+/*
+ * Drains the sample ring in batches. Every sample is dispatched as EVENT_SAMPLE; EVENT_ROTATION
+ * is throttled to debounce_interval, with a trailing event so the final position is reported.
+ */
+static void encoder_service(encoder_t *enc, encoder_sample_t *batch) {
+  unsigned commands = atomic_exchange(&enc->pending_commands, 0);
+  if (commands & ENCODER_CMD_BIT(ENCODER_CMD_RESET_CALIBRATION)) {
+    if (encoder_apply_reset_calibration(enc)) {
+      encoder_dispatch(enc, EVENT_CALIBRATION_CHANGE, esp_timer_get_time());
+    }
+  }
+  if (commands & ENCODER_CMD_BIT(ENCODER_CMD_ZERO)) {
+    encoder_apply_zero(enc);
+  }
+
+  int32_t raw_before = enc->state.raw_count;
+  size_t count;
+  while ((count = encoder_ring_pop_batch(&enc->ring, batch, ENCODER_DRAIN_BATCH)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      encoder_consume_sample(enc, batch[i].timestamp_us, batch[i].raw_count);
+    }
+  }
+
+  // After an overrun, jump to the producer's latest count. The time is read before the count, so
+  // every sample still queued from before it is covered by the count and can be dropped; later
+  // ones carry later times and counts.
+  uint32_t overruns = enc->ring.overruns;
+  if (overruns != enc->seen_overruns) {
+    enc->seen_overruns = overruns;
+    uint32_t resync_us = (uint32_t) esp_timer_get_time();
+    int32_t produced = enc->isr_count;
+    encoder_consume_sample(enc, resync_us, produced);
+    encoder_ring_discard_before(&enc->ring, resync_us);
+  }
+
+  if (enc->state.raw_count != raw_before) {
+    enc->rotation_pending = true;
+  } else if (encoder_velocity_idle(&enc->velocity_est, esp_timer_get_time(),
+                                   enc->state.max_distance)) {
+    // Let clients see the bar slow down and stop even without new edges
+    encoder_write_begin(enc);
+    enc->state.velocity = enc->velocity_est.velocity;
+    enc->state.acceleration = enc->velocity_est.acceleration;
+    encoder_write_end(enc);
+    enc->rotation_pending = true;
+  }
+
+  TickType_t now = xTaskGetTickCount();
+  if ((commands & ENCODER_CMD_BIT(ENCODER_CMD_ZERO)) ||
+      (enc->rotation_pending && (now - enc->state.last_time) >= enc->debounce_ticks)) {
+    enc->state.last_time = now;
+    enc->rotation_pending = false;
+    encoder_dispatch(enc, EVENT_ROTATION, esp_timer_get_time());
+  }
+}
+
+static void encoder_service_task(void *arg) {
+  (void) arg;
+  encoder_sample_t batch[ENCODER_DRAIN_BATCH];
+
+  while (1) {
+    size_t n = encoder_count();
+    TickType_t wait = portMAX_DELAY;
+    for (size_t i = 0; i < n; i++) {
+      TickType_t timeout = encoder_service_timeout(encoder_registry.encoders[i]);
+      if (timeout < wait) wait = timeout;
+    }
+
+    uint32_t ready = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &ready, wait);
+
+    n = encoder_count();
+    for (size_t i = 0; i < n; i++) {
+      encoder_t *enc = encoder_registry.encoders[i];
+      if ((ready & (1u << i)) || encoder_service_timeout(enc) != portMAX_DELAY) {
+        encoder_service(enc, batch);
+      }
+    }
+  }
+}
+
+/*
+ * The index pulse only marks that a full revolution was observed; position is tracked from the
+ * sample stream alone. The old handler re-based the count here (raw_count to 0, the logical
+ * position moved into offset), which left the position unchanged and only kept the ISR's own
+ * counter small. raw_count now mirrors the absolute count the driver pushes, and each sample is
+ * applied as its difference from raw_count, so re-basing it would turn the next sample into a jump
+ * by the whole count. An int32 count lasts hundreds of thousands of revolutions even at 4x.
+ */
+static void IRAM_ATTR encoder_index_handler(void *arg) {
+  encoder_t *enc = (encoder_t *) arg;
+  if (enc->state.cal_state < CAL_DONE) return;
+  enc->state.z_seen = true;
+}
+
+void encoder_reset_calibration(encoder_t *enc) {
+  if (!enc) return;
+  encoder_post_command(enc, ENCODER_CMD_RESET_CALIBRATION);
+}
+
+void encoder_zero_calibrated(encoder_t *enc) {
+  if (!enc) return;
+  encoder_post_command(enc, ENCODER_CMD_ZERO);
 }
 
 encoder_t *init_encoder(encoder_config_t enc_config, const encoder_state_t *initial_cal) {
-  gpio_config_t io_conf = {};
-  io_conf.intr_type = GPIO_INTR_NEGEDGE;
-  io_conf.pin_bit_mask =
-    ((1ULL << (uint64_t) enc_config.pin_a) | (1ULL << (uint64_t) enc_config.pin_b) |
-     (1ULL << (uint64_t) enc_config.pin_z));
-  io_conf.mode = GPIO_MODE_INPUT;
-  gpio_config(&io_conf);
+  if (!enc_config.driver || !enc_config.driver->start) {
+    ESP_LOGE("ENCODER", "No encoder driver configured");
+    return NULL;
+  }
+
+  if (encoder_count() >= ENCODER_MAX_COUNT) {
+    ESP_LOGE("ENCODER", "Encoder registry is full (%d)", ENCODER_MAX_COUNT);
+    return NULL;
+  }
 
   encoder_t *enc = calloc(1, sizeof(encoder_t));
   if (!enc) return NULL;
 
+  if (enc_config.resolution != ENCODER_RESOLUTION_4X) {
+    enc_config.resolution = ENCODER_RESOLUTION_1X;
+  }
+  // Debounce steps are configured in 1x counts
+  enc_config.calibration_debounce_steps *= enc_config.resolution;
+
   enc->config = enc_config;
+  enc->state.resolution = enc_config.resolution;
   enc->state.raw_count = 0;
   enc->state.offset = 0;
   enc->state.last_time = 0;
-  enc->queue = xQueueCreate(8, sizeof(encoder_event_t));
+  enc->last_sample_us = esp_timer_get_time();
   if (initial_cal) {
     enc->state.cal_state = initial_cal->cal_state;
     enc->state.cal_dir = initial_cal->cal_dir;
     enc->state.start_count = initial_cal->start_count;
     enc->state.max_distance = initial_cal->max_distance;
-    enc->state.calibrated = initial_cal->calibrated;
+    enc->state.offset = initial_cal->offset;
+    // Rescale a calibration recorded at a different decoding resolution
+    int32_t saved_resolution = initial_cal->resolution;
+    if (saved_resolution > 0 && saved_resolution != enc_config.resolution) {
+      enc->state.start_count = initial_cal->start_count * enc_config.resolution / saved_resolution;
+      enc->state.max_distance =
+        initial_cal->max_distance * enc_config.resolution / saved_resolution;
+      enc->state.offset = initial_cal->offset * enc_config.resolution / saved_resolution;
+    }
+    encoder_update_calibrated(enc);
   } else {
-    set_cal_state(enc, CAL_IDLE);
+    enc->state.cal_state = CAL_IDLE;
     enc->state.cal_dir = DIR_NONE;
     enc->state.start_count = 0;
     enc->state.max_distance = 0;
@@ -267,13 +527,37 @@ encoder_t *init_encoder(encoder_config_t enc_config, const encoder_state_t *init
   }
   enc->state.reverse_accum = 0;
   enc->state.z_seen = false;
+  if (enc->state.cal_state == CAL_DONE) enc->first_valid_us = esp_timer_get_time();
 
-  gpio_install_isr_service(0);
-  gpio_isr_handler_add(enc_config.pin_a, rotation_handler, enc);
-  gpio_isr_handler_add(enc_config.pin_z, reset_handler, enc);
+  enc->debounce_ticks = pdMS_TO_TICKS(enc_config.debounce_interval);
 
-  xTaskCreate(event_consumer_task, "event_consumer_task", 4096, enc->queue, 5, NULL);
+  if (!encoder_registry.service_task &&
+      xTaskCreate(encoder_service_task, "encoder_service", ENCODER_TASK_STACK, NULL, 5,
+                  &encoder_registry.service_task) != pdPASS) {
+    free(enc);
+    return NULL;
+  }
 
+  // Registered before the driver starts so its first wake-up is not lost
+  size_t id = encoder_count();
+  enc->id = (uint8_t) id;
+  encoder_registry.encoders[id] = enc;
+  atomic_store(&encoder_registry.count, id + 1);
+
+  if (enc_config.driver->start(enc) != ESP_OK) {
+    ESP_LOGE("ENCODER", "Failed to start %s encoder driver", enc_config.driver->name);
+    atomic_store(&encoder_registry.count, id);
+    encoder_registry.encoders[id] = NULL;
+    free(enc);
+    return NULL;
+  }
+
+  ESP_LOGI("ENCODER", "Started %s encoder %u (%s driver)", enc_config.name ? enc_config.name : "",
+           (unsigned) id, enc_config.driver->name);
+  if (enc->first_valid_us) {
+    ESP_LOGI("ENCODER", "Encoder %u position restored %lld ms after boot", (unsigned) id,
+             (long long) (enc->first_valid_us / 1000));
+  }
   return enc;
 }
 
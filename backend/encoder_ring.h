@@ -0,0 +1,90 @@
+#ifndef ENCODER_RING_H
+#define ENCODER_RING_H
+
+#include <esp_attr.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lock-free single-producer/single-consumer ring of encoder samples. The producer is the
+ * encoder ISR (or driver sampling task), the consumer is the encoder service task. Each sample
+ * carries the absolute raw count, so a dropped sample only loses timing, never position.
+ */
+
+#define ENCODER_RING_SIZE 256 // must be a power of two
+#define ENCODER_RING_MASK (ENCODER_RING_SIZE - 1)
+
+typedef struct {
+  uint32_t timestamp_us; // low 32 bits of esp_timer_get_time()
+  int32_t raw_count;
+} encoder_sample_t;
+
+typedef struct {
+  encoder_sample_t samples[ENCODER_RING_SIZE];
+  atomic_uint head; // written by producer only
+  atomic_uint tail; // written by consumer only
+  volatile uint32_t overruns;
+} encoder_ring_t;
+
+/**
+ * Appends a sample. Returns true when the ring was empty before the push, i.e. when the
+ * consumer may be sleeping and needs a wake-up.
+ */
+static inline bool IRAM_ATTR encoder_ring_push(encoder_ring_t *ring, uint32_t timestamp_us,
+                                               int32_t raw_count) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+  if (head - tail >= ENCODER_RING_SIZE) {
+    ring->overruns++;
+    return false;
+  }
+
+  encoder_sample_t *slot = &ring->samples[head & ENCODER_RING_MASK];
+  slot->timestamp_us = timestamp_us;
+  slot->raw_count = raw_count;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+  return head == tail;
+}
+
+/**
+ * Copies up to max_samples samples into out and releases them. Returns the number copied.
+ */
+static inline size_t encoder_ring_pop_batch(encoder_ring_t *ring, encoder_sample_t *out,
+                                            size_t max_samples) {
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  size_t available = head - tail;
+  size_t count = available < max_samples ? available : max_samples;
+  for (size_t i = 0; i < count; i++) {
+    out[i] = ring->samples[(tail + i) & ENCODER_RING_MASK];
+  }
+
+  atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+  return count;
+}
+
+/**
+ * Releases the samples taken before timestamp_us, which a resync has already accounted for.
+ * Returns the number released.
+ */
+static inline size_t encoder_ring_discard_before(encoder_ring_t *ring, uint32_t timestamp_us) {
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  size_t discarded = 0;
+  while (tail != head &&
+         (int32_t) (ring->samples[tail & ENCODER_RING_MASK].timestamp_us - timestamp_us) < 0) {
+    tail++;
+    discarded++;
+  }
+
+  atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  return discarded;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef ENCODER_VELOCITY_H
+#define ENCODER_VELOCITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fixed.h"
+
+/*
+ * Incremental bar speed estimator. Each estimate spans from the edge that opened the window to
+ * the first edge at least ENCODER_VELOCITY_WINDOW_US later: at low speed that is the period of a
+ * single edge (1/T), at high speed it is the count accumulated over the window. Estimates are in
+ * counts per second scaled to calibrated units (%/s, Q16.16) and smoothed with an EMA; the
+ * acceleration is the smoothed derivative of the velocity. O(1) per sample, no allocation.
+ */
+
+#define ENCODER_VELOCITY_WINDOW_US 10000
+#define ENCODER_VELOCITY_STOP_US 250000
+#define ENCODER_VELOCITY_EMA_SHIFT 2 // alpha = 1/4
+
+typedef struct {
+  int64_t window_start_us;
+  int32_t window_start_count;
+  int64_t last_edge_us;
+  int64_t last_update_us;
+  bool primed;
+
+  q16_t velocity;     // %/s
+  q16_t acceleration; // %/s^2
+} encoder_velocity_t;
+
+static inline q16_t encoder_velocity_saturate(int64_t value) {
+  if (value > INT32_MAX) return INT32_MAX;
+  if (value < INT32_MIN) return INT32_MIN;
+  return (q16_t) value;
+}
+
+static inline void encoder_velocity_reset(encoder_velocity_t *est) {
+  *est = (encoder_velocity_t) {0};
+}
+
+static inline void encoder_velocity_apply(encoder_velocity_t *est, int64_t now_us,
+                                          q16_t velocity) {
+  q16_t previous = est->velocity;
+  est->velocity += (velocity - est->velocity) >> ENCODER_VELOCITY_EMA_SHIFT;
+
+  int64_t dt = now_us - est->last_update_us;
+  if (est->last_update_us > 0 && dt > 0) {
+    q16_t accel =
+      encoder_velocity_saturate((int64_t) (est->velocity - previous) * 1000000 / dt);
+    est->acceleration += (accel - est->acceleration) >> ENCODER_VELOCITY_EMA_SHIFT;
+  }
+  est->last_update_us = now_us;
+}
+
+/**
+ * Feeds one edge. counts_per_range is the number of raw counts spanning CAL_MIN..CAL_MAX and
+ * sign is +1 or -1 depending on the calibrated direction.
+ */
+static inline void encoder_velocity_update(encoder_velocity_t *est, int64_t timestamp_us,
+                                           int32_t raw_count, int32_t counts_per_range,
+                                           int32_t sign) {
+  est->last_edge_us = timestamp_us;
+
+  if (!est->primed || counts_per_range <= 0) {
+    est->window_start_us = timestamp_us;
+    est->window_start_count = raw_count;
+    est->primed = counts_per_range > 0;
+    return;
+  }
+
+  int64_t dt = timestamp_us - est->window_start_us;
+  if (dt < ENCODER_VELOCITY_WINDOW_US) return;
+
+  int64_t counts = (int64_t) (raw_count - est->window_start_count) * sign;
+  q16_t velocity = encoder_velocity_saturate(counts * Q16_FROM_INT(100) * 1000000 /
+                                             (dt * counts_per_range));
+
+  est->window_start_us = timestamp_us;
+  est->window_start_count = raw_count;
+  encoder_velocity_apply(est, timestamp_us, velocity);
+}
+
+/**
+ * Called when no edge arrived for a while. Bounds the speed by one count over the time since
+ * the last edge, and settles to zero after ENCODER_VELOCITY_STOP_US. Returns true when the
+ * estimate changed.
+ */
+static inline bool encoder_velocity_idle(encoder_velocity_t *est, int64_t now_us,
+                                         int32_t counts_per_range) {
+  if (est->velocity == 0 && est->acceleration == 0) return false;
+
+  int64_t elapsed = now_us - est->last_edge_us;
+  if (elapsed <= 0) return false;
+  if (elapsed >= ENCODER_VELOCITY_STOP_US || counts_per_range <= 0) {
+    est->velocity = 0;
+    est->acceleration = 0;
+    est->primed = false;
+    return true;
+  }
+
+  q16_t bound =
+    encoder_velocity_saturate(Q16_FROM_INT(100) * 1000000LL / (elapsed * counts_per_range));
+  q16_t magnitude = est->velocity < 0 ? -est->velocity : est->velocity;
+  if (magnitude <= bound) return false;
+
+  encoder_velocity_apply(est, now_us, est->velocity < 0 ? -bound : bound);
+  return true;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+/*
+ * Q16.16 fixed point. Used for calibrated positions (0-100 %) and everything derived from them,
+ * so the encoder pipeline runs without touching the FPU. Convert with q16_from_double() and
+ * q16_to_double() only at API boundaries (JSON, logs).
+ */
+
+typedef int32_t q16_t;
+
+#define Q16_SHIFT 16
+#define Q16_ONE ((q16_t) 1 << Q16_SHIFT)
+#define Q16_FRAC_MASK (Q16_ONE - 1)
+#define Q16_FROM_INT(x) ((q16_t) ((x) * Q16_ONE))
+
+static inline q16_t q16_from_double(double value) {
+  return (q16_t) (value * Q16_ONE + (value < 0 ? -0.5 : 0.5));
+}
+
+static inline double q16_to_double(q16_t value) { return (double) value / Q16_ONE; }
+
+/**
+ * Returns num / den in Q16.16, computed in 64 bits so any pair of 32-bit counts is safe.
+ */
+static inline q16_t q16_ratio(int32_t num, int32_t den) {
+  return (q16_t) (((int64_t) num << Q16_SHIFT) / den);
+}
+
+static inline q16_t q16_mul(q16_t a, q16_t b) {
+  return (q16_t) (((int64_t) a * b) >> Q16_SHIFT);
+}
+
+static inline q16_t q16_clamp(q16_t value, q16_t min, q16_t max) {
+  if (value < min) return min;
+  if (value > max) return max;
+  return value;
+}
+
+// Rounds towards positive infinity, like ceil()
+static inline int32_t q16_ceil_int(q16_t value) {
+  return (int32_t) (((int64_t) value + Q16_FRAC_MASK) >> Q16_SHIFT);
+}
+
+#endif
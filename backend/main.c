@@ -31,20 +31,29 @@
 #define ENCODER_CAL_LEFT_PATH "/cfg/encoder_cal_left.json"
 #define ENCODER_CAL_RIGHT_PATH "/cfg/encoder_cal_right.json"
 
+#include "drivers/encoder_fake.h"
+#include "drivers/encoder_gpio.h"
+#include "drivers/encoder_pcnt.h"
 #include "encoder.h"
 #include "rep_counter.h"
 #include "routes/api/http_api_exercises.h"
 #include "routes/api/http_api_hardware.h"
+#include "routes/api/http_api_history.h"
 #include "routes/api/http_api_settings.h"
+#include "routes/api/http_api_stats.h"
 #include "routes/captive/http_captiveportalredirect.h"
 #include "routes/web/http_fileserver.h"
 #include "routes/ws/ws_encoder.h"
 #include "routes/ws/ws_rep_counter.h"
+#include "routes/ws/ws_telemetry.h"
+#include "routes/ws/ws_workout.h"
+#include "store/persistence.h"
 #include "tls_cert.h"
 #include "transport/http/http_redirect_server.h"
 #include "transport/http/https_server.h"
 #include "transport/ws/ws_server.h"
 #include "utils.h"
+#include "workout.h"
 
 #define ANSI_CURSOR_UP(n) "\033[" #n "A"
 #define ANSI_CLEAR_LINE "\033[2K\r"
@@ -56,19 +65,49 @@ const char *TAG = "MAIN";
 static const char *const cal_state_names[] = {
   [CAL_IDLE] = "idle", [CAL_SEEK_MAX] = "seek_max", [CAL_DONE] = "done"};
 
+typedef struct {
+  const char *name;
+  gpio_num_t pin_a, pin_b, pin_z;
+  const char *cal_path;
+} encoder_station_t;
+
+// Encoder ids are assigned in this order and index every per-encoder table below
+static const encoder_station_t encoder_stations[] = {
+  {"left", GPIO_NUM_11, GPIO_NUM_10, GPIO_NUM_9, ENCODER_CAL_LEFT_PATH},
+  {"right", GPIO_NUM_14, GPIO_NUM_13, GPIO_NUM_12, ENCODER_CAL_RIGHT_PATH},
+};
+#define ENCODER_STATION_COUNT (sizeof(encoder_stations) / sizeof(encoder_stations[0]))
+
 static httpd_handle_t redirect_server = NULL;
 encoder_t *leftEncoder = NULL;
 encoder_t *rightEncoder = NULL;
-encoder_state_t left_cal_state = {0};
-encoder_state_t right_cal_state = {0};
+static encoder_state_t encoder_cal_states[ENCODER_STATION_COUNT] = {0};
 static rep_counter_t rep_counter;
+static encoder_cal_record_t encoder_cal_saved[ENCODER_STATION_COUNT]; // last queued for NVS
 static ws_encoder_context_t ws_encoder_ctx;
 
+static const encoder_driver_t *resolve_encoder_driver(const char *name) {
+  if (name && strcmp(name, encoder_driver_pcnt.name) == 0) return &encoder_driver_pcnt;
+  if (name && strcmp(name, encoder_driver_fake.name) == 0) return &encoder_driver_fake;
+  if (name && strcmp(name, encoder_driver_gpio.name) != 0) {
+    ESP_LOGW(TAG, "Unknown encoder driver '%s', using gpio", name);
+  }
+  return &encoder_driver_gpio;
+}
+
+// Keep in step with register_http_handlers(); a full table aborts boot
+#define HTTPS_URI_HANDLERS                                                                         \
+  (HTTP_API_HARDWARE_URI_HANDLERS + HTTP_API_EXERCISES_URI_HANDLERS +                              \
+   HTTP_API_SETTINGS_URI_HANDLERS + HTTP_API_HISTORY_URI_HANDLERS + HTTP_API_STATS_URI_HANDLERS +  \
+   get_captive_paths_count() + WS_URI_HANDLERS + FILESERVER_URI_HANDLERS)
+
 static void register_http_handlers(httpd_handle_t http_server, void *ctx) {
   (void) ctx;
   http_api_hardware_register(http_server);
   http_api_exercises_register(http_server, "/cfg/exercises.json");
   http_api_settings_register(http_server, "/cfg/settings.json");
+  http_api_history_register(http_server);
+  http_api_stats_register(http_server);
   http_captiveportalredirect_register(http_server);
   ws_register(http_server);
 
@@ -85,45 +124,98 @@ void app_hostname_changed(const char *hostname) {
   https_server_request_tls_update(wifi_get_ap_ip(), wifi_get_sta_ip());
 }
 
-static void encoder_event_handler(encoder_event_t *event) {
-  char *encoder_name;
-  rep_side_t side;
-  bool has_side = true;
-
-  if (event->source == leftEncoder) {
-    encoder_name = "left";
-    side = REP_SIDE_LEFT;
-  } else if (event->source == rightEncoder) {
-    encoder_name = "right";
-    side = REP_SIDE_RIGHT;
-  } else {
-    encoder_name = "unknown";
-    has_side = false;
+static esp_err_t encoder_cal_persist(const void *data, size_t len, void *ctx) {
+  uint8_t id = (uint8_t) (uintptr_t) ctx;
+  if (len != sizeof(encoder_state_t)) return ESP_ERR_INVALID_SIZE;
+
+  esp_err_t err = encoder_cal_save_nvs(id, (const encoder_state_t *) data);
+  if (err == ESP_OK) {
+    ESP_LOGI(TAG, "Saved %s encoder calibration", encoder_stations[id].name);
   }
+  return err;
+}
 
-  if (event->type == EVENT_CALIBRATION_CHANGE && event->source->state.cal_state == CAL_DONE) {
-    const char *cal_path =
-      (event->source == leftEncoder) ? ENCODER_CAL_LEFT_PATH : ENCODER_CAL_RIGHT_PATH;
-    encoder_state_t snapshot = event->source->state;
-    esp_err_t err = encoder_cal_save_file(cal_path, &snapshot);
-    if (err != ESP_OK) {
-      ESP_LOGE(TAG, "Failed to save %s encoder calibration", encoder_name);
+// Writes NVS only when the calibration differs from the one last queued. The position goes along
+// but never triggers a write; between reps it lives in the RTC record
+static void encoder_cal_queue_save(uint8_t id, const encoder_state_t *state) {
+  encoder_cal_record_t record;
+  encoder_cal_record_from_state(&record, state);
+  if (encoder_cal_record_valid(&encoder_cal_saved[id]) &&
+      encoder_cal_record_same_calibration(&record, &encoder_cal_saved[id]))
+    return;
+
+  if (persistence_submit(PERSISTENCE_KEY_ENCODER_CAL(id), encoder_cal_persist,
+                         (void *) (uintptr_t) id, state, sizeof(*state)) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to queue %s encoder calibration", encoder_stations[id].name);
+    return;
+  }
+  encoder_cal_saved[id] = record;
+}
+
+// Prefers the warm-reset record, then NVS, then a JSON file left by older firmware
+static void encoder_cal_restore(uint8_t id, const encoder_station_t *station,
+                                encoder_state_t *state) {
+  const char *source = "none";
+  if (encoder_cal_load_rtc(id, state) == ESP_OK) {
+    source = "RTC memory";
+  } else if (encoder_cal_load_nvs(id, state) == ESP_OK) {
+    source = "NVS";
+    encoder_cal_record_from_state(&encoder_cal_saved[id], state);
+  } else if (encoder_cal_load_file(station->cal_path, state) == ESP_OK) {
+    source = station->cal_path;
+    if (encoder_cal_save_nvs(id, state) == ESP_OK) {
+      encoder_cal_record_from_state(&encoder_cal_saved[id], state);
     } else {
-      ESP_LOGI(TAG, "Saved %s encoder calibration", encoder_name);
+      ESP_LOGW(TAG, "Failed to import %s encoder calibration into NVS", station->name);
     }
   }
+  ESP_LOGI(TAG, "Restored %s encoder calibration from %s", station->name, source);
+}
 
-  ws_encoder_publish(&ws_encoder_ctx, "position", encoder_name, event->source,
-                     cal_state_names[event->source->state.cal_state]);
+// Fused singular reps are reported under "both"; otherwise under the side that made the rep,
+// which is not necessarily the encoder whose sample completed it
+static void encoder_publish_rep(const rep_record_t *rep) {
+  encoder_t *enc = encoder_get(rep->side);
+  if (!enc) return;
+
+  const char *name = rep->fused ? "both" : encoder_stations[rep->side].name;
+  encoder_state_t state;
+  encoder_snapshot(enc, &state);
+  ws_encoder_publish_rep(name, &state, cal_state_names[state.cal_state], rep);
+  if (rep->stop_set) ws_encoder_publish_stop_set(name, rep);
+  workout_on_rep(rep);
+}
 
-  if (has_side) {
-    bool rep_completed = rep_counter_check(&rep_counter, side, event->source->state.calibrated,
-                                           event->source->state.cal_state);
-    if (rep_completed) {
-      ws_encoder_publish(&ws_encoder_ctx, "rep", encoder_name, event->source,
-                         cal_state_names[event->source->state.cal_state]);
+static void encoder_event_handler(encoder_event_t *event) {
+  const encoder_station_t *station = &encoder_stations[event->source->id];
+  const char *encoder_name = station->name;
+  // Stations beyond the rep counter's sides still publish positions
+  bool has_side = event->source->id < REP_SIDE_COUNT;
+  rep_side_t side = (rep_side_t) event->source->id;
+  encoder_state_t state;
+  encoder_snapshot(event->source, &state);
+
+  if (event->type == EVENT_CALIBRATION_CHANGE) {
+    encoder_cal_save_rtc(event->source->id, &state);
+    encoder_cal_queue_save(event->source->id, &state);
+  }
+
+  // Every sample feeds rep detection; position updates arrive throttled as EVENT_ROTATION
+  if (event->type == EVENT_SAMPLE) {
+    if (!has_side) return;
+    rep_record_t rep;
+    if (rep_counter_check(&rep_counter, side, event->calibrated, event->velocity,
+                          event->timestamp_us, state.cal_state, &rep)) {
+      encoder_publish_rep(&rep);
     }
+    return;
   }
+
+  // Keep the warm-reset record current; flash is only written on calibration changes above
+  encoder_cal_save_rtc(event->source->id, &state);
+
+  ws_encoder_publish(&ws_encoder_ctx, "position", encoder_name, event->source->id, &state,
+                     cal_state_names[state.cal_state], event->timestamp_us);
 }
 
 static inline void monitor_system_info() {
@@ -141,18 +233,23 @@ static inline void monitor_system_info() {
     double storage_used_kb = used_storage / 1000.0;
     double storage_total_kb = total_storage / 1000.0;
 
+    encoder_state_t left, right;
+    encoder_snapshot(leftEncoder, &left);
+    encoder_snapshot(rightEncoder, &right);
+
     esp_log_level_set("*", ESP_LOG_NONE);
     printf(ANSI_CURSOR_UP(3) ANSI_CLEAR_LINE
            "(RAM) %.1f / %.1f kB | (Storage) %.1f / %.1f kB\n" ANSI_CLEAR_LINE
            "(Left encoder) raw_count: %ld, calibrated: %.1f, cal_done: %s, debounce_ms: "
-           "%d\n" ANSI_CLEAR_LINE
-           "(Right encoder) raw_count: %ld, calibrated: %.1f, cal_done: %s, debounce_ms: %d\n",
+           "%d, illegal: %lu\n" ANSI_CLEAR_LINE
+           "(Right encoder) raw_count: %ld, calibrated: %.1f, cal_done: %s, debounce_ms: %d, "
+           "illegal: %lu\n",
            ram_used_kb, ram_total_kb, storage_used_kb, storage_total_kb,
-           leftEncoder->state.raw_count, leftEncoder->state.calibrated,
-           leftEncoder->state.cal_state == CAL_DONE ? "yes" : "no",
-           leftEncoder->config.debounce_interval, rightEncoder->state.raw_count,
-           rightEncoder->state.calibrated, rightEncoder->state.cal_state == CAL_DONE ? "yes" : "no",
-           rightEncoder->config.debounce_interval);
+           left.raw_count, q16_to_double(left.calibrated), left.cal_state == CAL_DONE ? "yes" : "no",
+           leftEncoder->config.debounce_interval, (unsigned long) left.illegal_transitions,
+           right.raw_count, q16_to_double(right.calibrated),
+           right.cal_state == CAL_DONE ? "yes" : "no", rightEncoder->config.debounce_interval,
+           (unsigned long) right.illegal_transitions);
     fflush(stdout);
 
     int c = getchar();
@@ -164,11 +261,9 @@ static inline void monitor_system_info() {
       encoder_reset_calibration(rightEncoder);
       printf("\nCalibration cleared.\n");
     } else if (c == 'j') {
-      ws_encoder_publish(&ws_encoder_ctx, "rep", "left", leftEncoder,
-                         cal_state_names[leftEncoder->state.cal_state]);
+      ws_encoder_publish_rep("left", &left, cal_state_names[left.cal_state], NULL);
     } else if (c == 'k') {
-      ws_encoder_publish(&ws_encoder_ctx, "rep", "right", rightEncoder,
-                         cal_state_names[rightEncoder->state.cal_state]);
+      ws_encoder_publish_rep("right", &right, cal_state_names[right.cal_state], NULL);
     }
 
     vTaskDelay(pdMS_TO_TICKS(300));
@@ -255,13 +350,15 @@ void app_main(void) {
                                                           .format_if_mount_failed = false,
                                                           .dont_mount = false}));
 
-  // Web app
-  ESP_ERROR_CHECK(
-    esp_vfs_littlefs_register(&(esp_vfs_littlefs_conf_t) {.base_path = "/www",
-                                                          .partition_label = WWW_PARTLABEL,
-                                                          .format_if_mount_failed = false,
-                                                          .dont_mount = false,
-                                                          .read_only = true}));
+  // Web app: a packed asset image when flashed with ESP_LIFT_ASSET_PACK, LittleFS otherwise
+  if (asset_pack_open(WWW_PARTLABEL) != ESP_OK) {
+    ESP_ERROR_CHECK(
+      esp_vfs_littlefs_register(&(esp_vfs_littlefs_conf_t) {.base_path = "/www",
+                                                            .partition_label = WWW_PARTLABEL,
+                                                            .format_if_mount_failed = false,
+                                                            .dont_mount = false,
+                                                            .read_only = true}));
+  }
 
   /* Configuration from file */
   cJSON *config_cjson = cjson_read_from_file("/cfg/settings.json");
@@ -288,33 +385,47 @@ void app_main(void) {
   tls_cert_set_hostname(settings.hostname);
 
   /* Encoders */
-  encoder_cal_load_file(ENCODER_CAL_LEFT_PATH, &left_cal_state);
-  encoder_cal_load_file(ENCODER_CAL_RIGHT_PATH, &right_cal_state);
-  leftEncoder = init_encoder(
-    (encoder_config_t) {.pin_a = GPIO_NUM_11,
-                        .pin_b = GPIO_NUM_10,
-                        .pin_z = GPIO_NUM_9,
-                        .debounce_interval = settings.debounce_interval,
-                        .calibration_debounce_steps = settings.calibration_debounce_steps,
-                        .on_event_cb = encoder_event_handler},
-    &left_cal_state);
-  rightEncoder = init_encoder(
-    (encoder_config_t) {.pin_a = GPIO_NUM_14,
-                        .pin_b = GPIO_NUM_13,
-                        .pin_z = GPIO_NUM_12,
-                        .debounce_interval = settings.debounce_interval,
-                        .calibration_debounce_steps = settings.calibration_debounce_steps,
-                        .on_event_cb = encoder_event_handler},
-    &right_cal_state);
-
-  http_api_hardware_init(leftEncoder, rightEncoder);
-  ws_encoder_init(&ws_encoder_ctx, leftEncoder, rightEncoder);
-
-  rep_counter_init(&rep_counter);
+  ESP_ERROR_CHECK(persistence_start());
+  const encoder_driver_t *encoder_driver = resolve_encoder_driver(settings.encoder_driver);
+  ws_encoder_init(&ws_encoder_ctx);
+  for (size_t i = 0; i < ENCODER_STATION_COUNT; i++) {
+    const encoder_station_t *station = &encoder_stations[i];
+    encoder_cal_restore(i, station, &encoder_cal_states[i]);
+    encoder_t *encoder = init_encoder(
+      (encoder_config_t) {.name = station->name,
+                          .driver = encoder_driver,
+                          .pin_a = station->pin_a,
+                          .pin_b = station->pin_b,
+                          .pin_z = station->pin_z,
+                          .debounce_interval = settings.debounce_interval,
+                          .sample_period_ms = settings.encoder_sample_period_ms,
+                          .resolution = settings.encoder_resolution,
+                          .calibration_debounce_steps = settings.calibration_debounce_steps,
+                          .on_event_cb = encoder_event_handler},
+      &encoder_cal_states[i]);
+    if (!encoder || encoder->id != i) {
+      ESP_LOGE(TAG, "Failed to initialize %s encoder", station->name);
+      abort();
+    }
+    ws_encoder_define_topics(station->name, encoder->id);
+  }
+  leftEncoder = encoder_get(REP_SIDE_LEFT);
+  rightEncoder = encoder_get(REP_SIDE_RIGHT);
+
+  http_api_hardware_init();
+  ws_telemetry_start();
+
+  // A singular rep whose other side never came is reported once the sync window has passed
+  rep_counter_init(&rep_counter, encoder_publish_rep);
+  rep_counter_set_report_on_return(&rep_counter, settings.rep_on_return);
   ws_subscribe_message(ws_rep_counter_handle_message, &rep_counter);
+  if (workout_start(&rep_counter) != ESP_OK) ESP_LOGE(TAG, "Workout log unavailable");
+  ws_subscribe_message(ws_workout_handle_message, NULL);
 
   /* HTTP(S) Server */
-  https_server_config_t https_config = {.max_uri_handlers = get_captive_paths_count() + 10};
+  ws_set_frame_rate(settings.ws_frame_rate);
+  https_server_config_t https_config = {.max_uri_handlers = HTTPS_URI_HANDLERS,
+                                        .close_fn = ws_session_close};
   ESP_ERROR_CHECK(https_server_start(&https_config, register_http_handlers, NULL));
   http_redirect_server_config_t redirect_config = {.target_fn = captiveportal_fallback_target,
                                                    .target_ctx = NULL,
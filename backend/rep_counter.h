@@ -2,81 +2,536 @@
 #define REP_COUNTER_H
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "data/exercises.h"
 #include "encoder.h"
+#include "fixed.h"
 #include "utils.h"
 
 #define REP_DEADBAND_DEFAULT 10.0
+#define REP_VELOCITY_LOSS_DEFAULT 0.0 // disabled
+#define REP_SYNC_WINDOW_US 250000       // singular: max gap between the two sides of one rep
+#define REP_FLUSH_SLACK_US 5000 // so the flush timer fires after the window, not on its edge
 
 typedef enum { REP_SIDE_LEFT = 0, REP_SIDE_RIGHT = 1 } rep_side_t;
+#define REP_SIDE_COUNT 2
+
+/*
+ * A rep is a dip to the arm point (threshold - deadband), a rise to the threshold and a return
+ * to the arm point. The tracker follows every sample and yields a rep_record_t as soon as the
+ * rise crosses the threshold, so cues are not held back by the eccentric phase; the concentric
+ * phase then runs from the lowest point before the rise to the crossing, and there is no
+ * eccentric time. With report_on_return set, the rep is held until the return completes the
+ * cycle instead: concentric time then runs to the highest point and eccentric time from there
+ * back to the arm point. Fixed memory, O(1) per sample.
+ *
+ * Velocity-based training: with a velocity-loss target set, each rep's mean propulsive velocity
+ * is compared against the best rep of the set, and the first rep whose loss reaches the target is
+ * flagged stop_set. Only reps that are reported count: an alternating rep rejected for its side
+ * neither sets the best nor stops the set. Sets are delimited by the caller through
+ * rep_counter_new_set(). Positions have no metric scale, so the propulsive phase (acceleration
+ * above -g) cannot be located exactly; it is taken to end where the velocity falls below half its
+ * peak on the way up.
+ *
+ * The exercise type decides how the two sides combine. Singular: a rep completed on one side is
+ * held for REP_SYNC_WINDOW_US; if the other side completes within it, both are fused into one
+ * bilateral rep with left/right asymmetry, otherwise the held rep is reported alone (one-handed
+ * use). Alternating: a rep on the same side as the previous one is rejected, and each rep carries
+ * its asymmetry against the other side's last rep. EXERCISE_UNKNOWN counts sides independently.
+ * A held rep whose window runs out is handed to the flush callback from a one-shot esp_timer, so
+ * it is reported on time even when the bar comes to rest.
+ *
+ * Samples arrive on the encoder service task and configuration on the httpd task; every public
+ * function takes the counter's lock.
+ */
+
+typedef enum {
+  REP_PHASE_IDLE,       // waiting for the first dip to the arm point
+  REP_PHASE_BOTTOM,     // armed, tracking the lowest point until the threshold is crossed
+  REP_PHASE_ECCENTRIC,  // threshold crossed, tracking the top until back at the arm point
+} rep_phase_t;
+
+typedef struct {
+  rep_phase_t phase;
+  q16_t min_pos;
+  int64_t min_us; // when the bar was last at min_pos, or once rising, when it left it
+  bool rising;
+  q16_t max_pos;
+  int64_t max_us;
+  q16_t peak_velocity;
+  bool reported; // already yielded at the crossing; the return only re-arms
+  // End of the propulsive phase: the rise where velocity fell below half its peak
+  bool propulsive_ended;
+  q16_t propulsive_end_pos;
+  int64_t propulsive_end_us;
+} rep_tracker_t;
+
+typedef struct {
+  rep_side_t side;
+  q16_t rom;           // range of motion, calibrated %
+  q16_t peak_velocity; // concentric, %/s
+  q16_t mean_velocity; // concentric, %/s
+  q16_t mean_propulsive_velocity; // concentric up to the propulsive end, %/s
+  uint32_t concentric_ms;
+  uint32_t eccentric_ms;
+  uint32_t tut_ms;      // time under tension
+  q16_t velocity_loss;  // % below the set's best mean propulsive velocity, 0 when disabled
+  bool stop_set;        // this rep crossed the velocity-loss target
+
+  // Set when the asymmetry fields compare both sides; side is meaningless for fused reps
+  bool bilateral;
+  bool fused;               // singular: one rep made of both sides
+  q16_t rom_asymmetry;      // (left - right) / max * 100, positive when left is larger
+  q16_t velocity_asymmetry; // same, on mean propulsive velocity
+  uint32_t sync_ms;         // fused: gap between the two sides completing
+} rep_record_t;
+
+typedef void (*rep_counter_flush_fn)(const rep_record_t *record);
 
 typedef struct {
-  double thresholds[2];
-  double deadbands[2];
-  bool has_threshold[2];
-  bool armed[2];
+  SemaphoreHandle_t lock;
+  esp_timer_handle_t flush_timer;
+  rep_counter_flush_fn on_flush;
+
+  q16_t thresholds[REP_SIDE_COUNT];
+  q16_t deadbands[REP_SIDE_COUNT];
+  bool has_threshold[REP_SIDE_COUNT];
+  rep_tracker_t trackers[REP_SIDE_COUNT];
+
+  q16_t velocity_loss_targets[REP_SIDE_COUNT]; // %, 0 disables
+  q16_t best_mpv[REP_SIDE_COUNT];
+  bool set_stopped[REP_SIDE_COUNT];
+
+  bool report_on_return; // full-cycle kinematics at the cost of reporting late
+
+  exercise_type_t type;
+  // Singular: the rep waiting for the other side
+  bool has_pending;
+  rep_record_t pending;
+  int64_t pending_us;
+  // Alternating: the previous accepted rep per side, and which side may go next
+  bool has_last[REP_SIDE_COUNT];
+  rep_record_t last[REP_SIDE_COUNT];
+  bool has_last_side;
+  rep_side_t last_side;
 } rep_counter_t;
 
-void rep_counter_init(rep_counter_t *counter) {
+/**
+ * Reports a singular rep whose other side never completed within REP_SYNC_WINDOW_US. Returns
+ * true when record_out (if given) holds such a rep.
+ */
+bool rep_counter_poll(rep_counter_t *counter, int64_t now_us, rep_record_t *record_out) {
+  if (!counter || !counter->lock) return false;
+
+  xSemaphoreTake(counter->lock, portMAX_DELAY);
+  bool due = counter->has_pending && now_us - counter->pending_us > REP_SYNC_WINDOW_US;
+  if (due) {
+    if (record_out) *record_out = counter->pending;
+    counter->has_pending = false;
+  }
+  xSemaphoreGive(counter->lock);
+  return due;
+}
+
+static void rep_counter_flush_timer_cb(void *arg) {
+  rep_counter_t *counter = (rep_counter_t *) arg;
+  rep_record_t record;
+  if (rep_counter_poll(counter, esp_timer_get_time(), &record) && counter->on_flush) {
+    counter->on_flush(&record);
+  }
+}
+
+/**
+ * on_flush receives singular reps reported alone after their sync window, from the esp_timer
+ * task; reps completed by a sample are returned by rep_counter_check() instead.
+ */
+void rep_counter_init(rep_counter_t *counter, rep_counter_flush_fn on_flush) {
   if (!counter) return;
-  counter->thresholds[REP_SIDE_LEFT] = 0.0;
-  counter->thresholds[REP_SIDE_RIGHT] = 0.0;
-  counter->deadbands[REP_SIDE_LEFT] = REP_DEADBAND_DEFAULT;
-  counter->deadbands[REP_SIDE_RIGHT] = REP_DEADBAND_DEFAULT;
+  counter->lock = xSemaphoreCreateMutex();
+  counter->on_flush = on_flush;
+  esp_timer_create_args_t timer_args = {.callback = rep_counter_flush_timer_cb,
+                                        .arg = counter,
+                                        .dispatch_method = ESP_TIMER_TASK,
+                                        .name = "rep_flush"};
+  if (esp_timer_create(&timer_args, &counter->flush_timer) != ESP_OK) {
+    counter->flush_timer = NULL;
+  }
+  counter->thresholds[REP_SIDE_LEFT] = CAL_MIN;
+  counter->thresholds[REP_SIDE_RIGHT] = CAL_MIN;
+  counter->deadbands[REP_SIDE_LEFT] = q16_from_double(REP_DEADBAND_DEFAULT);
+  counter->deadbands[REP_SIDE_RIGHT] = q16_from_double(REP_DEADBAND_DEFAULT);
   counter->has_threshold[REP_SIDE_LEFT] = false;
   counter->has_threshold[REP_SIDE_RIGHT] = false;
-  counter->armed[REP_SIDE_LEFT] = false;
-  counter->armed[REP_SIDE_RIGHT] = false;
+  counter->trackers[REP_SIDE_LEFT].phase = REP_PHASE_IDLE;
+  counter->trackers[REP_SIDE_RIGHT].phase = REP_PHASE_IDLE;
+  for (size_t side = 0; side < REP_SIDE_COUNT; side++) {
+    counter->velocity_loss_targets[side] = 0;
+    counter->best_mpv[side] = 0;
+    counter->set_stopped[side] = false;
+    counter->has_last[side] = false;
+  }
+  counter->type = EXERCISE_UNKNOWN;
+  counter->has_pending = false;
+  counter->has_last_side = false;
+}
+
+/**
+ * Selects how the two sides combine into reps. A change drops any half-finished pairing.
+ */
+void rep_counter_set_type(rep_counter_t *counter, exercise_type_t type) {
+  if (!counter || !counter->lock) return;
+
+  xSemaphoreTake(counter->lock, portMAX_DELAY);
+  if (counter->type != type) {
+    counter->type = type;
+    counter->has_pending = false;
+    counter->has_last_side = false;
+    for (size_t side = 0; side < REP_SIDE_COUNT; side++) {
+      counter->has_last[side] = false;
+    }
+    ESP_LOGI("REP_COUNTER", "Exercise type: %s", exercise_type_to_string(type));
+  }
+  xSemaphoreGive(counter->lock);
 }
 
 void rep_counter_set_threshold(rep_counter_t *counter, rep_side_t side, double threshold,
-                               double deadband) {
-  if (!counter) return;
+                               double deadband, double velocity_loss) {
+  if (!counter || !counter->lock) return;
 
   double clamped_threshold = clamp_double(threshold, 0.0, 100.0);
   double clamped_deadband = clamp_double(deadband, 0.0, 100.0);
+  double clamped_velocity_loss = clamp_double(velocity_loss, 0.0, 100.0);
+  q16_t new_threshold = q16_from_double(clamped_threshold);
+  q16_t new_deadband = q16_from_double(clamped_deadband);
+  q16_t new_velocity_loss = q16_from_double(clamped_velocity_loss);
+
+  xSemaphoreTake(counter->lock, portMAX_DELAY);
+  // Thresholds are resent on every reconnect; only a real change starts a new set
+  if (counter->has_threshold[side] && counter->thresholds[side] == new_threshold &&
+      counter->deadbands[side] == new_deadband &&
+      counter->velocity_loss_targets[side] == new_velocity_loss) {
+    xSemaphoreGive(counter->lock);
+    return;
+  }
 
-  counter->thresholds[side] = clamped_threshold;
-  counter->deadbands[side] = clamped_deadband;
+  counter->thresholds[side] = new_threshold;
+  counter->deadbands[side] = new_deadband;
+  counter->velocity_loss_targets[side] = new_velocity_loss;
   counter->has_threshold[side] = true;
-  counter->armed[side] = false;
+  counter->trackers[side].phase = REP_PHASE_IDLE;
+  counter->best_mpv[side] = 0;
+  counter->set_stopped[side] = false;
+  counter->has_pending = false;
+  counter->has_last_side = false;
+  counter->has_last[side] = false;
+  xSemaphoreGive(counter->lock);
 
-  ESP_LOGI("REP_COUNTER", "Threshold updated: %s -> %.1f (band: %.1f)",
-           side == REP_SIDE_LEFT ? "left" : "right", clamped_threshold, clamped_deadband);
+  ESP_LOGI("REP_COUNTER", "Threshold updated: %s -> %.1f (band: %.1f, velocity loss: %.1f)",
+           side == REP_SIDE_LEFT ? "left" : "right", clamped_threshold, clamped_deadband,
+           clamped_velocity_loss);
+}
+
+/**
+ * Starts a new set: velocity loss is measured against this set's reps only, and the stop event
+ * may fire again.
+ */
+void rep_counter_new_set(rep_counter_t *counter) {
+  if (!counter || !counter->lock) return;
+  xSemaphoreTake(counter->lock, portMAX_DELAY);
+  for (size_t side = 0; side < REP_SIDE_COUNT; side++) {
+    counter->best_mpv[side] = 0;
+    counter->set_stopped[side] = false;
+  }
+  xSemaphoreGive(counter->lock);
+}
+
+/**
+ * Chooses when reps are reported: at the threshold crossing (default), or on the return to the
+ * arm point with eccentric and full concentric kinematics.
+ */
+void rep_counter_set_report_on_return(rep_counter_t *counter, bool report_on_return) {
+  if (!counter || !counter->lock) return;
+  xSemaphoreTake(counter->lock, portMAX_DELAY);
+  counter->report_on_return = report_on_return;
+  xSemaphoreGive(counter->lock);
 }
 
 static bool rep_counter_ready(rep_counter_t *counter) {
   return counter->has_threshold[REP_SIDE_LEFT] && counter->has_threshold[REP_SIDE_RIGHT];
 }
 
-bool rep_counter_check(rep_counter_t *counter, rep_side_t side, double position,
-                       calibration_state_t cal_state) {
-  if (!counter) return false;
-  if (!rep_counter_ready(counter)) return false;
-  if (cal_state != CAL_DONE) {
-    counter->armed[side] = false;
+static inline void rep_tracker_arm(rep_tracker_t *tracker, q16_t pos, int64_t timestamp_us) {
+  tracker->phase = REP_PHASE_BOTTOM;
+  tracker->min_pos = pos;
+  tracker->min_us = timestamp_us;
+  tracker->rising = false;
+  tracker->peak_velocity = 0;
+  tracker->reported = false;
+  tracker->propulsive_ended = false;
+}
+
+static inline uint32_t rep_elapsed_ms(int64_t from_us, int64_t to_us) {
+  return to_us > from_us ? (uint32_t) ((to_us - from_us) / 1000) : 0;
+}
+
+static void rep_tracker_finish(const rep_tracker_t *tracker, rep_side_t side,
+                               int64_t timestamp_us, rep_record_t *record) {
+  int64_t concentric_us = tracker->max_us - tracker->min_us;
+
+  record->side = side;
+  record->rom = tracker->max_pos - tracker->min_pos;
+  record->peak_velocity = tracker->peak_velocity;
+  record->mean_velocity =
+    concentric_us > 0 ? (q16_t) ((int64_t) record->rom * 1000000 / concentric_us) : 0;
+  q16_t propulsive_end_pos =
+    tracker->propulsive_ended ? tracker->propulsive_end_pos : tracker->max_pos;
+  int64_t propulsive_us =
+    (tracker->propulsive_ended ? tracker->propulsive_end_us : tracker->max_us) - tracker->min_us;
+  record->mean_propulsive_velocity =
+    propulsive_us > 0
+      ? (q16_t) ((int64_t) (propulsive_end_pos - tracker->min_pos) * 1000000 / propulsive_us)
+      : record->mean_velocity;
+  record->concentric_ms = rep_elapsed_ms(tracker->min_us, tracker->max_us);
+  record->eccentric_ms = rep_elapsed_ms(tracker->max_us, timestamp_us);
+  record->tut_ms = rep_elapsed_ms(tracker->min_us, timestamp_us);
+  record->velocity_loss = 0;
+  record->stop_set = false;
+  record->bilateral = false;
+  record->fused = false;
+  record->rom_asymmetry = 0;
+  record->velocity_asymmetry = 0;
+  record->sync_ms = 0;
+}
+
+static void rep_counter_apply_velocity_loss(rep_counter_t *counter, rep_side_t side,
+                                            rep_record_t *record) {
+  q16_t target = counter->velocity_loss_targets[side];
+  if (target <= 0) return;
+
+  q16_t mpv = record->mean_propulsive_velocity;
+  if (mpv >= counter->best_mpv[side]) {
+    counter->best_mpv[side] = mpv;
+    return;
+  }
+
+  q16_t best = counter->best_mpv[side];
+  record->velocity_loss = (q16_t) ((int64_t) (best - mpv) * Q16_FROM_INT(100) / best);
+  if (record->velocity_loss >= target && !counter->set_stopped[side]) {
+    counter->set_stopped[side] = true;
+    record->stop_set = true;
+  }
+}
+
+// (left - right) / max(|left|, |right|) * 100
+static inline q16_t rep_asymmetry(q16_t left, q16_t right) {
+  q16_t left_abs = left < 0 ? -left : left;
+  q16_t right_abs = right < 0 ? -right : right;
+  q16_t max = left_abs > right_abs ? left_abs : right_abs;
+  if (max == 0) return 0;
+  return (q16_t) ((int64_t) (left - right) * Q16_FROM_INT(100) / max);
+}
+
+static void rep_record_set_asymmetry(rep_record_t *record, const rep_record_t *left,
+                                     const rep_record_t *right) {
+  record->bilateral = true;
+  record->rom_asymmetry = rep_asymmetry(left->rom, right->rom);
+  record->velocity_asymmetry =
+    rep_asymmetry(left->mean_propulsive_velocity, right->mean_propulsive_velocity);
+}
+
+static inline q16_t rep_mean(q16_t a, q16_t b) { return (q16_t) (((int64_t) a + b) / 2); }
+
+// Singular: both sides of one rep as a single record. Kinematics are the mean of the sides,
+// except that either side reaching the velocity-loss target stops the set.
+static void rep_record_fuse(const rep_record_t *a, const rep_record_t *b, uint32_t sync_ms,
+                            rep_record_t *out) {
+  const rep_record_t *left = a->side == REP_SIDE_LEFT ? a : b;
+  const rep_record_t *right = a->side == REP_SIDE_LEFT ? b : a;
+
+  *out = *left;
+  out->rom = rep_mean(left->rom, right->rom);
+  out->peak_velocity = rep_mean(left->peak_velocity, right->peak_velocity);
+  out->mean_velocity = rep_mean(left->mean_velocity, right->mean_velocity);
+  out->mean_propulsive_velocity =
+    rep_mean(left->mean_propulsive_velocity, right->mean_propulsive_velocity);
+  out->concentric_ms = (left->concentric_ms + right->concentric_ms) / 2;
+  out->eccentric_ms = (left->eccentric_ms + right->eccentric_ms) / 2;
+  out->tut_ms = (left->tut_ms + right->tut_ms) / 2;
+  out->velocity_loss =
+    left->velocity_loss > right->velocity_loss ? left->velocity_loss : right->velocity_loss;
+  out->stop_set = left->stop_set || right->stop_set;
+  out->fused = true;
+  out->sync_ms = sync_ms;
+  rep_record_set_asymmetry(out, left, right);
+}
+
+// Alternating: a rep on the same side as the previous one is not counted
+static bool rep_counter_rejects(const rep_counter_t *counter, rep_side_t side) {
+  if (counter->type != EXERCISE_ALTERNATING) return false;
+  return counter->has_last_side && counter->last_side == side;
+}
+
+/**
+ * Combines a rep completed by one side according to the exercise type, once rep_counter_rejects()
+ * has let it through. Returns true when a rep should be reported, in which case out holds it.
+ */
+static bool rep_counter_combine(rep_counter_t *counter, const rep_record_t *record,
+                                int64_t timestamp_us, rep_record_t *out) {
+  rep_side_t side = record->side;
+  rep_side_t other = side == REP_SIDE_LEFT ? REP_SIDE_RIGHT : REP_SIDE_LEFT;
+
+  switch (counter->type) {
+  case EXERCISE_SINGULAR:
+    if (counter->has_pending && counter->pending.side == other &&
+        timestamp_us - counter->pending_us <= REP_SYNC_WINDOW_US) {
+      rep_record_fuse(&counter->pending, record,
+                      rep_elapsed_ms(counter->pending_us, timestamp_us), out);
+      counter->has_pending = false;
+      return true;
+    }
+    // Whatever was held did not pair up; report it alone and hold this one instead
+    bool flushed = counter->has_pending;
+    if (flushed) *out = counter->pending;
+    counter->pending = *record;
+    counter->pending_us = timestamp_us;
+    counter->has_pending = true;
+    if (counter->flush_timer) {
+      esp_timer_stop(counter->flush_timer);
+      esp_timer_start_once(counter->flush_timer, REP_SYNC_WINDOW_US + REP_FLUSH_SLACK_US);
+    }
+    return flushed;
+
+  case EXERCISE_ALTERNATING:
+    *out = *record;
+    if (counter->has_last[other]) {
+      if (side == REP_SIDE_LEFT) {
+        rep_record_set_asymmetry(out, record, &counter->last[other]);
+      } else {
+        rep_record_set_asymmetry(out, &counter->last[other], record);
+      }
+    }
+    counter->last[side] = *record;
+    counter->has_last[side] = true;
+    counter->last_side = side;
+    counter->has_last_side = true;
+    return true;
+
+  default:
+    *out = *record;
+    return true;
+  }
+}
+
+static bool rep_counter_report(rep_counter_t *counter, rep_record_t *record, int64_t timestamp_us,
+                               rep_record_t *record_out) {
+  rep_side_t side = record->side;
+  if (rep_counter_rejects(counter, side)) {
+    ESP_LOGD("REP_COUNTER", "Rejected %s rep: expected %s",
+             side == REP_SIDE_LEFT ? "left" : "right", side == REP_SIDE_LEFT ? "right" : "left");
     return false;
   }
 
-  double pos = clamp_double(position, 0.0, 100.0);
-  double threshold = counter->thresholds[side];
-  double deadband = counter->deadbands[side];
-  double arm_point = clamp_double(threshold - deadband, 0.0, 100.0);
-  double fire_point = clamp_double(threshold, 0.0, 100.0);
+  rep_counter_apply_velocity_loss(counter, side, record);
+  rep_record_t combined;
+  if (!rep_counter_combine(counter, record, timestamp_us, &combined)) return false;
+  if (record_out) *record_out = combined;
+  return true;
+}
 
-  if (!counter->armed[side] && pos <= arm_point) {
-    counter->armed[side] = true;
+// rep_counter_check() with the lock held
+static bool rep_counter_track(rep_counter_t *counter, rep_side_t side, q16_t position,
+                              q16_t velocity, int64_t timestamp_us, calibration_state_t cal_state,
+                              rep_record_t *record_out) {
+  if (!rep_counter_ready(counter)) return false;
+
+  rep_tracker_t *tracker = &counter->trackers[side];
+  if (cal_state != CAL_DONE) {
+    tracker->phase = REP_PHASE_IDLE;
     return false;
   }
 
-  if (counter->armed[side] && pos >= fire_point) {
-    counter->armed[side] = false;
-    return true;
+  q16_t pos = q16_clamp(position, CAL_MIN, CAL_MAX);
+  q16_t threshold = counter->thresholds[side];
+  q16_t deadband = counter->deadbands[side];
+  q16_t arm_point = q16_clamp(threshold - deadband, CAL_MIN, CAL_MAX);
+  q16_t fire_point = q16_clamp(threshold, CAL_MIN, CAL_MAX);
+
+  switch (tracker->phase) {
+  case REP_PHASE_IDLE:
+    if (pos <= arm_point) rep_tracker_arm(tracker, pos, timestamp_us);
+    break;
+
+  case REP_PHASE_BOTTOM:
+    // A new low restarts the concentric phase
+    if (pos <= tracker->min_pos) {
+      rep_tracker_arm(tracker, pos, timestamp_us);
+      break;
+    }
+    // Nothing is sampled while the bar rests, so time the concentric phase from the first sample
+    // above the low rather than the last one at it
+    if (!tracker->rising) {
+      tracker->rising = true;
+      tracker->min_us = timestamp_us;
+    }
+    if (velocity > tracker->peak_velocity) tracker->peak_velocity = velocity;
+    if (pos >= fire_point) {
+      tracker->phase = REP_PHASE_ECCENTRIC;
+      tracker->max_pos = pos;
+      tracker->max_us = timestamp_us;
+      if (!counter->report_on_return) {
+        rep_record_t record;
+        rep_tracker_finish(tracker, side, timestamp_us, &record);
+        tracker->reported = true;
+        return rep_counter_report(counter, &record, timestamp_us, record_out);
+      }
+    }
+    break;
+
+  case REP_PHASE_ECCENTRIC:
+    if (pos >= tracker->max_pos) {
+      tracker->max_pos = pos;
+      tracker->max_us = timestamp_us;
+      if (velocity > tracker->peak_velocity) tracker->peak_velocity = velocity;
+      if (!tracker->propulsive_ended && velocity < tracker->peak_velocity / 2) {
+        tracker->propulsive_ended = true;
+        tracker->propulsive_end_pos = pos;
+        tracker->propulsive_end_us = timestamp_us;
+      }
+    }
+    if (pos <= arm_point) {
+      bool report = !tracker->reported;
+      rep_record_t record;
+      if (report) rep_tracker_finish(tracker, side, timestamp_us, &record);
+      rep_tracker_arm(tracker, pos, timestamp_us);
+      if (report) return rep_counter_report(counter, &record, timestamp_us, record_out);
+    }
+    break;
   }
 
   return false;
 }
 
+/**
+ * Feeds one sample. Returns true when a rep is to be reported, in which case record_out (if
+ * given) holds its kinematics. Depending on the exercise type that rep may belong to the other
+ * side or to both.
+ */
+bool rep_counter_check(rep_counter_t *counter, rep_side_t side, q16_t position, q16_t velocity,
+                       int64_t timestamp_us, calibration_state_t cal_state,
+                       rep_record_t *record_out) {
+  if (!counter || !counter->lock) return false;
+
+  xSemaphoreTake(counter->lock, portMAX_DELAY);
+  bool reported = rep_counter_track(counter, side, position, velocity, timestamp_us, cal_state,
+                                    record_out);
+  xSemaphoreGive(counter->lock);
+  return reported;
+}
+
 #endif
@@ -9,41 +9,59 @@
 #include <stdbool.h>
 #include <uuid.h>
 
+#define HTTP_API_EXERCISES_URI_HANDLERS 3
+
 esp_err_t get_exercises_handler(httpd_req_t *req);
 esp_err_t post_exercises_handler(httpd_req_t *req);
 esp_err_t delete_exercises_handler(httpd_req_t *req);
 
 void http_api_exercises_register(httpd_handle_t server, const char *exercises_json) {
+  ESP_ERROR_CHECK(exercises_store_init(exercises_json));
   ESP_ERROR_CHECK(
     httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/api/exercises",
                                                        .method = HTTP_GET,
                                                        .handler = get_exercises_handler,
-                                                       .user_ctx = (void *) exercises_json}));
+                                                       .user_ctx = NULL}));
   ESP_ERROR_CHECK(
     httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/api/exercises",
                                                        .method = HTTP_POST,
                                                        .handler = post_exercises_handler,
-                                                       .user_ctx = (void *) exercises_json}));
+                                                       .user_ctx = NULL}));
 
   ESP_ERROR_CHECK(
     httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/api/exercises",
                                                        .method = HTTP_DELETE,
                                                        .handler = delete_exercises_handler,
-                                                       .user_ctx = (void *) exercises_json}));
+                                                       .user_ctx = NULL}));
 }
 
+// Served from the store's cached document; a matching If-None-Match gets a 304
 esp_err_t get_exercises_handler(httpd_req_t *req) {
   httpd_log_request(req, "HTTP_API_EXERCISES");
   char *json_string = NULL;
+  size_t json_len = 0;
+  char etag[EXERCISES_ETAG_LEN];
+
+  if (exercises_store_snapshot(NULL, NULL, etag, sizeof(etag)) != EXIT_SUCCESS) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to load exercises");
+    return ESP_FAIL;
+  }
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  if (httpd_req_etag_matches(req, etag)) {
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, NULL, 0);
+  }
 
-  if (exercises_store_load_json_string((char *) req->user_ctx, &json_string) != EXIT_SUCCESS) {
+  if (exercises_store_snapshot(&json_string, &json_len, etag, sizeof(etag)) != EXIT_SUCCESS) {
     httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to load exercises");
     return ESP_FAIL;
   }
 
+  httpd_resp_set_hdr(req, "ETag", etag);
   httpd_resp_set_type(req, "application/json");
-  esp_err_t res = httpd_resp_send(req, json_string, HTTPD_RESP_USE_STRLEN);
-  if(json_string) free(json_string);
+  esp_err_t res = httpd_resp_send(req, json_string, json_len);
+  free(json_string);
   return res;
 }
 
@@ -65,6 +83,9 @@ esp_err_t post_exercises_handler(httpd_req_t *req) {
   cJSON *category_name = cJSON_GetObjectItemCaseSensitive(req_json, "categoryName");
   cJSON *rep_band = cJSON_GetObjectItemCaseSensitive(req_json, "repBand");
   double rep_band_value = cJSON_IsNumber(rep_band) ? rep_band->valuedouble : EXERCISE_DEFAULT_REP_BAND;
+  cJSON *velocity_loss = cJSON_GetObjectItemCaseSensitive(req_json, "velocityLoss");
+  double velocity_loss_value = cJSON_IsNumber(velocity_loss) ? velocity_loss->valuedouble
+                                                             : EXERCISE_VELOCITY_LOSS_KEEP;
 
   if (!cJSON_IsString(name) || !cJSON_IsNumber(threshold) || !cJSON_IsString(type)) {
     httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing or invalid fields");
@@ -86,9 +107,10 @@ esp_err_t post_exercises_handler(httpd_req_t *req) {
                                               .category_name = cJSON_IsString(category_name)
                                                                  ? category_name->valuestring
                                                                  : NULL,
-                                              .rep_band = rep_band_value};
+                                              .rep_band = rep_band_value,
+                                              .velocity_loss = velocity_loss_value};
 
-  if (exercises_store_upsert((char *) req->user_ctx, &request) != EXIT_SUCCESS) {
+  if (exercises_store_upsert(&request) != EXIT_SUCCESS) {
     httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to add exercise");
     goto cleanup;
   }
@@ -119,7 +141,7 @@ esp_err_t delete_exercises_handler(httpd_req_t *req) {
   char name_decoded[128];
   url_decode(name_decoded, name_value);
 
-  if (exercises_store_delete((char *) req->user_ctx, name_decoded) != EXIT_SUCCESS) {
+  if (exercises_store_delete(name_decoded) != EXIT_SUCCESS) {
     httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Exercise not found");
     goto cleanup;
   }
@@ -8,9 +8,10 @@
 #include "../../encoder.h"
 #include "../../utils.h"
 
+#define HTTP_API_HARDWARE_URI_HANDLERS 3
+
 typedef struct {
-  encoder_t *left_encoder;
-  encoder_t *right_encoder;
+  bool initialized;
 } http_api_hardware_context_t;
 
 static http_api_hardware_context_t http_api_hardware_context = {0};
@@ -19,10 +20,8 @@ esp_err_t calibrate_handler(httpd_req_t *req);
 esp_err_t calibrate_zero_handler(httpd_req_t *req);
 esp_err_t restart_handler(httpd_req_t *req);
 
-void http_api_hardware_init(encoder_t *left_encoder, encoder_t *right_encoder) {
-  http_api_hardware_context.left_encoder = left_encoder;
-  http_api_hardware_context.right_encoder = right_encoder;
-}
+// Calibration endpoints act on every registered encoder
+void http_api_hardware_init(void) { http_api_hardware_context.initialized = encoder_count() > 0; }
 
 void http_api_hardware_register(httpd_handle_t server) {
   ESP_ERROR_CHECK(httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/api/calibrate",
@@ -43,13 +42,14 @@ esp_err_t calibrate_handler(httpd_req_t *req) {
   http_api_hardware_context_t *ctx = (http_api_hardware_context_t *) req->user_ctx;
   httpd_log_request(req, "HTTP_API_HARDWARE");
 
-  if (!ctx || !ctx->left_encoder || !ctx->right_encoder) {
+  if (!ctx || !ctx->initialized) {
     httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Encoders are not initialized");
     return ESP_FAIL;
   }
 
-  encoder_reset_calibration(ctx->left_encoder);
-  encoder_reset_calibration(ctx->right_encoder);
+  for (size_t i = 0; i < encoder_count(); i++) {
+    encoder_reset_calibration(encoder_get(i));
+  }
   httpd_resp_send(req, "Clearing calibration...", HTTPD_RESP_USE_STRLEN);
   return ESP_OK;
 }
@@ -58,13 +58,14 @@ esp_err_t calibrate_zero_handler(httpd_req_t *req) {
   http_api_hardware_context_t *ctx = (http_api_hardware_context_t *) req->user_ctx;
   httpd_log_request(req, "HTTP_API_HARDWARE");
 
-  if (!ctx || !ctx->left_encoder || !ctx->right_encoder) {
+  if (!ctx || !ctx->initialized) {
     httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Encoders are not initialized");
     return ESP_FAIL;
   }
 
-  encoder_zero_calibrated(ctx->left_encoder);
-  encoder_zero_calibrated(ctx->right_encoder);
+  for (size_t i = 0; i < encoder_count(); i++) {
+    encoder_zero_calibrated(encoder_get(i));
+  }
   httpd_resp_send(req, "Zeroed calibrated position...", HTTPD_RESP_USE_STRLEN);
   return ESP_OK;
 }
@@ -0,0 +1,450 @@
+#ifndef HTTP_API_HISTORY_H
+#define HTTP_API_HISTORY_H
+
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../store/workout_log.h"
+#include "../../utils.h"
+
+/*
+ * GET /api/history?from=&to=&exercise=&metric=&points=&mode=
+ *
+ * from/to are epoch milliseconds (inclusive, default: the whole log), exercise filters by name.
+ * Without points every record in range is streamed. With points, one metric is downsampled to at
+ * most that many points over equal time buckets: mode=bucket (default) reports min/max/mean per
+ * bucket, mode=lttb picks one representative record per bucket by largest triangle three
+ * buckets, using the neighbouring buckets' averages as anchors. The response is chunked and
+ * built in a fixed buffer. Bucket mode keeps only the current bucket, and LTTB one average per
+ * point, so memory is bounded by HTTP_API_HISTORY_MAX_POINTS whatever the range.
+ */
+
+#define HTTP_API_HISTORY_TAG "HTTP_API_HISTORY"
+#define HTTP_API_HISTORY_CHUNK 1024
+#define HTTP_API_HISTORY_MAX_POINTS 512
+#define HTTP_API_HISTORY_QUERY_MAX 192
+#define HTTP_API_HISTORY_RECORD_MAX 384 // longest JSON line for one record
+#define HTTP_API_HISTORY_URI_HANDLERS 1
+
+typedef enum {
+  HISTORY_METRIC_MPV,
+  HISTORY_METRIC_PEAK_VELOCITY,
+  HISTORY_METRIC_ROM,
+  HISTORY_METRIC_VELOCITY_LOSS,
+  HISTORY_METRIC_SET_REPS,
+  HISTORY_METRIC_UNKNOWN,
+} history_metric_t;
+
+static const char *const history_metric_names[] = {
+  [HISTORY_METRIC_MPV] = "mpv",
+  [HISTORY_METRIC_PEAK_VELOCITY] = "peak_velocity",
+  [HISTORY_METRIC_ROM] = "rom",
+  [HISTORY_METRIC_VELOCITY_LOSS] = "velocity_loss",
+  [HISTORY_METRIC_SET_REPS] = "set_reps",
+};
+
+static const char *const history_record_type_names[] = {
+  [WORKOUT_RECORD_SESSION_START] = "session_start",
+  [WORKOUT_RECORD_SESSION_END] = "session_end",
+  [WORKOUT_RECORD_SET_START] = "set_start",
+  [WORKOUT_RECORD_SET_END] = "set_end",
+  [WORKOUT_RECORD_REP] = "rep",
+};
+
+typedef struct {
+  float t; // ms after the range start
+  float v;
+  uint32_t count;
+} history_bucket_t;
+
+typedef struct {
+  httpd_req_t *req;
+  char buf[HTTP_API_HISTORY_CHUNK];
+  size_t len;
+  esp_err_t err;
+  bool first; // no element written yet
+
+  char exercise[WORKOUT_EXERCISE_NAME_LEN];
+  bool has_exercise;
+  history_metric_t metric;
+
+  // Downsampling
+  int64_t from_ms;
+  int64_t width_ms;
+  size_t points;
+  history_bucket_t bucket;   // bucket mode: the one being accumulated
+  history_bucket_t *buckets; // lttb: averages from the first pass
+  size_t current;
+  bool has_current;
+  float min;
+  float max;
+  float best_area;
+  float best_t;
+  float best_v;
+  float anchor_t; // lttb: last selected point
+  float anchor_v;
+} history_query_t;
+
+static void history_flush(history_query_t *query) {
+  if (query->err == ESP_OK && query->len > 0) {
+    query->err = httpd_resp_send_chunk(query->req, query->buf, query->len);
+  }
+  query->len = 0;
+}
+
+static void history_printf(history_query_t *query, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void history_printf(history_query_t *query, const char *fmt, ...) {
+  if (query->err != ESP_OK) return;
+  if (sizeof(query->buf) - query->len < HTTP_API_HISTORY_RECORD_MAX) history_flush(query);
+
+  size_t room = sizeof(query->buf) - query->len;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(query->buf + query->len, room, fmt, args);
+  va_end(args);
+  if (n > 0) query->len += (size_t) n < room ? (size_t) n : room - 1;
+}
+
+static inline const char *history_separator(history_query_t *query) {
+  if (query->first) {
+    query->first = false;
+    return "";
+  }
+  return ",";
+}
+
+static history_metric_t history_metric_from_string(const char *name) {
+  for (size_t i = 0; i < HISTORY_METRIC_UNKNOWN; i++) {
+    if (strcmp(name, history_metric_names[i]) == 0) return (history_metric_t) i;
+  }
+  return HISTORY_METRIC_UNKNOWN;
+}
+
+static inline bool history_matches(const history_query_t *query, const workout_record_t *record) {
+  return !query->has_exercise ||
+         strncmp(record->exercise, query->exercise, WORKOUT_EXERCISE_NAME_LEN) == 0;
+}
+
+// Extracts the metric; false when the record does not carry it
+static bool history_metric_value(history_metric_t metric, const workout_record_t *record,
+                                 float *out) {
+  if (metric == HISTORY_METRIC_SET_REPS) {
+    if (record->type != WORKOUT_RECORD_SET_END) return false;
+    *out = (float) record->summary.reps;
+    return true;
+  }
+  if (record->type != WORKOUT_RECORD_REP) return false;
+
+  switch (metric) {
+  case HISTORY_METRIC_MPV:
+    *out = (float) q16_to_double(record->rep.mean_propulsive_velocity);
+    return true;
+  case HISTORY_METRIC_PEAK_VELOCITY:
+    *out = (float) q16_to_double(record->rep.peak_velocity);
+    return true;
+  case HISTORY_METRIC_ROM:
+    *out = (float) q16_to_double(record->rep.rom);
+    return true;
+  case HISTORY_METRIC_VELOCITY_LOSS:
+    *out = (float) q16_to_double(record->rep.velocity_loss);
+    return true;
+  default:
+    return false;
+  }
+}
+
+static inline const char *history_side_name(uint8_t side) {
+  switch (side) {
+  case WORKOUT_SIDE_LEFT:
+    return "left";
+  case WORKOUT_SIDE_RIGHT:
+    return "right";
+  case WORKOUT_SIDE_BOTH:
+    return "both";
+  default:
+    return "";
+  }
+}
+
+// JSON-escapes a log exercise name; out must hold 2 * WORKOUT_EXERCISE_NAME_LEN + 1
+static void history_escape(char *out, const char *name) {
+  size_t len = 0;
+  for (size_t i = 0; i < WORKOUT_EXERCISE_NAME_LEN && name[i]; i++) {
+    unsigned char c = (unsigned char) name[i];
+    if (c < 0x20) continue;
+    if (c == '"' || c == '\\') out[len++] = '\\';
+    out[len++] = (char) c;
+  }
+  out[len] = '\0';
+}
+
+static bool history_visit_raw(const workout_record_t *record, void *ctx) {
+  history_query_t *query = (history_query_t *) ctx;
+  if (!history_matches(query, record)) return true;
+  if (record->type < WORKOUT_RECORD_SESSION_START || record->type > WORKOUT_RECORD_REP) {
+    return true;
+  }
+
+  char exercise[2 * WORKOUT_EXERCISE_NAME_LEN + 1];
+  history_escape(exercise, record->exercise);
+
+  history_printf(query,
+                 "%s{\"type\": \"%s\", \"t\": %lld, \"synced\": %s, \"session\": %u, "
+                 "\"set\": %u, \"exercise\": \"%s\"",
+                 history_separator(query), history_record_type_names[record->type],
+                 (long long) record->time_ms,
+                 (record->flags & WORKOUT_RECORD_FLAG_CLOCK_SYNCED) ? "true" : "false",
+                 (unsigned) record->session, (unsigned) record->set, exercise);
+
+  if (record->type == WORKOUT_RECORD_REP) {
+    history_printf(query,
+                   ", \"side\": \"%s\", \"rom\": %.1f, \"peak_velocity\": %.1f, "
+                   "\"mean_propulsive_velocity\": %.1f, \"velocity_loss\": %.1f, "
+                   "\"concentric_ms\": %u, \"eccentric_ms\": %u, \"stop_set\": %s",
+                   history_side_name(record->side), q16_to_double(record->rep.rom),
+                   q16_to_double(record->rep.peak_velocity),
+                   q16_to_double(record->rep.mean_propulsive_velocity),
+                   q16_to_double(record->rep.velocity_loss),
+                   (unsigned) record->rep.concentric_ms, (unsigned) record->rep.eccentric_ms,
+                   (record->flags & WORKOUT_RECORD_FLAG_STOP_SET) ? "true" : "false");
+    if (record->flags & WORKOUT_RECORD_FLAG_BILATERAL) {
+      history_printf(query, ", \"rom_asymmetry\": %.1f, \"velocity_asymmetry\": %.1f",
+                     record->rep.rom_asymmetry / 10.0, record->rep.velocity_asymmetry / 10.0);
+    }
+  } else if (record->type == WORKOUT_RECORD_SET_END) {
+    history_printf(query,
+                   ", \"reps\": %u, \"duration_ms\": %lu, \"best_mpv\": %.1f, "
+                   "\"max_velocity_loss\": %.1f",
+                   (unsigned) record->summary.reps, (unsigned long) record->summary.duration_ms,
+                   q16_to_double(record->summary.best_mpv),
+                   q16_to_double(record->summary.max_velocity_loss));
+  } else if (record->type == WORKOUT_RECORD_SESSION_END) {
+    history_printf(query, ", \"sets\": %u, \"duration_ms\": %lu",
+                   (unsigned) record->summary.reps, (unsigned long) record->summary.duration_ms);
+  }
+  history_printf(query, "}");
+
+  return query->err == ESP_OK;
+}
+
+static inline size_t history_bucket_of(const history_query_t *query, int64_t time_ms) {
+  size_t bucket = (size_t) ((time_ms - query->from_ms) / query->width_ms);
+  return bucket < query->points ? bucket : query->points - 1;
+}
+
+static void history_emit_bucket(history_query_t *query) {
+  if (!query->has_current) return;
+  history_bucket_t *bucket = &query->bucket;
+  history_printf(query,
+                 "%s{\"t\": %lld, \"count\": %lu, \"min\": %.2f, \"max\": %.2f, \"mean\": %.2f}",
+                 history_separator(query), (long long) (query->from_ms + (int64_t) bucket->t),
+                 (unsigned long) bucket->count, query->min, query->max, bucket->v);
+}
+
+// Bucket aggregates: one pass, only the current bucket is live
+static bool history_visit_bucket(const workout_record_t *record, void *ctx) {
+  history_query_t *query = (history_query_t *) ctx;
+  float value;
+  if (!history_matches(query, record) || !history_metric_value(query->metric, record, &value)) {
+    return true;
+  }
+
+  size_t index = history_bucket_of(query, record->time_ms);
+  if (!query->has_current || index != query->current) {
+    history_emit_bucket(query);
+    query->current = index;
+    query->has_current = true;
+    query->bucket = (history_bucket_t) {.t = (float) (index * query->width_ms)};
+    query->min = value;
+    query->max = value;
+  }
+
+  history_bucket_t *bucket = &query->bucket;
+  bucket->count++;
+  bucket->v += (value - bucket->v) / (float) bucket->count;
+  if (value < query->min) query->min = value;
+  if (value > query->max) query->max = value;
+  return query->err == ESP_OK;
+}
+
+// LTTB first pass: the average point of every bucket
+static bool history_visit_average(const workout_record_t *record, void *ctx) {
+  history_query_t *query = (history_query_t *) ctx;
+  float value;
+  if (!history_matches(query, record) || !history_metric_value(query->metric, record, &value)) {
+    return true;
+  }
+
+  history_bucket_t *bucket = &query->buckets[history_bucket_of(query, record->time_ms)];
+  float t = (float) (record->time_ms - query->from_ms);
+  bucket->count++;
+  bucket->t += (t - bucket->t) / (float) bucket->count;
+  bucket->v += (value - bucket->v) / (float) bucket->count;
+  return true;
+}
+
+// The next non-empty bucket's average, or the current one's for the last bucket
+static const history_bucket_t *history_next_average(const history_query_t *query, size_t index) {
+  for (size_t i = index + 1; i < query->points; i++) {
+    if (query->buckets[i].count > 0) return &query->buckets[i];
+  }
+  return &query->buckets[index];
+}
+
+static void history_emit_selected(history_query_t *query) {
+  if (!query->has_current) return;
+  history_printf(query, "%s[%lld, %.2f]", history_separator(query),
+                 (long long) (query->from_ms + (int64_t) query->best_t), query->best_v);
+  query->anchor_t = query->best_t;
+  query->anchor_v = query->best_v;
+}
+
+// LTTB second pass: per bucket, the record spanning the largest triangle with the last selected
+// point and the next bucket's average
+static bool history_visit_lttb(const workout_record_t *record, void *ctx) {
+  history_query_t *query = (history_query_t *) ctx;
+  float value;
+  if (!history_matches(query, record) || !history_metric_value(query->metric, record, &value)) {
+    return true;
+  }
+
+  size_t index = history_bucket_of(query, record->time_ms);
+  if (!query->has_current || index != query->current) {
+    history_emit_selected(query);
+    if (!query->has_current) {
+      query->anchor_t = query->buckets[index].t;
+      query->anchor_v = query->buckets[index].v;
+    }
+    query->current = index;
+    query->has_current = true;
+    query->best_area = -1.0f;
+  }
+
+  const history_bucket_t *next = history_next_average(query, index);
+  float t = (float) (record->time_ms - query->from_ms);
+  float area = (query->anchor_t - next->t) * (value - query->anchor_v) -
+               (query->anchor_t - t) * (next->v - query->anchor_v);
+  if (area < 0) area = -area;
+  if (area > query->best_area) {
+    query->best_area = area;
+    query->best_t = t;
+    query->best_v = value;
+  }
+  return query->err == ESP_OK;
+}
+
+static bool history_query_param(const char *query_str, const char *key, char *out, size_t len) {
+  if (httpd_query_key_value(query_str, key, out, len) != ESP_OK) return false;
+  url_decode(out, out);
+  return true;
+}
+
+esp_err_t get_history_handler(httpd_req_t *req) {
+  httpd_log_request(req, HTTP_API_HISTORY_TAG);
+  esp_err_t res = ESP_FAIL;
+
+  history_query_t *query = calloc(1, sizeof(history_query_t));
+  if (!query) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    return ESP_ERR_NO_MEM;
+  }
+  query->req = req;
+  query->first = true;
+  query->metric = HISTORY_METRIC_MPV;
+
+  int64_t from_ms = INT64_MIN;
+  int64_t to_ms = INT64_MAX;
+  bool lttb = false;
+
+  char query_str[HTTP_API_HISTORY_QUERY_MAX];
+  if (httpd_req_get_url_query_str(req, query_str, sizeof(query_str)) == ESP_OK) {
+    char value[64];
+    if (history_query_param(query_str, "from", value, sizeof(value))) {
+      from_ms = strtoll(value, NULL, 10);
+    }
+    if (history_query_param(query_str, "to", value, sizeof(value))) {
+      to_ms = strtoll(value, NULL, 10);
+    }
+    if (history_query_param(query_str, "exercise", value, sizeof(value))) {
+      strncpy(query->exercise, value, sizeof(query->exercise));
+      query->has_exercise = true;
+    }
+    if (history_query_param(query_str, "metric", value, sizeof(value))) {
+      query->metric = history_metric_from_string(value);
+    }
+    if (history_query_param(query_str, "points", value, sizeof(value))) {
+      query->points = (size_t) strtoul(value, NULL, 10);
+    }
+    if (history_query_param(query_str, "mode", value, sizeof(value))) {
+      lttb = strcmp(value, "lttb") == 0;
+    }
+  }
+
+  if (query->metric == HISTORY_METRIC_UNKNOWN) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown metric");
+    goto cleanup;
+  }
+  if (query->points > HTTP_API_HISTORY_MAX_POINTS) query->points = HTTP_API_HISTORY_MAX_POINTS;
+
+  // Buckets need a finite range; clamp open ends to what the log holds
+  int64_t first_ms, last_ms;
+  bool has_records = workout_log_bounds(&first_ms, &last_ms);
+  if (query->points > 0 && has_records) {
+    if (from_ms < first_ms) from_ms = first_ms;
+    if (to_ms > last_ms) to_ms = last_ms;
+  }
+
+  httpd_resp_set_type(req, "application/json");
+  if (query->points == 0) {
+    history_printf(query, "{\"records\": [");
+    if (has_records) workout_log_read(from_ms, to_ms, history_visit_raw, query);
+    history_printf(query, "]}");
+  } else {
+    history_printf(query, "{\"metric\": \"%s\", \"mode\": \"%s\", \"points\": [",
+                   history_metric_names[query->metric], lttb ? "lttb" : "bucket");
+    if (has_records && from_ms <= to_ms) {
+      query->from_ms = from_ms;
+      query->width_ms = (to_ms - from_ms) / (int64_t) query->points + 1;
+      if (!lttb) {
+        workout_log_read(from_ms, to_ms, history_visit_bucket, query);
+        history_emit_bucket(query);
+      } else if ((query->buckets = calloc(query->points, sizeof(history_bucket_t))) != NULL) {
+        workout_log_read(from_ms, to_ms, history_visit_average, query);
+        workout_log_read(from_ms, to_ms, history_visit_lttb, query);
+        history_emit_selected(query);
+      } else {
+        query->err = ESP_ERR_NO_MEM;
+      }
+    }
+    history_printf(query, "]}");
+  }
+  history_flush(query);
+
+  if (query->err != ESP_OK) {
+    ESP_LOGW(HTTP_API_HISTORY_TAG, "History response aborted: %s", esp_err_to_name(query->err));
+    goto cleanup;
+  }
+  res = httpd_resp_send_chunk(req, NULL, 0);
+
+cleanup:
+  free(query->buckets);
+  free(query);
+  return res;
+}
+
+void http_api_history_register(httpd_handle_t server) {
+  ESP_ERROR_CHECK(httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/api/history",
+                                                                     .method = HTTP_GET,
+                                                                     .handler = get_history_handler,
+                                                                     .user_ctx = NULL}));
+}
+
+#endif
@@ -9,6 +9,8 @@
 #include <stdbool.h>
 #include <string.h>
 
+#define HTTP_API_SETTINGS_URI_HANDLERS 2
+
 esp_err_t get_settings_handler(httpd_req_t *req);
 esp_err_t post_settings_handler(httpd_req_t *req);
 void app_hostname_changed(const char *hostname);
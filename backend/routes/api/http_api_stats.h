@@ -0,0 +1,114 @@
+#ifndef HTTP_API_STATS_H
+#define HTTP_API_STATS_H
+
+#include <cJSON.h>
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../store/stats_store.h"
+#include "../../utils.h"
+
+#define HTTP_API_STATS_URI_HANDLERS 1
+
+esp_err_t get_stats_handler(httpd_req_t *req);
+
+void http_api_stats_register(httpd_handle_t server) {
+  ESP_ERROR_CHECK(httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/api/stats",
+                                                                     .method = HTTP_GET,
+                                                                     .handler = get_stats_handler,
+                                                                     .user_ctx = NULL}));
+}
+
+static cJSON *stats_row_to_json(const stats_row_t *row) {
+  char user[STATS_USER_NAME_LEN + 1] = {0};
+  char exercise[WORKOUT_EXERCISE_NAME_LEN + 1] = {0};
+  memcpy(user, row->user, STATS_USER_NAME_LEN);
+  memcpy(exercise, row->exercise, WORKOUT_EXERCISE_NAME_LEN);
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddStringToObject(json, "user", user);
+  if (exercise[0]) {
+    cJSON_AddStringToObject(json, "exercise", exercise);
+  } else {
+    cJSON_AddNullToObject(json, "exercise");
+  }
+  cJSON_AddNumberToObject(json, "lastMs", (double) row->last_ms);
+  cJSON_AddNumberToObject(json, "totalReps", row->total_reps);
+  cJSON_AddNumberToObject(json, "totalSets", row->total_sets);
+  cJSON_AddNumberToObject(json, "bestMpv", q16_to_double(row->best_mpv));
+  cJSON_AddNumberToObject(json, "bestPeakVelocity", q16_to_double(row->best_peak_velocity));
+  cJSON_AddNumberToObject(json, "bestRom", q16_to_double(row->best_rom));
+
+  // Newest week first
+  cJSON *weeks = cJSON_AddArrayToObject(json, "weeks");
+  bool used[STATS_WEEKS] = {false};
+  for (size_t n = 0; n < STATS_WEEKS; n++) {
+    const stats_week_t *newest = NULL;
+    size_t newest_index = 0;
+    for (size_t i = 0; i < STATS_WEEKS; i++) {
+      if (used[i] || row->weeks[i].week == 0) continue;
+      if (!newest || row->weeks[i].week > newest->week) {
+        newest = &row->weeks[i];
+        newest_index = i;
+      }
+    }
+    if (!newest) break;
+    used[newest_index] = true;
+
+    cJSON *week = cJSON_CreateObject();
+    cJSON_AddNumberToObject(week, "startMs", (double) stats_week_start_ms(newest->week));
+    cJSON_AddNumberToObject(week, "reps", newest->reps);
+    cJSON_AddNumberToObject(week, "sets", newest->sets);
+    cJSON_AddNumberToObject(week, "rom", newest->rom);
+    cJSON_AddItemToArray(weeks, week);
+  }
+  return json;
+}
+
+/*
+ * GET /api/stats?user=  Aggregates straight from the in-memory table; no log access.
+ */
+esp_err_t get_stats_handler(httpd_req_t *req) {
+  httpd_log_request(req, "HTTP_API_STATS");
+  esp_err_t res = ESP_FAIL;
+  char *json_string = NULL;
+  cJSON *root = NULL;
+
+  char query[96];
+  char user[64];
+  bool has_user = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                  httpd_query_key_value(query, "user", user, sizeof(user)) == ESP_OK;
+  if (has_user) url_decode(user, user);
+
+  stats_row_t *rows = malloc(STATS_MAX_ROWS * sizeof(stats_row_t));
+  if (!rows) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    goto cleanup;
+  }
+  size_t count = stats_store_snapshot(has_user ? user : NULL, rows, STATS_MAX_ROWS);
+
+  root = cJSON_CreateObject();
+  cJSON *stats = cJSON_AddArrayToObject(root, "stats");
+  for (size_t i = 0; i < count; i++) {
+    cJSON_AddItemToArray(stats, stats_row_to_json(&rows[i]));
+  }
+
+  json_string = cJSON_PrintUnformatted(root);
+  if (!json_string) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to serialize stats");
+    goto cleanup;
+  }
+
+  httpd_resp_set_type(req, "application/json");
+  res = httpd_resp_send(req, json_string, HTTPD_RESP_USE_STRLEN);
+
+cleanup:
+  free(json_string);
+  if (root) cJSON_Delete(root);
+  free(rows);
+  return res;
+}
+
+#endif
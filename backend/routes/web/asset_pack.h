@@ -0,0 +1,143 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Read side of the web app image built by frontend/scripts/pack-assets.mjs. The whole image is
+ * memory-mapped once; lookups binary-search the sorted entry table and hand out pointers into
+ * flash, so serving an asset needs neither the filesystem nor the heap. Strings and offsets in
+ * the image are relative to its start.
+ */
+
+#define ASSET_PACK_TAG "ASSET_PACK"
+#define ASSET_PACK_MAGIC 0x314B504C // "LPK1"
+#define ASSET_PACK_VERSION 1
+
+typedef enum {
+  ASSET_PACK_IDENTITY,
+  ASSET_PACK_GZIP,
+  ASSET_PACK_BR,
+  ASSET_PACK_VARIANTS,
+} asset_pack_variant_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t entries;
+  uint32_t strings;
+  uint32_t data;
+  uint32_t size;
+  uint8_t reserved[8];
+} asset_pack_header_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t offset;
+  uint32_t length; // 0 when the variant is missing
+  uint32_t etag;   // quoted strong ETag
+} asset_pack_blob_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t path;
+  uint32_t content_type;
+  asset_pack_blob_t variants[ASSET_PACK_VARIANTS];
+} asset_pack_entry_t;
+
+_Static_assert(sizeof(asset_pack_header_t) == 32, "asset_pack_header_t must stay 32 bytes");
+_Static_assert(sizeof(asset_pack_entry_t) == 44, "asset_pack_entry_t must stay 44 bytes");
+
+typedef struct {
+  const uint8_t *base;
+  const asset_pack_entry_t *entries;
+  size_t count;
+  esp_partition_mmap_handle_t handle;
+} asset_pack_t;
+
+static asset_pack_t asset_pack = {0};
+
+static inline bool asset_pack_ready(void) { return asset_pack.base != NULL; }
+
+static inline const char *asset_pack_string(uint32_t offset) {
+  return (const char *) asset_pack.base + offset;
+}
+
+/**
+ * Maps the pack in the given partition. ESP_ERR_NOT_FOUND means the partition holds something
+ * else (a LittleFS image), which callers should fall back to.
+ */
+esp_err_t asset_pack_open(const char *partition_label) {
+  if (asset_pack_ready()) return ESP_OK;
+
+  const esp_partition_t *partition =
+    esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+  if (!partition) return ESP_ERR_NOT_FOUND;
+
+  asset_pack_header_t header;
+  esp_err_t err = esp_partition_read(partition, 0, &header, sizeof(header));
+  if (err != ESP_OK) return err;
+  if (header.magic != ASSET_PACK_MAGIC) return ESP_ERR_NOT_FOUND;
+  if (header.version != ASSET_PACK_VERSION || header.size > partition->size ||
+      header.entries + (size_t) header.count * sizeof(asset_pack_entry_t) > header.size ||
+      header.strings > header.size || header.data > header.size) {
+    ESP_LOGE(ASSET_PACK_TAG, "Invalid asset pack in %s", partition_label);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  const void *base = NULL;
+  err = esp_partition_mmap(partition, 0, header.size, ESP_PARTITION_MMAP_DATA, &base,
+                           &asset_pack.handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(ASSET_PACK_TAG, "Could not map %s: %s", partition_label, esp_err_to_name(err));
+    return err;
+  }
+
+  asset_pack.base = (const uint8_t *) base;
+  asset_pack.entries = (const asset_pack_entry_t *) (asset_pack.base + header.entries);
+  asset_pack.count = header.count;
+  ESP_LOGI(ASSET_PACK_TAG, "Serving %u assets from %s", (unsigned) header.count, partition_label);
+  return ESP_OK;
+}
+
+/**
+ * Finds the entry for path, compared up to len bytes (so a query string can be left attached).
+ */
+const asset_pack_entry_t *asset_pack_find(const char *path, size_t len) {
+  if (!asset_pack_ready() || !path) return NULL;
+
+  size_t low = 0;
+  size_t high = asset_pack.count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    const char *name = asset_pack_string(asset_pack.entries[mid].path);
+    int cmp = strncmp(name, path, len);
+    if (cmp == 0 && name[len] != '\0') cmp = 1;
+    if (cmp == 0) return &asset_pack.entries[mid];
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return NULL;
+}
+
+static inline const asset_pack_blob_t *asset_pack_variant(const asset_pack_entry_t *entry,
+                                                          asset_pack_variant_t variant) {
+  if (!entry || variant >= ASSET_PACK_VARIANTS || entry->variants[variant].length == 0) {
+    return NULL;
+  }
+  return &entry->variants[variant];
+}
+
+static inline const void *asset_pack_data(const asset_pack_blob_t *blob) {
+  return asset_pack.base + blob->offset;
+}
+
+#endif
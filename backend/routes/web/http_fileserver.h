@@ -3,145 +3,518 @@
 
 #include <esp_http_server.h>
 #include <esp_log.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 
 #include "../../utils.h"
+#include "asset_pack.h"
 
+#define FILESERVER_TAG "HTTP_FILESERVER"
 #define SCRATCH_BUFSIZE 8192
+// Written by the frontend build: one "<sha256 prefix> <path>" line per file in dist
+#define STATIC_MANIFEST_NAME "assets.sha256"
+#define STATIC_MAX_ASSETS 128
+#define STATIC_ETAG_LEN 19 // 16 hex digits, quoted, NUL
+#define STATIC_PATH_MAX 128
+#define FILESERVER_URI_HANDLERS 2 // GET and HEAD
+
+// Precompressed siblings written by the frontend build, indexed by asset_pack_variant_t
+static const char *const variant_suffixes[ASSET_PACK_VARIANTS] = {"", ".gz", ".br"};
+static const char *const variant_encodings[ASSET_PACK_VARIANTS] = {NULL, "gzip", "br"};
+// Most preferred first
+static const asset_pack_variant_t variant_preference[] = {ASSET_PACK_BR, ASSET_PACK_GZIP,
+                                                          ASSET_PACK_IDENTITY};
+#define VARIANT_BIT(v) (1u << (v))
+#define VARIANT_COMPRESSED_MASK (VARIANT_BIT(ASSET_PACK_GZIP) | VARIANT_BIT(ASSET_PACK_BR))
+
+typedef struct {
+  const char *extension;
+  const char *type;
+} mime_type_t;
+
+static const mime_type_t mime_types[] = {
+  {"html", "text/html"},
+  {"css", "text/css"},
+  {"js", "application/javascript"},
+  {"json", "application/json"},
+  {"png", "image/png"},
+  {"ico", "image/x-icon"},
+  {"svg", "image/svg+xml"},
+  {"mp3", "audio/mpeg"},
+  {"webmanifest", "application/manifest+json"},
+};
+
+/*
+ * Response metadata for every file listed in the build manifest, resolved once at startup so a
+ * request needs one lookup, and a conditional GET no filesystem access at all.
+ */
+typedef struct {
+  char *path; // as requested, without the encoding suffix
+  const char *mime_type;
+  const char *cache_control;
+  uint8_t variants; // VARIANT_BIT of each file present
+  char etags[ASSET_PACK_VARIANTS][STATIC_ETAG_LEN];
+} static_asset_t;
+
+static static_asset_t *static_assets = NULL;
+static size_t static_asset_count = 0;
+
+// Headers of a file response, kept together because bodies are written with httpd_send()
+typedef struct {
+  const char *content_type;
+  const char *cache_control;
+  const char *etag;
+  const char *encoding; // Content-Encoding, NULL for identity
+  bool vary;
+} file_response_t;
+
+typedef struct {
+  size_t start;
+  size_t length;
+} byte_range_t;
 
 esp_err_t path_handler(httpd_req_t *req);
 
+static const char *mime_type_for(const char *path, size_t len) {
+  const char *dot = NULL;
+  for (size_t i = len; i-- > 0 && path[i] != '/';) {
+    if (path[i] == '.') {
+      dot = &path[i];
+      break;
+    }
+  }
+  if (dot) {
+    size_t ext_len = len - (size_t) (dot + 1 - path);
+    for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+      if (strlen(mime_types[i].extension) == ext_len &&
+          strncasecmp(dot + 1, mime_types[i].extension, ext_len) == 0) {
+        return mime_types[i].type;
+      }
+    }
+  }
+  return "application/octet-stream";
+}
+
+// HTML is revalidated every time; everything else carries a content hash in its name
+static const char *cache_control_for(const char *mime_type) {
+  return strcmp(mime_type, "text/html") == 0 ? "no-cache" : "public, max-age=31536000, immutable";
+}
+
+static int static_asset_compare(const void *a, const void *b) {
+  return strcmp(((const static_asset_t *) a)->path, ((const static_asset_t *) b)->path);
+}
+
+/**
+ * Loads the build manifest under base_path into the in-RAM table. Without one every request
+ * falls back to stat() and weak ETags.
+ */
+static void static_manifest_load(const char *base_path) {
+  if (static_assets) return;
+
+  char manifest_path[64];
+  snprintf(manifest_path, sizeof(manifest_path), "%s/%s", base_path, STATIC_MANIFEST_NAME);
+  FILE *file = fopen(manifest_path, "r");
+  if (!file) {
+    ESP_LOGW(FILESERVER_TAG, "No %s; serving without strong ETags", manifest_path);
+    return;
+  }
+
+  static_asset_t *assets = calloc(STATIC_MAX_ASSETS, sizeof(static_asset_t));
+  if (!assets) {
+    fclose(file);
+    return;
+  }
+
+  size_t count = 0;
+  char line[STATIC_PATH_MAX + 24];
+  while (fgets(line, sizeof(line), file)) {
+    char hash[17];
+    char path[STATIC_PATH_MAX];
+    if (sscanf(line, "%16s %127s", hash, path) != 2 || path[0] != '/') continue;
+
+    size_t path_len = strlen(path);
+    asset_pack_variant_t variant = ASSET_PACK_IDENTITY;
+    for (size_t v = ASSET_PACK_GZIP; v < ASSET_PACK_VARIANTS; v++) {
+      size_t suffix_len = strlen(variant_suffixes[v]);
+      if (path_len > suffix_len && strcmp(path + path_len - suffix_len, variant_suffixes[v]) == 0) {
+        path[path_len - suffix_len] = '\0';
+        variant = (asset_pack_variant_t) v;
+        break;
+      }
+    }
+
+    static_asset_t *asset = NULL;
+    for (size_t i = 0; i < count; i++) {
+      if (strcmp(assets[i].path, path) == 0) asset = &assets[i];
+    }
+    if (!asset) {
+      if (count >= STATIC_MAX_ASSETS) break;
+      asset = &assets[count];
+      asset->path = strdup(path);
+      if (!asset->path) break;
+      asset->mime_type = mime_type_for(path, strlen(path));
+      asset->cache_control = cache_control_for(asset->mime_type);
+      count++;
+    }
+    asset->variants |= VARIANT_BIT(variant);
+    snprintf(asset->etags[variant], STATIC_ETAG_LEN, "\"%s\"", hash);
+  }
+  fclose(file);
+
+  qsort(assets, count, sizeof(static_asset_t), static_asset_compare);
+  static_assets = assets;
+  static_asset_count = count;
+  ESP_LOGI(FILESERVER_TAG, "Loaded metadata for %u assets", (unsigned) count);
+}
+
+static const static_asset_t *static_asset_find(const char *path, size_t len) {
+  size_t low = 0;
+  size_t high = static_asset_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    const char *name = static_assets[mid].path;
+    int cmp = strncmp(name, path, len);
+    if (cmp == 0 && name[len] != '\0') cmp = 1;
+    if (cmp == 0) return &static_assets[mid];
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return NULL;
+}
+
 void http_fileserver_register(httpd_handle_t server, const char *base_path) {
+  if (!asset_pack_ready()) static_manifest_load(base_path);
   ESP_ERROR_CHECK(httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "*",
                                                                      .method = HTTP_GET,
                                                                      .handler = path_handler,
                                                                      .user_ctx = (void *) base_path}));
+  ESP_ERROR_CHECK(httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "*",
+                                                                     .method = HTTP_HEAD,
+                                                                     .handler = path_handler,
+                                                                     .user_ctx = (void *) base_path}));
 }
 
-static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename) {
-  if (strstr(filename, ".html")) {
-    return httpd_resp_set_type(req, "text/html");
-  } else if (strstr(filename, ".css")) {
-    return httpd_resp_set_type(req, "text/css");
-  } else if (strstr(filename, ".js")) {
-    return httpd_resp_set_type(req, "application/javascript");
-  } else if (strstr(filename, ".json")) {
-    return httpd_resp_set_type(req, "application/json");
-  } else if (strstr(filename, ".png")) {
-    return httpd_resp_set_type(req, "image/png");
-  } else if (strstr(filename, ".ico")) {
-    return httpd_resp_set_type(req, "image/x-icon");
-  } else if (strstr(filename, ".svg")) {
-    return httpd_resp_set_type(req, "image/svg+xml");
-  } else if (strstr(filename, ".mp3")) {
-    return httpd_resp_set_type(req, "audio/mpeg");
-  } else if (strstr(filename, ".webmanifest")) {
-    return httpd_resp_set_type(req, "application/manifest+json");
+// True when Accept-Encoding lists token (or *) without q=0
+static bool accepts_encoding(const char *accept_encoding, const char *token) {
+  size_t token_len = strlen(token);
+  const char *p = accept_encoding;
+  while (*p) {
+    while (*p == ' ' || *p == ',') p++;
+    const char *end = p + strcspn(p, ",");
+    size_t name_len = strcspn(p, " ;,");
+    bool named = (name_len == token_len && strncasecmp(p, token, token_len) == 0) ||
+                 (name_len == 1 && *p == '*');
+    if (named) {
+      const char *q = strstr(p, "q=");
+      if (!q || q > end) return true;
+      return strtod(q + 2, NULL) > 0;
+    }
+    p = end;
   }
-  return httpd_resp_set_type(req, "application/octet-stream");
+  return false;
 }
 
-static bool is_html_file(const char *filename) {
-  return filename && (strstr(filename, ".html") != NULL);
-}
+/*
+ * Picks the most preferred of the present variants (VARIANT_BIT mask) the client accepts and fills
+ * in the response's Vary and Content-Encoding. Returns -1 when none is acceptable.
+ */
+static int select_variant(httpd_req_t *req, uint8_t present, file_response_t *response) {
+  char accept_encoding[128] = {0};
+  httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept_encoding, sizeof(accept_encoding));
+  response->vary = present & VARIANT_COMPRESSED_MASK;
 
-static void set_cache_headers(httpd_req_t *req, const char *filepath) {
-  if (is_html_file(filepath)) {
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
-  } else {
-    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=31536000, immutable");
+  for (size_t i = 0; i < sizeof(variant_preference) / sizeof(variant_preference[0]); i++) {
+    asset_pack_variant_t variant = variant_preference[i];
+    if (!(present & VARIANT_BIT(variant))) continue;
+    const char *encoding = variant_encodings[variant];
+    if (!encoding || accepts_encoding(accept_encoding, encoding)) {
+      response->encoding = encoding;
+      return variant;
+    }
   }
+  return -1;
 }
 
-static bool request_etag_matches(httpd_req_t *req, const char *etag) {
-  if (!etag || !etag[0]) return false;
+/*
+ * Resolves a single "bytes=" Range against a representation of total bytes, honouring If-Range.
+ * Returns 1 with range filled in, 0 to send everything, or -1 when the range is unsatisfiable.
+ * Multiple ranges are answered with the whole representation, which the spec allows.
+ */
+static int request_range(httpd_req_t *req, const char *etag, size_t total, byte_range_t *range) {
+  *range = (byte_range_t) {.start = 0, .length = total};
 
-  size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
-  if (len == 0) return false;
+  char header[64];
+  if (httpd_req_get_hdr_value_str(req, "Range", header, sizeof(header)) != ESP_OK) return 0;
+  if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',')) return 0;
 
-  char *if_none_match = malloc(len + 1);
-  if (!if_none_match) return false;
-
-  bool matched = false;
-  if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, len + 1) == ESP_OK) {
-    if (strstr(if_none_match, etag) != NULL) {
-      matched = true;
+  // If-Range needs a strong match; a changed file is sent whole
+  if (httpd_req_get_hdr_value_len(req, "If-Range") > 0) {
+    char if_range[64];
+    if (strncmp(etag, "W/", 2) == 0 ||
+        httpd_req_get_hdr_value_str(req, "If-Range", if_range, sizeof(if_range)) != ESP_OK ||
+        strcmp(if_range, etag) != 0) {
+      return 0;
     }
   }
 
-  free(if_none_match);
-  return matched;
-}
-
-esp_err_t path_handler(httpd_req_t *req) {
-  esp_err_t ret = ESP_FAIL;
-  httpd_log_request(req, "HTTP_FILESERVER");
-  const char *base_path = (const char *) req->user_ctx;
-  char filepath[600];
+  const char *spec = header + 6;
+  char *end;
+  if (*spec == '-') {
+    unsigned long long suffix = strtoull(spec + 1, &end, 10);
+    if (end == spec + 1 || *end) return 0;
+    if (suffix == 0 || total == 0) return -1;
+    if (suffix > total) suffix = total;
+    *range = (byte_range_t) {.start = total - suffix, .length = suffix};
+    return 1;
+  }
 
-  if (strcmp(req->uri, "/") == 0) {
-    snprintf(filepath, sizeof(filepath), "%s/index.html", base_path);
-  } else {
-    snprintf(filepath, sizeof(filepath), "%s%s", base_path, req->uri);
+  unsigned long long first = strtoull(spec, &end, 10);
+  if (end == spec || *end != '-') return 0;
+  unsigned long long last = ULLONG_MAX;
+  const char *last_spec = end + 1;
+  if (*last_spec) {
+    last = strtoull(last_spec, &end, 10);
+    if (end == last_spec || *end || last < first) return 0;
   }
+  if (first >= total) return -1;
+  if (last >= total) last = total - 1;
+  *range = (byte_range_t) {.start = first, .length = last - first + 1};
+  return 1;
+}
 
-  ESP_LOGI("HTTP_FILESERVER", "Serving file: %s", filepath);
+static esp_err_t send_not_acceptable(httpd_req_t *req) {
+  httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+  httpd_resp_set_status(req, "406 Not Acceptable");
+  return httpd_resp_send(req, "Only available compressed", HTTPD_RESP_USE_STRLEN);
+}
 
-  struct stat st;
-  bool has_stat = (stat(filepath, &st) == 0);
+static esp_err_t send_not_modified(httpd_req_t *req, const file_response_t *response) {
+  httpd_resp_set_hdr(req, "Cache-Control", response->cache_control);
+  httpd_resp_set_hdr(req, "ETag", response->etag);
+  if (response->vary) httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+  httpd_resp_set_status(req, "304 Not Modified");
+  return httpd_resp_send(req, NULL, 0);
+}
 
-  set_cache_headers(req, filepath);
+static esp_err_t send_range_not_satisfiable(httpd_req_t *req, size_t total) {
+  char content_range[32];
+  snprintf(content_range, sizeof(content_range), "bytes */%u", (unsigned) total);
+  httpd_resp_set_hdr(req, "Content-Range", content_range);
+  httpd_resp_set_status(req, "416 Range Not Satisfiable");
+  return httpd_resp_send(req, NULL, 0);
+}
 
-  char etag[64] = {0};
-  if (has_stat) {
-    snprintf(etag, sizeof(etag), "W/\"%lx-%lx\"", (unsigned long) st.st_mtime,
-             (unsigned long) st.st_size);
-    httpd_resp_set_hdr(req, "ETag", etag);
+static esp_err_t send_all(httpd_req_t *req, const char *buf, size_t len) {
+  while (len > 0) {
+    int sent = httpd_send(req, buf, len);
+    if (sent <= 0) return ESP_FAIL;
+    buf += sent;
+    len -= (size_t) sent;
   }
+  return ESP_OK;
+}
 
-  if (has_stat && request_etag_matches(req, etag)) {
-    httpd_resp_set_status(req, "304 Not Modified");
-    return httpd_resp_send(req, NULL, 0);
+/*
+ * Writes the status line and headers directly: httpd_resp_send() always sends a body, which HEAD
+ * must not, and httpd_resp_send_chunk() cannot carry a Content-Length.
+ */
+static esp_err_t send_response_head(httpd_req_t *req, const file_response_t *response,
+                                    bool partial, const byte_range_t *range, size_t total) {
+  char content_range[64] = "";
+  if (partial) {
+    snprintf(content_range, sizeof(content_range), "Content-Range: bytes %u-%u/%u\r\n",
+             (unsigned) range->start, (unsigned) (range->start + range->length - 1),
+             (unsigned) total);
   }
 
+  char head[512];
+  int len = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %u\r\n"
+                     "Accept-Ranges: bytes\r\n"
+                     "Cache-Control: %s\r\n"
+                     "ETag: %s\r\n"
+                     "%s%s%s%s%s"
+                     "\r\n",
+                     partial ? "206 Partial Content" : "200 OK", response->content_type,
+                     (unsigned) range->length, response->cache_control, response->etag,
+                     response->vary ? "Vary: Accept-Encoding\r\n" : "",
+                     response->encoding ? "Content-Encoding: " : "",
+                     response->encoding ? response->encoding : "", response->encoding ? "\r\n" : "",
+                     content_range);
+  if (len < 0 || (size_t) len >= sizeof(head)) return ESP_FAIL;
+  return send_all(req, head, (size_t) len);
+}
+
+// Sends a representation that is already in memory, or the requested part of it
+static esp_err_t send_buffer(httpd_req_t *req, const file_response_t *response, const void *data,
+                             size_t total) {
+  byte_range_t range;
+  int ranged = request_range(req, response->etag, total, &range);
+  if (ranged < 0) return send_range_not_satisfiable(req, total);
+
+  esp_err_t err = send_response_head(req, response, ranged > 0, &range, total);
+  if (err != ESP_OK || req->method == HTTP_HEAD) return err;
+  return send_all(req, (const char *) data + range.start, range.length);
+}
+
+// Streams a file, or the requested part of it, from the seek offset without reading what precedes
+static esp_err_t send_file(httpd_req_t *req, const file_response_t *response,
+                           const char *filepath) {
+  esp_err_t ret = ESP_FAIL;
+  char *chunk = NULL;
+  ESP_LOGI(FILESERVER_TAG, "Serving file: %s", filepath);
+
   FILE *fd = fopen(filepath, "r");
   if (!fd) {
-    ESP_LOGE("HTTP_FILESERVER", "Failed to read existing file : %s", filepath);
-    httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
+    ESP_LOGE(FILESERVER_TAG, "Failed to read existing file : %s", filepath);
+    ret = httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
+    goto cleanup;
+  }
+
+  long size = fseek(fd, 0, SEEK_END) == 0 ? ftell(fd) : -1;
+  if (size < 0) {
+    ret = httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read file");
     goto cleanup;
   }
 
-  set_content_type_from_file(req, filepath);
+  byte_range_t range;
+  int ranged = request_range(req, response->etag, (size_t) size, &range);
+  if (ranged < 0) {
+    ret = send_range_not_satisfiable(req, (size_t) size);
+    goto cleanup;
+  }
+  if (fseek(fd, (long) range.start, SEEK_SET) != 0) {
+    ret = httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read file");
+    goto cleanup;
+  }
 
-  char *chunk = malloc(SCRATCH_BUFSIZE);
+  chunk = malloc(SCRATCH_BUFSIZE);
   if (!chunk) {
-    ESP_LOGE("HTTP_FILESERVER", "Failed to allocate memory for chunk");
-    fclose(fd);
+    ESP_LOGE(FILESERVER_TAG, "Failed to allocate memory for chunk");
     ret = ESP_ERR_NO_MEM;
     goto cleanup;
   }
 
-  size_t chunksize;
-  do {
-    chunksize = fread(chunk, 1, SCRATCH_BUFSIZE, fd);
-    if (chunksize > 0) {
-      if ((ret = httpd_resp_send_chunk(req, chunk, chunksize))) {
-        fclose(fd);
-        free(chunk);
-        ESP_LOGE("HTTP_FILESERVER", "File sending failed!");
-        goto cleanup;
-      }
+  if ((ret = send_response_head(req, response, ranged > 0, &range, (size_t) size)) != ESP_OK ||
+      req->method == HTTP_HEAD) {
+    goto cleanup;
+  }
+
+  // Content-Length is already out, so a short read has to fail the connection
+  size_t remaining = range.length;
+  while (remaining > 0) {
+    size_t chunksize =
+        fread(chunk, 1, remaining < SCRATCH_BUFSIZE ? remaining : SCRATCH_BUFSIZE, fd);
+    if (chunksize == 0 || (ret = send_all(req, chunk, chunksize)) != ESP_OK) {
+      ESP_LOGE(FILESERVER_TAG, "File sending failed!");
+      ret = ESP_FAIL;
+      goto cleanup;
     }
-  } while (chunksize != 0);
+    remaining -= chunksize;
+  }
 
+cleanup:
   free(chunk);
-  fclose(fd);
+  if (fd) fclose(fd);
+  return ret;
+}
 
-  ret = httpd_resp_send_chunk(req, NULL, 0);
+// Serves from the memory-mapped asset pack: no filesystem calls, and the body goes out of flash
+static esp_err_t pack_handler(httpd_req_t *req, const char *path, size_t path_len) {
+  const asset_pack_entry_t *entry = asset_pack_find(path, path_len);
+  if (!entry) return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
 
-cleanup:
-  return ret;
+  uint8_t present = 0;
+  for (size_t v = 0; v < ASSET_PACK_VARIANTS; v++) {
+    if (asset_pack_variant(entry, (asset_pack_variant_t) v)) present |= VARIANT_BIT(v);
+  }
+
+  file_response_t response = {.content_type = asset_pack_string(entry->content_type)};
+  response.cache_control = cache_control_for(response.content_type);
+  int variant = select_variant(req, present, &response);
+  if (variant < 0) return send_not_acceptable(req);
+
+  const asset_pack_blob_t *blob = asset_pack_variant(entry, (asset_pack_variant_t) variant);
+  response.etag = asset_pack_string(blob->etag);
+  if (httpd_req_etag_matches(req, response.etag)) return send_not_modified(req, &response);
+  return send_buffer(req, &response, asset_pack_data(blob), blob->length);
+}
+
+// Serves a file listed in the manifest; only the body read touches the filesystem
+static esp_err_t manifest_handler(httpd_req_t *req, const char *base_path,
+                                  const static_asset_t *asset) {
+  file_response_t response = {.content_type = asset->mime_type,
+                              .cache_control = asset->cache_control};
+  int variant = select_variant(req, asset->variants, &response);
+  if (variant < 0) return send_not_acceptable(req);
+
+  response.etag = asset->etags[variant];
+  if (httpd_req_etag_matches(req, response.etag)) return send_not_modified(req, &response);
+
+  char filepath[600];
+  snprintf(filepath, sizeof(filepath), "%s%s%s", base_path, asset->path,
+           variant_suffixes[variant]);
+  return send_file(req, &response, filepath);
+}
+
+// Files the manifest does not know: variants found with stat(), weak ETag from mtime and size
+static esp_err_t stat_handler(httpd_req_t *req, const char *base_path, const char *path,
+                              size_t path_len) {
+  char filepath[600];
+  int base_len = snprintf(filepath, sizeof(filepath), "%s%.*s", base_path, (int) path_len, path);
+  if (base_len < 0 || (size_t) base_len + 4 > sizeof(filepath)) {
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
+  }
+
+  struct stat stats[ASSET_PACK_VARIANTS];
+  uint8_t present = 0;
+  for (size_t v = 0; v < ASSET_PACK_VARIANTS; v++) {
+    strcpy(filepath + base_len, variant_suffixes[v]);
+    if (stat(filepath, &stats[v]) == 0) present |= VARIANT_BIT(v);
+  }
+  if (!present) return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
+
+  file_response_t response = {.content_type = mime_type_for(path, path_len)};
+  response.cache_control = cache_control_for(response.content_type);
+  int variant = select_variant(req, present, &response);
+  if (variant < 0) return send_not_acceptable(req);
+  strcpy(filepath + base_len, variant_suffixes[variant]);
+
+  char etag[64];
+  snprintf(etag, sizeof(etag), "W/\"%lx-%lx\"", (unsigned long) stats[variant].st_mtime,
+           (unsigned long) stats[variant].st_size);
+  response.etag = etag;
+  if (httpd_req_etag_matches(req, etag)) return send_not_modified(req, &response);
+
+  return send_file(req, &response, filepath);
+}
+
+esp_err_t path_handler(httpd_req_t *req) {
+  httpd_log_request(req, FILESERVER_TAG);
+  const char *base_path = (const char *) req->user_ctx;
+  const char *path = req->uri;
+  size_t path_len = strcspn(path, "?");
+  if (path_len == 1) {
+    path = "/index.html";
+    path_len = strlen(path);
+  }
+
+  if (asset_pack_ready()) return pack_handler(req, path, path_len);
+
+  const static_asset_t *asset = static_asset_find(path, path_len);
+  if (asset) return manifest_handler(req, base_path, asset);
+  return stat_handler(req, base_path, path, path_len);
 }
 
 #endif
@@ -1,80 +1,171 @@
 #ifndef WS_ENCODER_H
 #define WS_ENCODER_H
 
-#include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "../../encoder.h"
-#include "../../transport/http/https_server.h"
+#include "../../fixed.h"
+#include "../../rep_counter.h"
 #include "../../transport/ws/ws_server.h"
 
+#define WS_ENCODER_FRAME_POSITION 0x01
+#define WS_TOPIC_REP WS_TOPIC_EVENT(0) // rep and stop_set events
+
+/*
+ * Position frame for clients on WS_SUBPROTOCOL_BINARY, little-endian. The sequence lets clients
+ * spot dropped frames; the timestamp is the sample time in ms since boot, wrapping.
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t type; // WS_ENCODER_FRAME_POSITION
+  uint8_t encoder_id;
+  uint16_t seq;
+  uint32_t timestamp_ms;
+  q16_t calibrated;   // percent of the calibrated range
+  int16_t velocity;   // tenths of a percent per second
+  uint8_t cal_state;  // calibration_state_t
+  uint8_t reserved;
+} ws_position_frame_t;
+_Static_assert(sizeof(ws_position_frame_t) == 16, "ws_position_frame_t must stay 16 bytes");
+_Static_assert(ENCODER_MAX_COUNT <= WS_LATEST_SLOTS, "one latest-value slot per encoder");
+
+// Indexed by encoder id
 typedef struct {
-  encoder_t *left_encoder;
-  encoder_t *right_encoder;
-  int32_t last_left_calibrated_sent;
-  int32_t last_right_calibrated_sent;
+  int32_t last_calibrated_sent[ENCODER_MAX_COUNT];
+  int32_t last_velocity_sent[ENCODER_MAX_COUNT];
+  uint16_t seq[ENCODER_MAX_COUNT];
 } ws_encoder_context_t;
 
-static inline void ws_encoder_init(ws_encoder_context_t *ctx, encoder_t *left_encoder,
-                                   encoder_t *right_encoder) {
-  if (!ctx) return;
-
-  ctx->left_encoder = left_encoder;
-  ctx->right_encoder = right_encoder;
-  ctx->last_left_calibrated_sent = -1;
-  ctx->last_right_calibrated_sent = -1;
+// Velocity is published with one decimal; smaller changes do not trigger a position event
+static inline int32_t ws_encoder_velocity_tenths(q16_t velocity) {
+  return (int32_t) (((int64_t) velocity * 10) / Q16_ONE);
 }
 
-static inline void ws_encoder_publish(ws_encoder_context_t *ctx, const char *event_type,
-                                      const char *encoder_name, encoder_t *encoder,
-                                      const char *cal_state_name) {
-  if (!ctx || !event_type || !encoder_name || !encoder || !cal_state_name) return;
-
-  char payload[160];
-  int32_t calibrated_int = (int32_t) ceil(encoder->state.calibrated);
-  if (calibrated_int < 0) calibrated_int = 0;
-  if (calibrated_int > 100) calibrated_int = 100;
+static inline void ws_encoder_init(ws_encoder_context_t *ctx) {
+  if (!ctx) return;
 
-  if (strcmp(event_type, "position") == 0) {
-    int32_t *last_sent = NULL;
+  ws_topic_define("rep", WS_TOPIC_REP);
+  for (size_t i = 0; i < ENCODER_MAX_COUNT; i++) {
+    ctx->last_calibrated_sent[i] = -1;
+    ctx->last_velocity_sent[i] = 0;
+    ctx->seq[i] = 0;
+  }
+}
 
-    if (encoder == ctx->left_encoder) {
-      last_sent = &ctx->last_left_calibrated_sent;
-    } else if (encoder == ctx->right_encoder) {
-      last_sent = &ctx->last_right_calibrated_sent;
-    }
+// Subscribe topics for an encoder's positions: "position:<name>", and "position" for all
+static inline void ws_encoder_define_topics(const char *encoder_name, uint8_t encoder_id) {
+  char topic[WS_TOPIC_NAME_LEN];
+  snprintf(topic, sizeof(topic), "position:%s", encoder_name);
+  ws_topic_define(topic, WS_TOPIC_LATEST(encoder_id));
+  ws_topic_define("position", WS_TOPIC_LATEST(encoder_id));
+}
 
-    if (last_sent && *last_sent == calibrated_int) {
+/**
+ * Publishes an event for the encoder with the given id; "position" events are only sent when the
+ * rounded position or velocity changed. They replace the encoder's latest-value slot, so clients
+ * get the newest one each frame, as a ws_position_frame_t on the binary subprotocol.
+ * state should come from encoder_snapshot(); timestamp_us is the sample time.
+ */
+static inline void ws_encoder_publish(ws_encoder_context_t *ctx, const char *event_type,
+                                      const char *encoder_name, uint8_t encoder_id,
+                                      const encoder_state_t *state, const char *cal_state_name,
+                                      int64_t timestamp_us) {
+  if (!ctx || !event_type || !encoder_name || !state || !cal_state_name) return;
+  if (encoder_id >= ENCODER_MAX_COUNT) return;
+
+  char payload[224];
+  int32_t calibrated_int = q16_ceil_int(q16_clamp(state->calibrated, CAL_MIN, CAL_MAX));
+  int32_t velocity_tenths = ws_encoder_velocity_tenths(state->velocity);
+
+  bool position = strcmp(event_type, "position") == 0;
+  if (position) {
+    int32_t *last_sent = &ctx->last_calibrated_sent[encoder_id];
+    int32_t *last_velocity_sent = &ctx->last_velocity_sent[encoder_id];
+
+    if (*last_sent == calibrated_int && *last_velocity_sent == velocity_tenths) {
       return;
     }
 
-    if (last_sent) {
-      *last_sent = calibrated_int;
-    }
+    *last_sent = calibrated_int;
+    *last_velocity_sent = velocity_tenths;
   }
 
   snprintf(payload, sizeof(payload),
            "{\"event\": \"%s\", \"name\": \"%s\", \"calibrated\": %ld, "
-           "\"cal_state\": \"%s\"}",
-           event_type, encoder_name, (long) calibrated_int, cal_state_name);
+           "\"velocity\": %.1f, \"acceleration\": %.1f, \"cal_state\": \"%s\"}",
+           event_type, encoder_name, (long) calibrated_int, q16_to_double(state->velocity),
+           q16_to_double(state->acceleration), cal_state_name);
 
-  resp_arg_t *resp_arg = malloc(sizeof(resp_arg_t));
-  if (!resp_arg) {
-    ESP_LOGE("WS_ENCODER", "Could not allocate websocket response args");
+  if (!position) {
+    ws_broadcast(WS_TOPIC_ALL, payload, NULL, 0);
     return;
   }
 
-  resp_arg->hd = https_server_get_handle();
-  resp_arg->data = strdup(payload);
-  if (!resp_arg->data) {
-    ESP_LOGE("WS_ENCODER", "Could not allocate websocket response payload");
-    free(resp_arg);
-    return;
+  int32_t velocity_clamped = velocity_tenths;
+  if (velocity_clamped > INT16_MAX) velocity_clamped = INT16_MAX;
+  if (velocity_clamped < INT16_MIN) velocity_clamped = INT16_MIN;
+  ws_position_frame_t frame = {.type = WS_ENCODER_FRAME_POSITION,
+                               .encoder_id = encoder_id,
+                               .seq = ctx->seq[encoder_id]++,
+                               .timestamp_ms = (uint32_t) (timestamp_us / 1000),
+                               .calibrated = q16_clamp(state->calibrated, CAL_MIN, CAL_MAX),
+                               .velocity = (int16_t) velocity_clamped,
+                               .cal_state = (uint8_t) state->cal_state};
+  ws_publish_latest(encoder_id, payload, &frame, sizeof(frame));
+}
+
+/**
+ * Publishes a completed rep with its kinematics. rep may be NULL for reps triggered manually.
+ */
+static inline void ws_encoder_publish_rep(const char *encoder_name, const encoder_state_t *state,
+                                          const char *cal_state_name, const rep_record_t *rep) {
+  if (!encoder_name || !state || !cal_state_name) return;
+  if (!ws_has_subscribers(WS_TOPIC_REP)) return;
+
+  char payload[560];
+  int32_t calibrated_int = q16_ceil_int(q16_clamp(state->calibrated, CAL_MIN, CAL_MAX));
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"event\": \"rep\", \"name\": \"%s\", \"calibrated\": %ld, "
+                     "\"cal_state\": \"%s\"",
+                     encoder_name, (long) calibrated_int, cal_state_name);
+  if (rep) {
+    len += snprintf(payload + len, sizeof(payload) - len,
+                    ", \"kinematics\": {\"rom\": %.1f, \"concentric_ms\": %lu, "
+                    "\"eccentric_ms\": %lu, \"tut_ms\": %lu, \"peak_velocity\": %.1f, "
+                    "\"mean_velocity\": %.1f, \"mean_propulsive_velocity\": %.1f, "
+                    "\"velocity_loss\": %.1f}",
+                    q16_to_double(rep->rom), (unsigned long) rep->concentric_ms,
+                    (unsigned long) rep->eccentric_ms, (unsigned long) rep->tut_ms,
+                    q16_to_double(rep->peak_velocity), q16_to_double(rep->mean_velocity),
+                    q16_to_double(rep->mean_propulsive_velocity),
+                    q16_to_double(rep->velocity_loss));
+    if (rep->bilateral) {
+      len += snprintf(payload + len, sizeof(payload) - len,
+                      ", \"asymmetry\": {\"rom\": %.1f, \"velocity\": %.1f, \"sync_ms\": %lu}",
+                      q16_to_double(rep->rom_asymmetry), q16_to_double(rep->velocity_asymmetry),
+                      (unsigned long) rep->sync_ms);
+    }
   }
+  snprintf(payload + len, sizeof(payload) - len, "}");
+
+  ws_broadcast(WS_TOPIC_REP, payload, NULL, 0);
+}
+
+/**
+ * Tells clients the set should end: the rep's velocity loss reached the exercise's target.
+ */
+static inline void ws_encoder_publish_stop_set(const char *encoder_name, const rep_record_t *rep) {
+  if (!encoder_name || !rep || !ws_has_subscribers(WS_TOPIC_REP)) return;
+
+  char payload[160];
+  snprintf(payload, sizeof(payload),
+           "{\"event\": \"stop_set\", \"name\": \"%s\", \"velocity_loss\": %.1f, "
+           "\"mean_propulsive_velocity\": %.1f}",
+           encoder_name, q16_to_double(rep->velocity_loss),
+           q16_to_double(rep->mean_propulsive_velocity));
 
-  ws_send_message(resp_arg);
+  ws_broadcast(WS_TOPIC_REP, payload, NULL, 0);
 }
 
 #endif
@@ -53,7 +53,19 @@ static inline void ws_rep_counter_handle_message(const char *payload, size_t len
     rep_band = rep_band_json->valuedouble;
   }
 
-  rep_counter_set_threshold(counter, side, threshold->valuedouble, rep_band);
+  double velocity_loss = REP_VELOCITY_LOSS_DEFAULT;
+  const cJSON *velocity_loss_json = cJSON_GetObjectItem(root, "velocityLoss");
+  if (cJSON_IsNumber(velocity_loss_json)) {
+    velocity_loss = velocity_loss_json->valuedouble;
+  }
+
+  // Older clients omit the type; keep whatever is active
+  const cJSON *type_json = cJSON_GetObjectItem(root, "type");
+  if (cJSON_IsString(type_json)) {
+    rep_counter_set_type(counter, exercise_type_from_string(type_json->valuestring));
+  }
+
+  rep_counter_set_threshold(counter, side, threshold->valuedouble, rep_band, velocity_loss);
   cJSON_Delete(root);
 }
 
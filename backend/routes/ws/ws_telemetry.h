@@ -0,0 +1,67 @@
+#ifndef WS_TELEMETRY_H
+#define WS_TELEMETRY_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../encoder.h"
+#include "../../transport/ws/ws_server.h"
+
+#define WS_TELEMETRY_INTERVAL_MS 1000
+#define WS_TELEMETRY_TASK_STACK 4096
+#define WS_TELEMETRY_PAYLOAD_SIZE (128 + 160 * ENCODER_MAX_COUNT)
+#define WS_TOPIC_TELEMETRY WS_TOPIC_EVENT(1)
+
+static inline int ws_telemetry_format_encoder(char *out, size_t out_len, encoder_t *encoder) {
+  encoder_state_t state;
+  encoder_snapshot(encoder, &state);
+  return snprintf(out, out_len,
+                  "{\"name\": \"%s\", \"raw_count\": %ld, \"illegal\": %lu, "
+                  "\"overruns\": %lu, \"first_valid_ms\": %lld}",
+                  encoder->config.name ? encoder->config.name : "", (long) state.raw_count,
+                  (unsigned long) state.illegal_transitions,
+                  (unsigned long) encoder->ring.overruns,
+                  (long long) (encoder->first_valid_us / 1000));
+}
+
+static void ws_telemetry_task(void *arg) {
+  (void) arg;
+  const TickType_t interval_ticks = pdMS_TO_TICKS(WS_TELEMETRY_INTERVAL_MS);
+
+  while (1) {
+    vTaskDelay(interval_ticks);
+
+    if (!ws_has_subscribers(WS_TOPIC_TELEMETRY)) continue;
+
+    char payload[WS_TELEMETRY_PAYLOAD_SIZE];
+    size_t len =
+      snprintf(payload, sizeof(payload), "{\"event\": \"telemetry\", \"encoders\": [");
+    for (size_t i = 0; i < encoder_count() && len < sizeof(payload); i++) {
+      if (i > 0) len += snprintf(payload + len, sizeof(payload) - len, ", ");
+      if (len >= sizeof(payload)) break;
+      len += ws_telemetry_format_encoder(payload + len, sizeof(payload) - len, encoder_get(i));
+    }
+    if (len >= sizeof(payload)) continue;
+    ws_pool_stats_t pool;
+    ws_pool_get_stats(&pool);
+    len += snprintf(payload + len, sizeof(payload) - len,
+                    "], \"ws\": {\"sent\": %lu, \"dropped\": %lu, \"peak\": %lu}}",
+                    (unsigned long) pool.sent, (unsigned long) pool.dropped,
+                    (unsigned long) pool.peak);
+    if (len >= sizeof(payload)) continue;
+
+    ws_broadcast(WS_TOPIC_TELEMETRY, payload, NULL, 0);
+  }
+}
+
+// Publishes counters for every registered encoder
+static inline void ws_telemetry_start(void) {
+  ws_topic_define("telemetry", WS_TOPIC_TELEMETRY);
+  xTaskCreate(ws_telemetry_task, "ws_telemetry", WS_TELEMETRY_TASK_STACK, NULL,
+              tskIDLE_PRIORITY + 1, NULL);
+}
+
+#endif
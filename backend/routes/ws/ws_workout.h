@@ -0,0 +1,63 @@
+#ifndef WS_WORKOUT_H
+#define WS_WORKOUT_H
+
+#include <cJSON.h>
+#include <esp_log.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../../transport/ws/ws_server.h"
+#include "../../workout.h"
+
+#define WS_WORKOUT_CLOCK_TOLERANCE_MS 2000
+
+// The device has no RTC; clients send their clock on connect so log records carry real times.
+// The clock is only ever moved forward: the workout log relies on record times not going back.
+static inline void ws_workout_set_clock(double epoch_ms) {
+  int64_t target_ms = (int64_t) epoch_ms;
+  if (target_ms < WORKOUT_CLOCK_VALID_MS) return;
+
+  int64_t drift_ms = target_ms - workout_wall_ms();
+  if (drift_ms < WS_WORKOUT_CLOCK_TOLERANCE_MS) {
+    if (drift_ms <= -WS_WORKOUT_CLOCK_TOLERANCE_MS) {
+      ESP_LOGW(WORKOUT_TAG, "Not stepping the clock back %lld ms", (long long) -drift_ms);
+    }
+    return;
+  }
+
+  struct timeval tv = {.tv_sec = (time_t) (target_ms / 1000),
+                       .tv_usec = (suseconds_t) ((target_ms % 1000) * 1000)};
+  settimeofday(&tv, NULL);
+  ESP_LOGI(WORKOUT_TAG, "Clock set from client (drift %lld ms)", (long long) drift_ms);
+}
+
+static inline void ws_workout_handle_message(const char *payload, size_t len, void *ctx) {
+  (void) ctx;
+  if (!payload || len == 0) return;
+
+  cJSON *root = cJSON_ParseWithLength(payload, len);
+  if (!root) return;
+
+  const cJSON *event = cJSON_GetObjectItem(root, "event");
+  if (!cJSON_IsString(event)) {
+    cJSON_Delete(root);
+    return;
+  }
+
+  if (strcmp(event->valuestring, "clock") == 0) {
+    const cJSON *epoch_ms = cJSON_GetObjectItem(root, "epochMs");
+    if (cJSON_IsNumber(epoch_ms)) ws_workout_set_clock(epoch_ms->valuedouble);
+  } else if (strcmp(event->valuestring, "user") == 0) {
+    // A missing or null name means no user is selected
+    const cJSON *name = cJSON_GetObjectItem(root, "name");
+    workout_set_user(cJSON_IsString(name) ? name->valuestring : "", ws_current_session());
+  } else if (strcmp(event->valuestring, "threshold") == 0) {
+    const cJSON *exercise = cJSON_GetObjectItem(root, "exercise");
+    if (cJSON_IsString(exercise)) workout_set_exercise(exercise->valuestring);
+  }
+
+  cJSON_Delete(root);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/*
+ * Sequence lock for one writer and any number of readers. The counter is odd while a write is in
+ * progress; a reader copies the data between two reads of the counter and retries when they
+ * differ. Readers never block the writer. Free of IDF dependencies so it is stress-tested on the
+ * host; waiting while the counter is odd is left to the caller.
+ */
+
+typedef atomic_uint seqlock_t;
+
+static inline void seqlock_write_begin(seqlock_t *seq) {
+  atomic_fetch_add_explicit(seq, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static inline void seqlock_write_end(seqlock_t *seq) {
+  atomic_fetch_add_explicit(seq, 1, memory_order_release);
+}
+
+/**
+ * Starts a read. The result is odd while a write is in progress, in which case the caller waits
+ * and starts again.
+ */
+static inline unsigned seqlock_read_begin(seqlock_t *seq) {
+  return atomic_load_explicit(seq, memory_order_acquire);
+}
+
+/**
+ * True when a write overlapped the copy made since seqlock_read_begin() returned start.
+ */
+static inline bool seqlock_read_retry(seqlock_t *seq, unsigned start) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(seq, memory_order_relaxed) != start;
+}
+
+#endif
@@ -3,10 +3,29 @@
 
 #include "../data/exercises.h"
 #include "../utils.h"
+#include "persistence.h"
 
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/*
+ * The exercise list lives in RAM: it is read once at startup, mutations edit the cJSON tree, and
+ * the serialized document is cached with a content ETag so GET is a copy or a 304. Saves are
+ * debounced by EXERCISES_SAVE_DELAY_US and written by the persistence worker to a temporary file
+ * that is renamed over the old one, so a reset mid-write keeps the previous list.
+ */
+
+#define EXERCISES_TAG "EXERCISES"
+#define EXERCISES_SAVE_DELAY_US (2 * 1000 * 1000)
+#define EXERCISES_ETAG_LEN 24
+#define EXERCISES_PATH_MAX 64
+
 typedef struct {
   const char *name;
   double threshold_percentage;
@@ -14,32 +33,180 @@ typedef struct {
   const char *category_id;
   const char *category_name;
   double rep_band;
+  double velocity_loss;
 } exercises_store_upsert_request_t;
 
-static inline int exercises_store_load_json_string(const char *path, char **json_string_out) {
-  if (!path || !json_string_out) return EXIT_FAILURE;
+typedef struct {
+  SemaphoreHandle_t lock;
+  char path[EXERCISES_PATH_MAX];
+  cJSON *root;
+  char *json; // cached response body; NULL when it needs to be printed again
+  size_t json_len;
+  char etag[EXERCISES_ETAG_LEN];
+  esp_timer_handle_t save_timer;
+} exercises_store_t;
+
+static exercises_store_t exercises_store = {0};
 
-  *json_string_out = NULL;
-  cJSON *json = cjson_read_from_file(path);
-  if (!json) return EXIT_FAILURE;
+// Prints the tree into the cache. Called with the lock held.
+static bool exercises_store_serialize(void) {
+  if (exercises_store.json) return true;
 
-  *json_string_out = cJSON_PrintUnformatted(json);
-  cJSON_Delete(json);
-  return *json_string_out ? EXIT_SUCCESS : EXIT_FAILURE;
+  exercises_store.json = cJSON_PrintUnformatted(exercises_store.root);
+  if (!exercises_store.json) return false;
+
+  exercises_store.json_len = strlen(exercises_store.json);
+  uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *) exercises_store.json,
+                                  exercises_store.json_len);
+  snprintf(exercises_store.etag, sizeof(exercises_store.etag), "\"%08lx-%x\"",
+           (unsigned long) crc, (unsigned) exercises_store.json_len);
+  return true;
+}
+
+// Drops the cached body after the tree changed. Called with the lock held.
+static void exercises_store_invalidate(void) {
+  free(exercises_store.json);
+  exercises_store.json = NULL;
+  exercises_store.json_len = 0;
+  exercises_store.etag[0] = '\0';
 }
 
-static inline int exercises_store_upsert(const char *path,
-                                         const exercises_store_upsert_request_t *request) {
-  if (!path || !request || !request->name) return EXIT_FAILURE;
+static esp_err_t exercises_store_write(const void *data, size_t len, void *ctx) {
+  (void) data;
+  (void) len;
+  (void) ctx;
 
-  cJSON *root = cjson_read_from_file(path);
-  if (!root) return EXIT_FAILURE;
+  // Snapshot under the lock; the file is written without holding it
+  xSemaphoreTake(exercises_store.lock, portMAX_DELAY);
+  char *json = NULL;
+  size_t json_len = 0;
+  if (exercises_store_serialize()) {
+    json_len = exercises_store.json_len;
+    json = malloc(json_len);
+    if (json) memcpy(json, exercises_store.json, json_len);
+  }
+  xSemaphoreGive(exercises_store.lock);
+  if (!json) return ESP_ERR_NO_MEM;
+
+  char tmp_path[EXERCISES_PATH_MAX + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", exercises_store.path);
+  esp_err_t err = write_buf_to_file(tmp_path, json, json_len);
+  free(json);
+  if (err != ESP_OK) return err;
+
+  // LittleFS replaces the destination atomically; only fall back to remove() where it cannot
+  if (rename(tmp_path, exercises_store.path) == 0) return ESP_OK;
+  remove(exercises_store.path);
+  return rename(tmp_path, exercises_store.path) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static void exercises_store_save_timer_cb(void *arg) {
+  (void) arg;
+  persistence_submit(PERSISTENCE_KEY_EXERCISES, exercises_store_write, NULL, NULL, 0);
+}
+
+// Restarts the save delay, so a burst of edits is written once
+static void exercises_store_schedule_save(void) {
+  esp_timer_stop(exercises_store.save_timer);
+  if (esp_timer_start_once(exercises_store.save_timer, EXERCISES_SAVE_DELAY_US) != ESP_OK) {
+    exercises_store_save_timer_cb(NULL);
+  }
+}
+
+// Adds whichever of the top-level arrays the document lacks, so edits have somewhere to go
+static bool exercises_store_seed(cJSON *root) {
+  if (!cJSON_IsArray(cJSON_GetObjectItemCaseSensitive(root, "exercises"))) {
+    cJSON_DeleteItemFromObject(root, "exercises");
+    if (!cJSON_AddArrayToObject(root, "exercises")) return false;
+  }
+  if (!cJSON_IsArray(cJSON_GetObjectItemCaseSensitive(root, "categories"))) {
+    cJSON_DeleteItemFromObject(root, "categories");
+    if (!cJSON_AddArrayToObject(root, "categories")) return false;
+  }
+  return true;
+}
+
+/**
+ * Loads the list from path. A missing file starts an empty list; an unreadable one is moved
+ * aside to <path>.bad first, so the next save does not destroy what may still be recovered.
+ */
+esp_err_t exercises_store_init(const char *path) {
+  if (exercises_store.lock) return ESP_OK;
+  if (!path || strlen(path) >= sizeof(exercises_store.path)) return ESP_ERR_INVALID_ARG;
+
+  exercises_store.lock = xSemaphoreCreateMutex();
+  if (!exercises_store.lock) return ESP_ERR_NO_MEM;
+
+  esp_timer_create_args_t timer_args = {.callback = exercises_store_save_timer_cb,
+                                        .dispatch_method = ESP_TIMER_TASK,
+                                        .name = "exercises_save"};
+  esp_err_t err = esp_timer_create(&timer_args, &exercises_store.save_timer);
+  if (err != ESP_OK) {
+    vSemaphoreDelete(exercises_store.lock);
+    exercises_store.lock = NULL;
+    return err;
+  }
+
+  strcpy(exercises_store.path, path);
+  exercises_store.root = cjson_read_from_file(path);
+  if (!cJSON_IsObject(exercises_store.root)) {
+    char bad_path[EXERCISES_PATH_MAX + 4];
+    snprintf(bad_path, sizeof(bad_path), "%s.bad", path);
+    if (rename(path, bad_path) == 0) {
+      ESP_LOGW(EXERCISES_TAG, "Unreadable %s moved to %s", path, bad_path);
+    }
+    cJSON_Delete(exercises_store.root);
+    exercises_store.root = cJSON_CreateObject();
+  }
+  if (!exercises_store.root || !exercises_store_seed(exercises_store.root)) return ESP_ERR_NO_MEM;
+
+  exercises_store_serialize();
+  return ESP_OK;
+}
 
+/**
+ * Copies the current ETag into etag_out and, when json_out is given, the serialized list into a
+ * buffer the caller frees.
+ */
+static inline int exercises_store_snapshot(char **json_out, size_t *len_out, char *etag_out,
+                                           size_t etag_out_len) {
+  if (!exercises_store.lock) return EXIT_FAILURE;
+
+  int result = EXIT_FAILURE;
+  xSemaphoreTake(exercises_store.lock, portMAX_DELAY);
+  if (!exercises_store_serialize()) goto cleanup;
+
+  if (etag_out && etag_out_len > 0) {
+    strncpy(etag_out, exercises_store.etag, etag_out_len);
+    etag_out[etag_out_len - 1] = '\0';
+  }
+  if (json_out) {
+    *json_out = malloc(exercises_store.json_len);
+    if (!*json_out) goto cleanup;
+    memcpy(*json_out, exercises_store.json, exercises_store.json_len);
+    if (len_out) *len_out = exercises_store.json_len;
+  }
+  result = EXIT_SUCCESS;
+
+cleanup:
+  xSemaphoreGive(exercises_store.lock);
+  return result;
+}
+
+static inline int exercises_store_upsert(const exercises_store_upsert_request_t *request) {
+  if (!exercises_store.lock || !request || !request->name) return EXIT_FAILURE;
+
+  xSemaphoreTake(exercises_store.lock, portMAX_DELAY);
+  cJSON *root = exercises_store.root;
   int result = EXIT_FAILURE;
   char category_id_value[UUID_STR_LEN] = {0};
   const char *category_id_value_ptr = NULL;
   bool has_category = (request->category_name && strlen(request->category_name) > 0) ||
                       (request->category_id && strlen(request->category_id) > 0);
+  int categories_before = cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(root, "categories"));
+
+  // Checked first, so a request that cannot be stored leaves the tree as it was
+  if (!cJSON_IsArray(cJSON_GetObjectItemCaseSensitive(root, "exercises"))) goto cleanup;
 
   if (has_category) {
     if (categories_get_or_create_id(root, request->category_name, request->category_id,
@@ -56,41 +223,33 @@ static inline int exercises_store_upsert(const char *path,
   }
 
   if (exercises_add(root, request->name, request->threshold_percentage, request->type,
-                    category_id_value_ptr, request->rep_band) != EXIT_SUCCESS) {
-    goto cleanup;
-  }
-
-  if (cjson_save_to_file(root, path) != EXIT_SUCCESS) {
+                    category_id_value_ptr, request->rep_band,
+                    request->velocity_loss) != EXIT_SUCCESS) {
     goto cleanup;
   }
 
   result = EXIT_SUCCESS;
 
-cleanup:
-  cJSON_Delete(root);
+cleanup:;
+  // A category may have been created even when the exercise was not
+  bool changed = result == EXIT_SUCCESS ||
+                 cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(root, "categories")) !=
+                   categories_before;
+  if (changed) exercises_store_invalidate();
+  xSemaphoreGive(exercises_store.lock);
+  if (changed) exercises_store_schedule_save();
   return result;
 }
 
-static inline int exercises_store_delete(const char *path, const char *name) {
-  if (!path || !name) return EXIT_FAILURE;
-
-  cJSON *root = cjson_read_from_file(path);
-  if (!root) return EXIT_FAILURE;
-
-  int result = EXIT_FAILURE;
-
-  if (exercises_remove(root, name) != EXIT_SUCCESS) {
-    goto cleanup;
-  }
+static inline int exercises_store_delete(const char *name) {
+  if (!exercises_store.lock || !name) return EXIT_FAILURE;
 
-  if (cjson_save_to_file(root, path) != EXIT_SUCCESS) {
-    goto cleanup;
-  }
+  xSemaphoreTake(exercises_store.lock, portMAX_DELAY);
+  int result = exercises_remove(exercises_store.root, name);
+  if (result == EXIT_SUCCESS) exercises_store_invalidate();
+  xSemaphoreGive(exercises_store.lock);
 
-  result = EXIT_SUCCESS;
-
-cleanup:
-  cJSON_Delete(root);
+  if (result == EXIT_SUCCESS) exercises_store_schedule_save();
   return result;
 }
 
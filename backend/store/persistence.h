@@ -0,0 +1,135 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Low-priority worker that performs flash writes off the latency-sensitive paths. Jobs are keyed:
+ * submitting a key that is still pending replaces its payload, so a burst of saves collapses to
+ * one write of the latest state. The payload is copied at submit time; stores whose state is too
+ * large to copy can submit without a payload and read their own state in the write callback.
+ * A slot stays bound to its key once used, so PERSISTENCE_MAX_JOBS bounds the number of keys.
+ */
+
+#define PERSISTENCE_TAG "PERSISTENCE"
+#define PERSISTENCE_MAX_JOBS 8
+#define PERSISTENCE_PAYLOAD_MAX 128
+#define PERSISTENCE_TASK_STACK 4096
+#define PERSISTENCE_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+
+// Keys are owned by the stores; keep the ranges apart
+#define PERSISTENCE_KEY_ENCODER_CAL(id) (0x100u | (uint32_t) (id))
+#define PERSISTENCE_KEY_SETTINGS 0x200u
+#define PERSISTENCE_KEY_EXERCISES 0x300u
+#define PERSISTENCE_KEY_WORKOUT_LOG 0x400u
+#define PERSISTENCE_KEY_STATS 0x500u
+
+typedef esp_err_t (*persistence_write_fn)(const void *data, size_t len, void *ctx);
+
+typedef struct {
+  bool in_use;
+  bool pending;
+  uint32_t key;
+  persistence_write_fn write;
+  void *ctx;
+  size_t len;
+  uint8_t data[PERSISTENCE_PAYLOAD_MAX];
+} persistence_job_t;
+
+typedef struct {
+  persistence_job_t jobs[PERSISTENCE_MAX_JOBS];
+  SemaphoreHandle_t lock;
+  TaskHandle_t task;
+} persistence_t;
+
+static persistence_t persistence = {0};
+
+static void persistence_task(void *arg) {
+  (void) arg;
+  persistence_job_t job;
+
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    for (size_t i = 0; i < PERSISTENCE_MAX_JOBS; i++) {
+      xSemaphoreTake(persistence.lock, portMAX_DELAY);
+      bool run = persistence.jobs[i].pending;
+      if (run) {
+        job = persistence.jobs[i];
+        persistence.jobs[i].pending = false;
+      }
+      xSemaphoreGive(persistence.lock);
+      if (!run) continue;
+
+      esp_err_t err = job.write(job.data, job.len, job.ctx);
+      if (err != ESP_OK) {
+        ESP_LOGE(PERSISTENCE_TAG, "Write for key 0x%lx failed: %s", (unsigned long) job.key,
+                 esp_err_to_name(err));
+      }
+    }
+  }
+}
+
+esp_err_t persistence_start(void) {
+  if (persistence.task) return ESP_OK;
+
+  persistence.lock = xSemaphoreCreateMutex();
+  if (!persistence.lock) return ESP_ERR_NO_MEM;
+
+  if (xTaskCreate(persistence_task, "persistence", PERSISTENCE_TASK_STACK, NULL,
+                  PERSISTENCE_TASK_PRIORITY, &persistence.task) != pdPASS) {
+    vSemaphoreDelete(persistence.lock);
+    persistence.lock = NULL;
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+/**
+ * Schedules write(data, len, ctx) on the worker. A pending job with the same key is replaced.
+ */
+esp_err_t persistence_submit(uint32_t key, persistence_write_fn write, void *ctx,
+                             const void *data, size_t len) {
+  if (!write || (len > 0 && !data)) return ESP_ERR_INVALID_ARG;
+  if (len > PERSISTENCE_PAYLOAD_MAX) return ESP_ERR_INVALID_SIZE;
+  if (!persistence.task) return ESP_ERR_INVALID_STATE;
+
+  xSemaphoreTake(persistence.lock, portMAX_DELAY);
+  persistence_job_t *slot = NULL;
+  for (size_t i = 0; i < PERSISTENCE_MAX_JOBS; i++) {
+    persistence_job_t *job = &persistence.jobs[i];
+    if (job->in_use && job->key == key) {
+      slot = job;
+      break;
+    }
+    if (!slot && !job->in_use) slot = job;
+  }
+
+  if (!slot) {
+    xSemaphoreGive(persistence.lock);
+    ESP_LOGE(PERSISTENCE_TAG, "No free job slot for key 0x%lx", (unsigned long) key);
+    return ESP_ERR_NO_MEM;
+  }
+
+  slot->in_use = true;
+  slot->pending = true;
+  slot->key = key;
+  slot->write = write;
+  slot->ctx = ctx;
+  slot->len = len;
+  if (len > 0) memcpy(slot->data, data, len);
+  xSemaphoreGive(persistence.lock);
+
+  xTaskNotifyGive(persistence.task);
+  return ESP_OK;
+}
+
+#endif
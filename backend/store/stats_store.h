@@ -0,0 +1,266 @@
+#ifndef STATS_STORE_H
+#define STATS_STORE_H
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../fixed.h"
+#include "persistence.h"
+#include "workout_log.h"
+
+/*
+ * Running aggregates per user and exercise, updated as each rep is logged, so statistics never
+ * need a scan of the workout log. Every user also has a totals row (empty exercise) across all
+ * exercises, which is also where reps without a selected exercise go. Weekly volume is kept for
+ * the last STATS_WEEKS weeks in a ring indexed by week number. The table is a fixed array
+ * persisted as one CRC-checked file through the persistence worker after every set, written
+ * beside the old file and renamed over it so a reset mid-write keeps the previous table; when
+ * full, the least recently used row is replaced.
+ */
+
+#define STATS_TAG "STATS"
+#define STATS_PATH "/cfg/stats.bin"
+#define STATS_TMP_PATH STATS_PATH ".tmp"
+#define STATS_MAX_ROWS 32
+#define STATS_WEEKS 8
+#define STATS_USER_NAME_LEN 16
+#define STATS_MAGIC 0x54415453 // "STAT"
+#define STATS_VERSION 1
+#define STATS_WEEK_MS (7LL * 24 * 3600 * 1000)
+#define STATS_WEEK_OFFSET_MS (3LL * 24 * 3600 * 1000) // weeks start on Monday 1969-12-29
+
+typedef struct __attribute__((packed)) {
+  uint32_t week; // weeks since the Monday before the epoch; 0 when unused
+  uint32_t reps;
+  uint32_t sets;
+  uint32_t rom; // sum of rep ROM, whole %
+} stats_week_t;
+
+typedef struct __attribute__((packed)) {
+  char user[STATS_USER_NAME_LEN];         // NUL-padded
+  char exercise[WORKOUT_EXERCISE_NAME_LEN]; // NUL-padded, empty for the user's totals
+  int64_t last_ms;
+  uint32_t total_reps;
+  uint32_t total_sets;
+  q16_t best_mpv;
+  q16_t best_peak_velocity;
+  q16_t best_rom;
+  stats_week_t weeks[STATS_WEEKS];
+} stats_row_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t rows;
+  uint32_t crc; // CRC32 of the rows that follow
+} stats_file_header_t;
+
+typedef struct {
+  SemaphoreHandle_t lock;
+  stats_row_t rows[STATS_MAX_ROWS];
+  size_t count;
+  // Eviction order: bumped on every lookup, so the rows just touched are never replaced.
+  // last_ms cannot order rows, as those written before the clock was set hold uptimes.
+  uint32_t used[STATS_MAX_ROWS];
+  uint32_t use_clock;
+} stats_store_t;
+
+static stats_store_t stats_store = {0};
+
+static inline uint32_t stats_week_of(int64_t time_ms) {
+  if (time_ms < WORKOUT_CLOCK_VALID_MS) return 0;
+  return (uint32_t) ((time_ms + STATS_WEEK_OFFSET_MS) / STATS_WEEK_MS);
+}
+
+static inline int64_t stats_week_start_ms(uint32_t week) {
+  return (int64_t) week * STATS_WEEK_MS - STATS_WEEK_OFFSET_MS;
+}
+
+// Finds or claims the row for user/exercise. Called with the lock held.
+static stats_row_t *stats_row(const char *user, const char *exercise) {
+  char user_key[STATS_USER_NAME_LEN] = {0};
+  char exercise_key[WORKOUT_EXERCISE_NAME_LEN] = {0};
+  strncpy(user_key, user ? user : "", sizeof(user_key));
+  strncpy(exercise_key, exercise ? exercise : "", sizeof(exercise_key));
+
+  size_t oldest = 0;
+  for (size_t i = 0; i < stats_store.count; i++) {
+    stats_row_t *row = &stats_store.rows[i];
+    if (memcmp(row->user, user_key, sizeof(user_key)) == 0 &&
+        memcmp(row->exercise, exercise_key, sizeof(exercise_key)) == 0) {
+      stats_store.used[i] = ++stats_store.use_clock;
+      return row;
+    }
+    // Rows not used since boot tie at 0; among those the older last_ms goes first
+    if (stats_store.used[i] < stats_store.used[oldest] ||
+        (stats_store.used[i] == stats_store.used[oldest] &&
+         row->last_ms < stats_store.rows[oldest].last_ms)) {
+      oldest = i;
+    }
+  }
+
+  size_t index = stats_store.count < STATS_MAX_ROWS ? stats_store.count++ : oldest;
+  stats_store.used[index] = ++stats_store.use_clock;
+  stats_row_t *row = &stats_store.rows[index];
+  *row = (stats_row_t) {0};
+  memcpy(row->user, user_key, sizeof(user_key));
+  memcpy(row->exercise, exercise_key, sizeof(exercise_key));
+  return row;
+}
+
+// The ring slot for a week, reset when it last held an older one
+static stats_week_t *stats_row_week(stats_row_t *row, uint32_t week) {
+  if (week == 0) return NULL;
+  stats_week_t *slot = &row->weeks[week % STATS_WEEKS];
+  if (slot->week != week) *slot = (stats_week_t) {.week = week};
+  return slot;
+}
+
+static void stats_row_add_rep(stats_row_t *row, const workout_record_t *record) {
+  row->last_ms = record->time_ms;
+  row->total_reps++;
+  if (record->rep.mean_propulsive_velocity > row->best_mpv) {
+    row->best_mpv = record->rep.mean_propulsive_velocity;
+  }
+  if (record->rep.peak_velocity > row->best_peak_velocity) {
+    row->best_peak_velocity = record->rep.peak_velocity;
+  }
+  if (record->rep.rom > row->best_rom) row->best_rom = record->rep.rom;
+
+  stats_week_t *week = stats_row_week(row, stats_week_of(record->time_ms));
+  if (week) {
+    week->reps++;
+    week->rom += (uint32_t) (record->rep.rom > 0 ? record->rep.rom >> Q16_SHIFT : 0);
+  }
+}
+
+static void stats_row_add_set(stats_row_t *row, int64_t time_ms) {
+  row->last_ms = time_ms;
+  row->total_sets++;
+  stats_week_t *week = stats_row_week(row, stats_week_of(time_ms));
+  if (week) week->sets++;
+}
+
+static esp_err_t stats_store_write(const void *data, size_t len, void *ctx) {
+  (void) data;
+  (void) len;
+  (void) ctx;
+
+  // Snapshot under the lock; the file is written without holding it
+  stats_row_t *rows = malloc(sizeof(stats_store.rows));
+  if (!rows) return ESP_ERR_NO_MEM;
+  xSemaphoreTake(stats_store.lock, portMAX_DELAY);
+  size_t count = stats_store.count;
+  memcpy(rows, stats_store.rows, count * sizeof(stats_row_t));
+  xSemaphoreGive(stats_store.lock);
+
+  stats_file_header_t header = {
+    .magic = STATS_MAGIC,
+    .version = STATS_VERSION,
+    .rows = (uint16_t) count,
+    .crc = esp_rom_crc32_le(0, (const uint8_t *) rows, count * sizeof(stats_row_t))};
+
+  esp_err_t err = ESP_FAIL;
+  FILE *file = fopen(STATS_TMP_PATH, "wb");
+  if (file) {
+    if (fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(rows, sizeof(stats_row_t), count, file) == count) {
+      err = ESP_OK;
+    }
+    if (fclose(file) != 0) err = ESP_FAIL;
+  }
+  free(rows);
+  if (err != ESP_OK) return err;
+
+  // LittleFS replaces the destination atomically; only fall back to remove() where it cannot
+  if (rename(STATS_TMP_PATH, STATS_PATH) == 0) return ESP_OK;
+  remove(STATS_PATH);
+  return rename(STATS_TMP_PATH, STATS_PATH) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * Loads the persisted table. A missing or corrupt file starts empty.
+ */
+esp_err_t stats_store_init(void) {
+  if (stats_store.lock) return ESP_OK;
+  stats_store.lock = xSemaphoreCreateMutex();
+  if (!stats_store.lock) return ESP_ERR_NO_MEM;
+
+  FILE *file = fopen(STATS_PATH, "rb");
+  if (!file) return ESP_OK;
+
+  stats_file_header_t header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == STATS_MAGIC &&
+            header.version == STATS_VERSION && header.rows <= STATS_MAX_ROWS &&
+            fread(stats_store.rows, sizeof(stats_row_t), header.rows, file) == header.rows &&
+            esp_rom_crc32_le(0, (const uint8_t *) stats_store.rows,
+                             header.rows * sizeof(stats_row_t)) == header.crc;
+  fclose(file);
+
+  stats_store.count = ok ? header.rows : 0;
+  if (!ok) ESP_LOGW(STATS_TAG, "Ignoring unreadable %s", STATS_PATH);
+  return ESP_OK;
+}
+
+/**
+ * Folds a logged rep into the user's rows for its exercise and for all exercises.
+ */
+void stats_store_add_rep(const char *user, const workout_record_t *record) {
+  if (!stats_store.lock || !record || record->type != WORKOUT_RECORD_REP) return;
+
+  char exercise[WORKOUT_EXERCISE_NAME_LEN + 1] = {0};
+  memcpy(exercise, record->exercise, WORKOUT_EXERCISE_NAME_LEN);
+
+  xSemaphoreTake(stats_store.lock, portMAX_DELAY);
+  if (exercise[0]) stats_row_add_rep(stats_row(user, exercise), record);
+  stats_row_add_rep(stats_row(user, ""), record);
+  xSemaphoreGive(stats_store.lock);
+}
+
+/**
+ * Counts a finished set and schedules the table to be saved.
+ */
+void stats_store_add_set(const char *user, const workout_record_t *record) {
+  if (!stats_store.lock || !record || record->type != WORKOUT_RECORD_SET_END) return;
+  if (record->summary.reps == 0) return;
+
+  char exercise[WORKOUT_EXERCISE_NAME_LEN + 1] = {0};
+  memcpy(exercise, record->exercise, WORKOUT_EXERCISE_NAME_LEN);
+
+  xSemaphoreTake(stats_store.lock, portMAX_DELAY);
+  if (exercise[0]) stats_row_add_set(stats_row(user, exercise), record->time_ms);
+  stats_row_add_set(stats_row(user, ""), record->time_ms);
+  xSemaphoreGive(stats_store.lock);
+
+  persistence_submit(PERSISTENCE_KEY_STATS, stats_store_write, NULL, NULL, 0);
+}
+
+/**
+ * Copies the rows matching user (all users when NULL) into out. Returns how many were copied.
+ */
+size_t stats_store_snapshot(const char *user, stats_row_t *out, size_t max) {
+  if (!stats_store.lock || !out) return 0;
+
+  char user_key[STATS_USER_NAME_LEN] = {0};
+  if (user) strncpy(user_key, user, sizeof(user_key));
+
+  size_t copied = 0;
+  xSemaphoreTake(stats_store.lock, portMAX_DELAY);
+  for (size_t i = 0; i < stats_store.count && copied < max; i++) {
+    if (user && memcmp(stats_store.rows[i].user, user_key, sizeof(user_key)) != 0) continue;
+    out[copied++] = stats_store.rows[i];
+  }
+  xSemaphoreGive(stats_store.lock);
+  return copied;
+}
+
+#endif
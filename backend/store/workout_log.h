@@ -0,0 +1,518 @@
+#ifndef WORKOUT_LOG_H
+#define WORKOUT_LOG_H
+
+#include <dirent.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../fixed.h"
+#include "persistence.h"
+
+/*
+ * Append-only workout log on the cfg partition. Records are fixed-size and kept in time order
+ * across segment files of WORKOUT_LOG_SEGMENT_RECORDS each; once WORKOUT_LOG_MAX_SEGMENTS exist
+ * the oldest is deleted. Appends land in a RAM buffer that the persistence worker writes out in
+ * batches, so flash sees one write per WORKOUT_LOG_BATCH records (or per set) rather than one per
+ * rep. A sparse index holds the timestamp of every WORKOUT_LOG_INDEX_STRIDE-th record of each
+ * segment, so a range query seeks close to its start instead of scanning the whole log. The
+ * index is rebuilt at boot by reading only those records. Records logged before the clock was set
+ * carry uptimes; the index stores the running maximum of record times, so such records never make
+ * it go backwards and range queries stay correct for every wall-clock record.
+ */
+
+#define WORKOUT_LOG_TAG "WORKOUT_LOG"
+#define WORKOUT_LOG_DIR "/cfg/workout"
+#define WORKOUT_LOG_PATH_MAX 32
+#define WORKOUT_LOG_SEGMENT_RECORDS 128 // 8 KB per segment
+#define WORKOUT_LOG_MAX_SEGMENTS 6
+#define WORKOUT_LOG_INDEX_STRIDE 16
+#define WORKOUT_LOG_INDEX_SIZE (WORKOUT_LOG_SEGMENT_RECORDS / WORKOUT_LOG_INDEX_STRIDE)
+#define WORKOUT_LOG_BATCH 16
+#define WORKOUT_LOG_BUFFER 32
+#define WORKOUT_LOG_READ_CHUNK 8
+#define WORKOUT_LOG_RECORD_VERSION 1
+#define WORKOUT_EXERCISE_NAME_LEN 20
+#define WORKOUT_CLOCK_VALID_MS 1577836800000LL // 2020-01-01, anything earlier was never set
+
+typedef enum {
+  WORKOUT_RECORD_SESSION_START = 1,
+  WORKOUT_RECORD_SESSION_END,
+  WORKOUT_RECORD_SET_START,
+  WORKOUT_RECORD_SET_END,
+  WORKOUT_RECORD_REP,
+} workout_record_type_t;
+
+#define WORKOUT_SIDE_LEFT 0
+#define WORKOUT_SIDE_RIGHT 1
+#define WORKOUT_SIDE_BOTH 2
+#define WORKOUT_SIDE_NONE 0xFF
+
+#define WORKOUT_RECORD_FLAG_CLOCK_SYNCED 0x01 // time_ms is wall clock, not time since boot
+#define WORKOUT_RECORD_FLAG_STOP_SET 0x02
+#define WORKOUT_RECORD_FLAG_BILATERAL 0x04
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;
+  uint8_t type;  // workout_record_type_t
+  uint8_t side;  // WORKOUT_SIDE_*
+  uint8_t flags; // WORKOUT_RECORD_FLAG_*
+  int64_t time_ms;
+  uint16_t session;
+  uint16_t set; // within the session, 0 for session records
+  char exercise[WORKOUT_EXERCISE_NAME_LEN]; // NUL-padded, not necessarily terminated
+  union {
+    struct __attribute__((packed)) {
+      q16_t rom;
+      q16_t peak_velocity;
+      q16_t mean_propulsive_velocity;
+      q16_t velocity_loss;
+      uint16_t concentric_ms;
+      uint16_t eccentric_ms;
+      int16_t rom_asymmetry;      // 0.1 %
+      int16_t velocity_asymmetry; // 0.1 %
+    } rep;
+    // SET_END, and SESSION_END with reps holding the number of sets
+    struct __attribute__((packed)) {
+      uint16_t reps;
+      uint16_t reserved;
+      uint32_t duration_ms;
+      q16_t best_mpv;
+      q16_t max_velocity_loss;
+      uint8_t reserved2[8];
+    } summary;
+    uint8_t payload[24];
+  };
+  uint32_t crc; // CRC32 of everything above
+} workout_record_t;
+
+_Static_assert(sizeof(workout_record_t) == 64, "workout_record_t must stay 64 bytes");
+
+typedef struct {
+  uint32_t number; // file name; increases with every new segment
+  size_t count;    // records on flash
+  int64_t index[WORKOUT_LOG_INDEX_SIZE]; // running maximum of record times, see above
+  int64_t last_ms;                       // the same maximum up to the newest record
+} workout_log_segment_t;
+
+typedef struct {
+  SemaphoreHandle_t lock;      // buffer and segment table
+  SemaphoreHandle_t file_lock; // flash; taken before lock
+  workout_log_segment_t segments[WORKOUT_LOG_MAX_SEGMENTS]; // oldest first
+  size_t segment_count;
+  workout_record_t buffer[WORKOUT_LOG_BUFFER];
+  size_t buffered;
+  workout_record_t staging[WORKOUT_LOG_BUFFER]; // being written, owned by the file_lock holder
+  uint32_t dropped;
+  workout_record_t last; // newest record, valid when has_last
+  bool has_last;
+} workout_log_t;
+
+static workout_log_t workout_log = {0};
+
+// Returns false to stop the iteration
+typedef bool (*workout_log_visit_fn)(const workout_record_t *record, void *ctx);
+
+static inline uint32_t workout_record_crc(const workout_record_t *record) {
+  return esp_rom_crc32_le(0, (const uint8_t *) record, offsetof(workout_record_t, crc));
+}
+
+static inline bool workout_record_valid(const workout_record_t *record) {
+  return record->version == WORKOUT_LOG_RECORD_VERSION && record->crc == workout_record_crc(record);
+}
+
+static inline void workout_log_segment_path(uint32_t number, char *out, size_t out_len) {
+  snprintf(out, out_len, WORKOUT_LOG_DIR "/%08lu.log", (unsigned long) number);
+}
+
+static void workout_log_index_record(workout_log_segment_t *segment, size_t position,
+                                     const workout_record_t *record) {
+  if (record->time_ms > segment->last_ms) segment->last_ms = record->time_ms;
+  if (position % WORKOUT_LOG_INDEX_STRIDE == 0) {
+    segment->index[position / WORKOUT_LOG_INDEX_STRIDE] = segment->last_ms;
+  }
+}
+
+// Reads the indexed records and the tail of a segment from flash, carrying on the running
+// maximum from floor_ms. Torn tails are cut off.
+static void workout_log_load_segment(workout_log_segment_t *segment, int64_t floor_ms) {
+  char path[WORKOUT_LOG_PATH_MAX];
+  workout_log_segment_path(segment->number, path, sizeof(path));
+
+  struct stat st;
+  segment->count = 0;
+  segment->last_ms = floor_ms;
+  if (stat(path, &st) != 0) return;
+  size_t count = (size_t) st.st_size / sizeof(workout_record_t);
+  if (count > WORKOUT_LOG_SEGMENT_RECORDS) count = WORKOUT_LOG_SEGMENT_RECORDS;
+  if ((size_t) st.st_size != count * sizeof(workout_record_t)) {
+    ESP_LOGW(WORKOUT_LOG_TAG, "Truncating torn segment %s", path);
+    truncate(path, (off_t) (count * sizeof(workout_record_t)));
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (!file) return;
+
+  workout_record_t record;
+  size_t position = 0;
+  for (; position < count; position += WORKOUT_LOG_INDEX_STRIDE) {
+    fseek(file, (long) (position * sizeof(record)), SEEK_SET);
+    bool ok = fread(&record, sizeof(record), 1, file) == 1 && workout_record_valid(&record);
+    if (ok && record.time_ms > segment->last_ms) segment->last_ms = record.time_ms;
+    segment->index[position / WORKOUT_LOG_INDEX_STRIDE] = segment->last_ms;
+  }
+
+  // The records after the last indexed one are read too, so last_ms is the true maximum
+  if (count > 0) {
+    position -= WORKOUT_LOG_INDEX_STRIDE;
+    fseek(file, (long) ((position + 1) * sizeof(record)), SEEK_SET);
+    for (position++; position < count; position++) {
+      if (fread(&record, sizeof(record), 1, file) != 1) break;
+      if (workout_record_valid(&record) && record.time_ms > segment->last_ms) {
+        segment->last_ms = record.time_ms;
+      }
+    }
+
+    fseek(file, (long) ((count - 1) * sizeof(record)), SEEK_SET);
+    if (fread(&record, sizeof(record), 1, file) == 1 && workout_record_valid(&record)) {
+      workout_log.last = record;
+      workout_log.has_last = true;
+    }
+  }
+  fclose(file);
+  segment->count = count;
+}
+
+static int workout_log_compare_numbers(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a;
+  uint32_t y = *(const uint32_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Finds the existing segments and rebuilds the index. Call once the cfg partition is mounted.
+ */
+esp_err_t workout_log_init(void) {
+  if (workout_log.lock) return ESP_OK;
+
+  workout_log.lock = xSemaphoreCreateMutex();
+  workout_log.file_lock = xSemaphoreCreateMutex();
+  if (!workout_log.lock || !workout_log.file_lock) return ESP_ERR_NO_MEM;
+
+  mkdir(WORKOUT_LOG_DIR, 0755);
+  DIR *dir = opendir(WORKOUT_LOG_DIR);
+  if (!dir) {
+    ESP_LOGE(WORKOUT_LOG_TAG, "Failed to open %s", WORKOUT_LOG_DIR);
+    return ESP_FAIL;
+  }
+
+  // Keep the newest segments; anything beyond the limit is left over from a larger build
+  uint32_t numbers[WORKOUT_LOG_MAX_SEGMENTS + 1];
+  size_t found = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    char *end = NULL;
+    unsigned long number = strtoul(entry->d_name, &end, 10);
+    if (end == entry->d_name || strcmp(end, ".log") != 0) continue;
+
+    numbers[found++] = (uint32_t) number;
+    qsort(numbers, found, sizeof(numbers[0]), workout_log_compare_numbers);
+    if (found > WORKOUT_LOG_MAX_SEGMENTS) {
+      char path[WORKOUT_LOG_PATH_MAX];
+      workout_log_segment_path(numbers[0], path, sizeof(path));
+      unlink(path);
+      memmove(numbers, numbers + 1, --found * sizeof(numbers[0]));
+    }
+  }
+  closedir(dir);
+
+  int64_t floor_ms = INT64_MIN;
+  for (size_t i = 0; i < found; i++) {
+    workout_log.segments[i].number = numbers[i];
+    workout_log_load_segment(&workout_log.segments[i], floor_ms);
+    floor_ms = workout_log.segments[i].last_ms;
+  }
+  workout_log.segment_count = found;
+
+  ESP_LOGI(WORKOUT_LOG_TAG, "%u segment(s) in %s", (unsigned) found, WORKOUT_LOG_DIR);
+  return ESP_OK;
+}
+
+// Returns the segment to append to, rotating when the newest is full. Called with both locks.
+static workout_log_segment_t *workout_log_writable_segment(void) {
+  if (workout_log.segment_count > 0) {
+    workout_log_segment_t *newest = &workout_log.segments[workout_log.segment_count - 1];
+    if (newest->count < WORKOUT_LOG_SEGMENT_RECORDS) return newest;
+  }
+
+  uint32_t number = 0;
+  int64_t floor_ms = INT64_MIN;
+  if (workout_log.segment_count > 0) {
+    number = workout_log.segments[workout_log.segment_count - 1].number + 1;
+    floor_ms = workout_log.segments[workout_log.segment_count - 1].last_ms;
+  }
+  if (workout_log.segment_count == WORKOUT_LOG_MAX_SEGMENTS) {
+    char path[WORKOUT_LOG_PATH_MAX];
+    workout_log_segment_path(workout_log.segments[0].number, path, sizeof(path));
+    unlink(path);
+    memmove(&workout_log.segments[0], &workout_log.segments[1],
+            (WORKOUT_LOG_MAX_SEGMENTS - 1) * sizeof(workout_log.segments[0]));
+    workout_log.segment_count--;
+  }
+
+  workout_log_segment_t *segment = &workout_log.segments[workout_log.segment_count++];
+  *segment = (workout_log_segment_t) {.number = number, .last_ms = floor_ms};
+  return segment;
+}
+
+/**
+ * Writes the buffered records to flash. Runs on the persistence worker.
+ */
+static esp_err_t workout_log_flush_now(void) {
+  esp_err_t result = ESP_OK;
+  xSemaphoreTake(workout_log.file_lock, portMAX_DELAY);
+
+  xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+  size_t count = workout_log.buffered;
+  memcpy(workout_log.staging, workout_log.buffer, count * sizeof(workout_record_t));
+  workout_log.buffered = 0;
+  xSemaphoreGive(workout_log.lock);
+
+  size_t written = 0;
+  while (written < count) {
+    xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+    workout_log_segment_t *segment = workout_log_writable_segment();
+    uint32_t number = segment->number;
+    size_t position = segment->count;
+    xSemaphoreGive(workout_log.lock);
+
+    size_t chunk = WORKOUT_LOG_SEGMENT_RECORDS - position;
+    if (chunk > count - written) chunk = count - written;
+
+    char path[WORKOUT_LOG_PATH_MAX];
+    workout_log_segment_path(number, path, sizeof(path));
+    FILE *file = fopen(path, "ab");
+    if (!file) {
+      result = ESP_FAIL;
+      break;
+    }
+    size_t done = fwrite(&workout_log.staging[written], sizeof(workout_record_t), chunk, file);
+    fclose(file);
+
+    xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+    for (size_t i = 0; i < done; i++) {
+      workout_log_index_record(segment, position + i, &workout_log.staging[written + i]);
+    }
+    segment->count += done;
+    xSemaphoreGive(workout_log.lock);
+
+    written += done;
+    if (done != chunk) {
+      result = ESP_FAIL;
+      break;
+    }
+  }
+
+  if (written < count) {
+    ESP_LOGE(WORKOUT_LOG_TAG, "Lost %u record(s) writing %s", (unsigned) (count - written),
+             WORKOUT_LOG_DIR);
+  }
+  xSemaphoreGive(workout_log.file_lock);
+  return result;
+}
+
+static esp_err_t workout_log_write(const void *data, size_t len, void *ctx) {
+  (void) data;
+  (void) len;
+  (void) ctx;
+  return workout_log_flush_now();
+}
+
+/**
+ * Schedules a write of everything appended so far.
+ */
+static inline void workout_log_flush(void) {
+  persistence_submit(PERSISTENCE_KEY_WORKOUT_LOG, workout_log_write, NULL, NULL, 0);
+}
+
+/**
+ * Buffers a record; the CRC and version are filled in here. Records beyond the buffer while the
+ * worker is behind are dropped and counted.
+ */
+void workout_log_append(const workout_record_t *record) {
+  if (!workout_log.lock || !record) return;
+
+  workout_record_t copy = *record;
+  copy.version = WORKOUT_LOG_RECORD_VERSION;
+  copy.crc = workout_record_crc(&copy);
+
+  xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+  bool flush = false;
+  if (workout_log.buffered < WORKOUT_LOG_BUFFER) {
+    workout_log.buffer[workout_log.buffered++] = copy;
+    flush = workout_log.buffered >= WORKOUT_LOG_BATCH;
+  } else {
+    workout_log.dropped++;
+  }
+  workout_log.last = copy;
+  workout_log.has_last = true;
+  xSemaphoreGive(workout_log.lock);
+
+  if (flush) workout_log_flush();
+}
+
+/**
+ * Copies the newest record, buffered or on flash. Returns false when the log is empty.
+ */
+bool workout_log_last(workout_record_t *out) {
+  if (!workout_log.lock || !out) return false;
+  xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+  bool has_last = workout_log.has_last;
+  if (has_last) *out = workout_log.last;
+  xSemaphoreGive(workout_log.lock);
+  return has_last;
+}
+
+// First record of the segment that can hold from_ms, by the sparse index. The index never
+// decreases, so no record at or after from_ms precedes the entry found.
+static size_t workout_log_seek_position(const workout_log_segment_t *segment, int64_t from_ms) {
+  size_t entries = (segment->count + WORKOUT_LOG_INDEX_STRIDE - 1) / WORKOUT_LOG_INDEX_STRIDE;
+  size_t lo = 0;
+  size_t hi = entries;
+  // Last entry whose timestamp is below from_ms; the match can only follow it
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (segment->index[mid] < from_ms) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo * WORKOUT_LOG_INDEX_STRIDE;
+}
+
+// Reads up to max records at position from a segment still present in the log. Holds the file
+// lock only for the read, so long queries do not stall the writer.
+static size_t workout_log_read_chunk(uint32_t number, size_t position, workout_record_t *out,
+                                     size_t max) {
+  size_t got = 0;
+  xSemaphoreTake(workout_log.file_lock, portMAX_DELAY);
+
+  // Rotation may have deleted it since the query started
+  bool present = workout_log.segment_count > 0 && number >= workout_log.segments[0].number;
+  if (present) {
+    char path[WORKOUT_LOG_PATH_MAX];
+    workout_log_segment_path(number, path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (file) {
+      fseek(file, (long) (position * sizeof(workout_record_t)), SEEK_SET);
+      got = fread(out, sizeof(workout_record_t), max, file);
+      fclose(file);
+    }
+  }
+
+  xSemaphoreGive(workout_log.file_lock);
+  return got;
+}
+
+// Returns false once the visitor stopped or the range is past
+static bool workout_log_visit_segment(const workout_log_segment_t *segment, int64_t from_ms,
+                                      int64_t to_ms, workout_log_visit_fn visit, void *ctx) {
+  size_t position = workout_log_seek_position(segment, from_ms);
+  workout_record_t chunk[WORKOUT_LOG_READ_CHUNK];
+
+  while (position < segment->count) {
+    size_t wanted = segment->count - position;
+    if (wanted > WORKOUT_LOG_READ_CHUNK) wanted = WORKOUT_LOG_READ_CHUNK;
+    size_t got = workout_log_read_chunk(segment->number, position, chunk, wanted);
+    if (got == 0) break;
+    position += got;
+
+    for (size_t i = 0; i < got; i++) {
+      if (!workout_record_valid(&chunk[i])) continue;
+      if (chunk[i].time_ms < from_ms) continue;
+      if (chunk[i].time_ms > to_ms) return false;
+      if (!visit(&chunk[i], ctx)) return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Calls visit for every record with from_ms <= time_ms <= to_ms, oldest first, including
+ * records not yet on flash. Relies on wall-clock record times never going backwards, which
+ * ws_workout_set_clock guarantees by never stepping the clock back; records logged before the
+ * clock was set are below any wall-clock range and are only skipped over. Records appended while
+ * the query runs may or may not be visited.
+ */
+esp_err_t workout_log_read(int64_t from_ms, int64_t to_ms, workout_log_visit_fn visit, void *ctx) {
+  if (!workout_log.lock || !visit) return ESP_ERR_INVALID_STATE;
+
+  // Segments are read as they were when the query started; records buffered by then follow
+  xSemaphoreTake(workout_log.file_lock, portMAX_DELAY);
+  xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+  workout_log_segment_t segments[WORKOUT_LOG_MAX_SEGMENTS];
+  size_t segment_count = workout_log.segment_count;
+  memcpy(segments, workout_log.segments, segment_count * sizeof(segments[0]));
+  size_t buffered = workout_log.buffered;
+  xSemaphoreGive(workout_log.lock);
+  xSemaphoreGive(workout_log.file_lock);
+
+  bool more = true;
+  for (size_t i = 0; i < segment_count && more; i++) {
+    if (segments[i].count == 0 || segments[i].last_ms < from_ms) continue;
+    if (segments[i].index[0] > to_ms) break;
+    more = workout_log_visit_segment(&segments[i], from_ms, to_ms, visit, ctx);
+  }
+
+  // The buffer may have been flushed meanwhile; those records are then simply not visited
+  for (size_t i = 0; more && i < buffered; i++) {
+    workout_record_t record;
+    xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+    bool has = i < workout_log.buffered;
+    if (has) record = workout_log.buffer[i];
+    xSemaphoreGive(workout_log.lock);
+    if (!has) break;
+
+    if (record.time_ms < from_ms) continue;
+    if (record.time_ms > to_ms) break;
+    more = visit(&record, ctx);
+  }
+
+  return ESP_OK;
+}
+
+/**
+ * Times of the oldest and newest records. Returns false when the log is empty.
+ */
+bool workout_log_bounds(int64_t *first_ms, int64_t *last_ms) {
+  if (!workout_log.lock || !first_ms || !last_ms) return false;
+
+  xSemaphoreTake(workout_log.lock, portMAX_DELAY);
+  bool found = workout_log.has_last;
+  if (found) {
+    *last_ms = workout_log.last.time_ms;
+    *first_ms = workout_log.buffered > 0 ? workout_log.buffer[0].time_ms : *last_ms;
+    for (size_t i = 0; i < workout_log.segment_count; i++) {
+      if (workout_log.segments[i].count > 0) {
+        *first_ms = workout_log.segments[i].index[0];
+        break;
+      }
+    }
+  }
+  xSemaphoreGive(workout_log.lock);
+  return found;
+}
+
+#endif
@@ -19,6 +19,7 @@ typedef void (*https_server_register_handlers_fn)(httpd_handle_t server, void *c
 
 typedef struct {
   size_t max_uri_handlers;
+  httpd_close_func_t close_fn; // optional; must close the socket itself
 } https_server_config_t;
 
 typedef struct {
@@ -82,6 +83,7 @@ esp_err_t https_server_start(const https_server_config_t *config,
   server_config.httpd.max_uri_handlers =
     https_server_config.max_uri_handlers ? https_server_config.max_uri_handlers : 8;
   server_config.httpd.server_port = 443;
+  server_config.httpd.close_fn = https_server_config.close_fn;
   server_config.session_tickets = true;
   server_config.servercert = (const unsigned char *) https_bundle.cert_pem;
   server_config.servercert_len = https_bundle.cert_len;
@@ -1,14 +1,20 @@
 #ifndef WS_SERVER_H
 #define WS_SERVER_H
 
+#include <cJSON.h>
 #include <esp_http_server.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <sdkconfig.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
 
 #include "../../utils.h"
 
@@ -17,114 +23,622 @@
 #define WS_MAX_SUBSCRIBERS 4
 #define WS_HANDSHAKE_INTERVAL_MS 10000
 #define WS_HANDSHAKE_TASK_STACK 4096
-
+#define WS_URI_HANDLERS 1
+// Clients offering this subprotocol receive position updates as binary frames
+#define WS_SUBPROTOCOL_BINARY "lift.bin.v1"
+
+/*
+ * Broadcast messages come from a fixed pool so the publish path never touches the heap. Small
+ * slots fit position, handshake and stop events; the few large ones take reps, telemetry and
+ * whatever finds the small slots exhausted. A message no free slot can hold is dropped and
+ * counted rather than waited for.
+ */
+#define WS_POOL_SMALL_SIZE 256
+#define WS_POOL_SMALL_COUNT 16
+#define WS_POOL_LARGE_SIZE 1536
+#define WS_POOL_LARGE_COUNT 6
+#define WS_POOL_DROP_LOG_EVERY 64
+
+/*
+ * Fan-out. Publishers never send; they either replace a latest-value slot (positions, one slot
+ * per encoder) or append to the must-deliver event ring (everything else). A frame task flushes
+ * at ws_frame_rate_hz: each client gets its pending events in order, then every slot that changed
+ * since it last saw it, so positions coalesce while events are kept until every client has them.
+ * A client whose sends are slow is skipped for a while instead of stalling the others; one that
+ * falls a whole ring behind loses the oldest events and they are counted as dropped.
+ */
+#define WS_FRAME_RATE_HZ_DEFAULT 60
+#define WS_FRAME_RATE_HZ_MAX 1000
+#define WS_FRAME_TASK_STACK 3072
+#define WS_LATEST_SLOTS 8
+#define WS_EVENT_RING 32
+#define WS_FLUSH_EVENT_BUDGET 8 // per client per frame
+#define WS_MAX_CLIENTS 8
+#define WS_SLOW_SEND_US 20000
+#define WS_MAX_BACKOFF_US 1000000
+
+/*
+ * Every message carries a topic mask and sessions only get what they subscribed to; new sessions
+ * start subscribed to everything. Latest-value slots are one topic bit each, event topics follow.
+ * Publishers name their topics with ws_topic_define() so clients can send
+ * {"event": "subscribe" | "unsubscribe", "topics": ["rep", ...]}; "all" matches every topic.
+ */
+#define WS_MAX_TOPICS 16
+#define WS_TOPIC_NAME_LEN 24
+#define WS_TOPIC_ALL UINT32_MAX
+#define WS_TOPIC_LATEST(slot) (1u << (slot))
+#define WS_TOPIC_EVENT(n) (1u << (WS_LATEST_SLOTS + (n)))
+
+/*
+ * A pooled broadcast message. data is sent as a text frame; when binary is also set, sessions on
+ * the binary subprotocol get that instead. Either may be NULL to skip one kind of client. Both
+ * point into storage, which belongs to the slot. The slot returns to its free list when the last
+ * reference (the ring or latest table, plus any send in progress) is dropped.
+ */
 typedef struct {
-  httpd_handle_t hd;
+  uint32_t topics;
   char *data;
+  uint8_t *binary;
+  size_t binary_len;
+  atomic_uint refs;
+  uint8_t *storage;
+  size_t capacity;
+  QueueHandle_t home;
 } resp_arg_t;
 
+typedef struct {
+  uint32_t sent;    // frames written to clients
+  uint32_t dropped; // pool exhausted, message too large or event overrun
+  uint32_t in_use;
+  uint32_t peak;
+} ws_pool_stats_t;
+
 typedef void (*ws_message_callback_t)(const char *payload, size_t len, void *ctx);
 
+typedef struct {
+  char name[WS_TOPIC_NAME_LEN];
+  uint32_t mask;
+} ws_topic_t;
+
+// Per-session context: fragment reassembly, the negotiated subprotocol and fan-out cursors
 typedef struct {
   httpd_ws_type_t type;
   uint8_t *buf;
   size_t len;
+  bool binary;
+  uint32_t topics;
+  uint32_t event_seq; // next event to deliver
+  uint32_t latest_version[WS_LATEST_SLOTS];
+  int64_t resume_us; // backed off until then after a slow send
 } ws_frag_ctx_t;
 
+typedef struct {
+  SemaphoreHandle_t lock;
+  resp_arg_t *latest[WS_LATEST_SLOTS];
+  uint32_t latest_version[WS_LATEST_SLOTS];
+  resp_arg_t *events[WS_EVENT_RING];
+  uint32_t head; // sequence of the next event
+  uint32_t tail; // oldest event still held
+  atomic_uint subscribed; // union of session topics, recomputed on every flush
+  atomic_bool dirty;
+  atomic_bool flush_queued;
+} ws_fanout_t;
+
 static ws_message_callback_t ws_subscribers[WS_MAX_SUBSCRIBERS];
 static void *ws_subscriber_ctx[WS_MAX_SUBSCRIBERS];
 static size_t ws_subscriber_count = 0;
+static int ws_dispatch_sockfd = -1; // session whose message the subscribers are handling
 static httpd_handle_t ws_server_handle = NULL;
 
-static esp_err_t ws_handler(httpd_req_t *req);
-void ws_send_message(resp_arg_t *resp_arg);
+static resp_arg_t ws_pool_small[WS_POOL_SMALL_COUNT];
+static resp_arg_t ws_pool_large[WS_POOL_LARGE_COUNT];
+static uint8_t ws_pool_small_storage[WS_POOL_SMALL_COUNT][WS_POOL_SMALL_SIZE];
+static uint8_t ws_pool_large_storage[WS_POOL_LARGE_COUNT][WS_POOL_LARGE_SIZE];
+static QueueHandle_t ws_pool_small_free = NULL;
+static QueueHandle_t ws_pool_large_free = NULL;
+static atomic_uint ws_pool_sent;
+static atomic_uint ws_pool_dropped;
+static atomic_uint ws_pool_in_use;
+static atomic_uint ws_pool_peak;
+
+static ws_fanout_t ws_fanout = {0};
+static ws_topic_t ws_topics[WS_MAX_TOPICS];
+static size_t ws_topic_count = 0;
+
+/*
+ * Active websocket sessions, so the flush never has to enumerate and classify every httpd socket.
+ * Entries are added at the upgrade and removed by ws_session_close(), which must be installed as
+ * the server's close_fn. Only touched from the httpd task.
+ */
+typedef struct {
+  int fd;
+  ws_frag_ctx_t *ctx;
+} ws_client_t;
 
-static void ws_handshake_broadcast_task(void *arg) {
-  (void) arg;
-  const uint32_t interval_ticks = (uint32_t) pdMS_TO_TICKS(WS_HANDSHAKE_INTERVAL_MS);
+static ws_client_t ws_clients[WS_MAX_CLIENTS];
+static size_t ws_client_count = 0;
 
-  while (1) {
-    if (ws_server_handle) {
-      resp_arg_t *resp_arg = malloc(sizeof(resp_arg_t));
-      if (resp_arg) {
-        resp_arg->hd = ws_server_handle;
-        resp_arg->data = strdup("{\"event\":\"handshake\"}");
-        if (resp_arg->data) {
-          ws_send_message(resp_arg);
-        } else {
-          free(resp_arg);
-        }
-      }
+static bool ws_client_add(int fd, ws_frag_ctx_t *ctx) {
+  if (ws_client_count >= WS_MAX_CLIENTS) return false;
+  ws_clients[ws_client_count++] = (ws_client_t) {.fd = fd, .ctx = ctx};
+  return true;
+}
+
+static void ws_client_remove(int fd) {
+  for (size_t i = 0; i < ws_client_count; i++) {
+    if (ws_clients[i].fd == fd) {
+      ws_clients[i] = ws_clients[--ws_client_count];
+      return;
     }
-    vTaskDelay(interval_ticks);
   }
 }
 
-void ws_register(httpd_handle_t server) {
-  ws_server_handle = server;
-  static bool handshake_started = false;
-  if (!handshake_started) {
-    handshake_started = true;
-    xTaskCreate(ws_handshake_broadcast_task, "ws_handshake_broadcast", WS_HANDSHAKE_TASK_STACK,
-                NULL, 5, NULL);
+/**
+ * close_fn for the server hosting /ws. Drops the session from the registry and closes the socket,
+ * which httpd leaves to close_fn once one is set.
+ */
+void ws_session_close(httpd_handle_t hd, int sockfd) {
+  (void) hd;
+  ws_client_remove(sockfd);
+  close(sockfd);
+}
+
+static esp_err_t ws_handler(httpd_req_t *req);
+bool ws_broadcast(uint32_t topics, const char *text, const void *binary, size_t binary_len);
+
+/**
+ * Names a topic for subscribe messages. Defining a name again adds mask to it, so an umbrella
+ * topic can collect several bits. Call before the server starts.
+ */
+bool ws_topic_define(const char *name, uint32_t mask) {
+  if (!name || strlen(name) >= WS_TOPIC_NAME_LEN) return false;
+  for (size_t i = 0; i < ws_topic_count; i++) {
+    if (strcmp(ws_topics[i].name, name) == 0) {
+      ws_topics[i].mask |= mask;
+      return true;
+    }
   }
-  ESP_ERROR_CHECK(httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/ws",
-                                                                     .method = HTTP_GET,
-                                                                     .handler = ws_handler,
-                                                                     .user_ctx = NULL,
-                                                                     .is_websocket = true}));
+  if (ws_topic_count >= WS_MAX_TOPICS) return false;
+  strcpy(ws_topics[ws_topic_count].name, name);
+  ws_topics[ws_topic_count].mask = mask;
+  ws_topic_count++;
+  return true;
 }
 
-bool ws_subscribe_message(ws_message_callback_t cb, void *ctx) {
-  if (!cb || ws_subscriber_count >= WS_MAX_SUBSCRIBERS) return false;
-  ws_subscribers[ws_subscriber_count] = cb;
-  ws_subscriber_ctx[ws_subscriber_count] = ctx;
-  ws_subscriber_count++;
+static uint32_t ws_topic_lookup(const char *name) {
+  if (strcmp(name, "all") == 0) return WS_TOPIC_ALL;
+  for (size_t i = 0; i < ws_topic_count; i++) {
+    if (strcmp(ws_topics[i].name, name) == 0) return ws_topics[i].mask;
+  }
+  return 0;
+}
+
+// True when some session wants topics; publishers check this before formatting anything
+static inline bool ws_has_subscribers(uint32_t topics) {
+  return ws_server_handle && (atomic_load(&ws_fanout.subscribed) & topics);
+}
+
+static bool ws_pool_fill(resp_arg_t *slots, uint8_t *storage, size_t size, size_t count,
+                         QueueHandle_t *free_list) {
+  *free_list = xQueueCreate(count, sizeof(resp_arg_t *));
+  if (!*free_list) return false;
+  for (size_t i = 0; i < count; i++) {
+    resp_arg_t *slot = &slots[i];
+    slot->storage = storage + i * size;
+    slot->capacity = size;
+    slot->home = *free_list;
+    xQueueSend(*free_list, &slot, 0);
+  }
   return true;
 }
 
-void ws_async_send(void *arg) {
-  resp_arg_t *resp_arg = (resp_arg_t *) arg;
+static void ws_pool_init(void) {
+  if (ws_pool_small_free) return;
+  if (!ws_pool_fill(ws_pool_large, &ws_pool_large_storage[0][0], WS_POOL_LARGE_SIZE,
+                    WS_POOL_LARGE_COUNT, &ws_pool_large_free) ||
+      !ws_pool_fill(ws_pool_small, &ws_pool_small_storage[0][0], WS_POOL_SMALL_SIZE,
+                    WS_POOL_SMALL_COUNT, &ws_pool_small_free)) {
+    ESP_LOGE(WS_TAG, "Could not create message pool");
+  }
+}
 
-  httpd_ws_frame_t ws_pkt = {0};
-  ws_pkt.payload = (uint8_t *) resp_arg->data;
-  ws_pkt.len = strlen(resp_arg->data);
-  ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-  ws_pkt.fragmented = false;
-  ws_pkt.final = true;
+static resp_arg_t *ws_pool_take(size_t len) {
+  resp_arg_t *slot = NULL;
+  if (len <= WS_POOL_SMALL_SIZE && xQueueReceive(ws_pool_small_free, &slot, 0) == pdTRUE) {
+    return slot;
+  }
+  if (len <= WS_POOL_LARGE_SIZE && xQueueReceive(ws_pool_large_free, &slot, 0) == pdTRUE) {
+    return slot;
+  }
+  return NULL;
+}
 
-  size_t fds = CONFIG_LWIP_MAX_SOCKETS;
-  int client_fds[CONFIG_LWIP_MAX_SOCKETS];
+static inline void ws_msg_ref(resp_arg_t *msg) { atomic_fetch_add(&msg->refs, 1); }
 
-  esp_err_t ret;
+static void ws_msg_unref(resp_arg_t *msg) {
+  if (!msg || atomic_fetch_sub(&msg->refs, 1) != 1) return;
+  msg->data = NULL;
+  msg->binary = NULL;
+  msg->binary_len = 0;
+  atomic_fetch_sub(&ws_pool_in_use, 1);
+  xQueueSend(msg->home, &msg, 0);
+}
 
-  if ((ret = httpd_get_client_list(resp_arg->hd, &fds, client_fds))) {
-    ESP_LOGW(WS_TAG, "httpd_get_client_list failed: %d", (int) ret);
-    goto cleanup;
+static void ws_pool_count_drop(const char *why, unsigned count) {
+  unsigned before = atomic_fetch_add(&ws_pool_dropped, count);
+  unsigned after = before + count;
+  if (before == 0 || before / WS_POOL_DROP_LOG_EVERY != after / WS_POOL_DROP_LOG_EVERY) {
+    ESP_LOGW(WS_TAG, "Dropped ws message (%s), %u dropped so far", why, after);
+  }
+}
+
+void ws_pool_get_stats(ws_pool_stats_t *out) {
+  if (!out) return;
+  out->sent = atomic_load(&ws_pool_sent);
+  out->dropped = atomic_load(&ws_pool_dropped);
+  out->in_use = atomic_load(&ws_pool_in_use);
+  out->peak = atomic_load(&ws_pool_peak);
+}
+
+// Copies text and/or binary into a pooled message holding one reference
+static resp_arg_t *ws_msg_create(uint32_t topics, const char *text, const void *binary,
+                                 size_t binary_len) {
+  if (!ws_pool_small_free || (!text && !binary)) return NULL;
+
+  size_t text_len = text ? strlen(text) + 1 : 0;
+  resp_arg_t *msg = ws_pool_take(text_len + binary_len);
+  if (!msg) {
+    ws_pool_count_drop(text_len + binary_len > WS_POOL_LARGE_SIZE ? "too large" : "pool empty",
+                       1);
+    return NULL;
+  }
+
+  unsigned in_use = atomic_fetch_add(&ws_pool_in_use, 1) + 1;
+  unsigned peak = atomic_load(&ws_pool_peak);
+  while (in_use > peak && !atomic_compare_exchange_weak(&ws_pool_peak, &peak, in_use)) {
+  }
+
+  atomic_store(&msg->refs, 1);
+  msg->topics = topics;
+  if (text) msg->data = memcpy(msg->storage, text, text_len);
+  if (binary) {
+    msg->binary = memcpy(msg->storage + text_len, binary, binary_len);
+    msg->binary_len = binary_len;
+  }
+  return msg;
+}
+
+/**
+ * Queues a must-deliver event for every client subscribed to topics. text and binary (see
+ * resp_arg_t) are copied, so callers may pass stack buffers. Returns false when nobody is
+ * subscribed or the message was dropped.
+ */
+bool ws_broadcast(uint32_t topics, const char *text, const void *binary, size_t binary_len) {
+  if (!ws_fanout.lock || !ws_has_subscribers(topics)) return false;
+  resp_arg_t *msg = ws_msg_create(topics, text, binary, binary_len);
+  if (!msg) return false;
+
+  resp_arg_t *overrun = NULL;
+  xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+  if (ws_fanout.head - ws_fanout.tail == WS_EVENT_RING) {
+    overrun = ws_fanout.events[ws_fanout.tail % WS_EVENT_RING];
+    ws_fanout.events[ws_fanout.tail % WS_EVENT_RING] = NULL;
+    ws_fanout.tail++;
+  }
+  ws_fanout.events[ws_fanout.head % WS_EVENT_RING] = msg;
+  ws_fanout.head++;
+  xSemaphoreGive(ws_fanout.lock);
+
+  if (overrun) {
+    ws_msg_unref(overrun);
+    ws_pool_count_drop("event overrun", 1);
+  }
+  atomic_store(&ws_fanout.dirty, true);
+  return true;
+}
+
+/**
+ * Replaces latest-value slot (0..WS_LATEST_SLOTS-1), topic WS_TOPIC_LATEST(slot). Clients only
+ * ever get the newest value of a slot, at most once per frame. The slot is kept even without
+ * subscribers so a client subscribing later starts from the current value.
+ */
+bool ws_publish_latest(size_t slot, const char *text, const void *binary, size_t binary_len) {
+  if (!ws_fanout.lock || !ws_server_handle || slot >= WS_LATEST_SLOTS) return false;
+  resp_arg_t *msg = ws_msg_create(WS_TOPIC_LATEST(slot), text, binary, binary_len);
+  if (!msg) return false;
+
+  xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+  resp_arg_t *previous = ws_fanout.latest[slot];
+  ws_fanout.latest[slot] = msg;
+  ws_fanout.latest_version[slot]++;
+  xSemaphoreGive(ws_fanout.lock);
+
+  ws_msg_unref(previous);
+  atomic_store(&ws_fanout.dirty, true);
+  return true;
+}
+
+static esp_err_t ws_send_msg(httpd_handle_t hd, int fd, const ws_frag_ctx_t *ctx,
+                             const resp_arg_t *msg) {
+  httpd_ws_frame_t pkt = {.final = true};
+  if (ctx->binary && msg->binary) {
+    pkt.type = HTTPD_WS_TYPE_BINARY;
+    pkt.payload = msg->binary;
+    pkt.len = msg->binary_len;
+  } else if (msg->data) {
+    pkt.type = HTTPD_WS_TYPE_TEXT;
+    pkt.payload = (uint8_t *) msg->data;
+    pkt.len = strlen(msg->data);
+  } else {
+    return ESP_OK;
+  }
+  esp_err_t err = httpd_ws_send_frame_async(hd, fd, &pkt);
+  if (err == ESP_OK) atomic_fetch_add(&ws_pool_sent, 1);
+  return err;
+}
+
+// Sends msg and backs the client off when the send took over WS_SLOW_SEND_US, setting *slow
+static esp_err_t ws_send_paced(httpd_handle_t hd, int fd, ws_frag_ctx_t *ctx, resp_arg_t *msg,
+                               bool *slow) {
+  int64_t started_us = esp_timer_get_time();
+  esp_err_t err = ws_send_msg(hd, fd, ctx, msg);
+  int64_t elapsed_us = esp_timer_get_time() - started_us;
+  if (err == ESP_OK && elapsed_us > WS_SLOW_SEND_US) {
+    ctx->resume_us = started_us + (elapsed_us * 2 < WS_MAX_BACKOFF_US ? elapsed_us * 2
+                                                                      : WS_MAX_BACKOFF_US);
+    *slow = true;
+  }
+  return err;
+}
+
+// Sends one client its share of this frame; sets *pending when something is left for the next.
+// Stops at the first slow send so one client cannot hold the others up for a whole budget.
+static esp_err_t ws_flush_client(httpd_handle_t hd, int fd, ws_frag_ctx_t *ctx, bool *pending) {
+  esp_err_t err = ESP_OK;
+  bool slow = false;
+
+  // Skipping an unsubscribed event is free; only sends count against the budget
+  for (size_t sent = 0; sent < WS_FLUSH_EVENT_BUDGET;) {
+    xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+    if ((int32_t) (ctx->event_seq - ws_fanout.tail) < 0) {
+      ws_pool_count_drop("client overrun", ws_fanout.tail - ctx->event_seq);
+      ctx->event_seq = ws_fanout.tail;
+    }
+    resp_arg_t *msg = NULL;
+    if (ctx->event_seq != ws_fanout.head) {
+      msg = ws_fanout.events[ctx->event_seq % WS_EVENT_RING];
+      ws_msg_ref(msg);
+    }
+    xSemaphoreGive(ws_fanout.lock);
+    if (!msg) break;
+
+    if (msg->topics & ctx->topics) {
+      err = ws_send_paced(hd, fd, ctx, msg, &slow);
+      sent++;
+    }
+    ws_msg_unref(msg);
+    if (err != ESP_OK) return err;
+    ctx->event_seq++;
+    if (slow) {
+      *pending = true;
+      return ESP_OK;
+    }
+  }
+  if (ctx->event_seq != ws_fanout.head) *pending = true;
+
+  for (size_t slot = 0; slot < WS_LATEST_SLOTS; slot++) {
+    // Unsubscribed slots keep their version so a later subscribe delivers the current value
+    if (!(ctx->topics & WS_TOPIC_LATEST(slot))) continue;
+    xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+    resp_arg_t *msg = NULL;
+    uint32_t version = ws_fanout.latest_version[slot];
+    if (version != ctx->latest_version[slot] && ws_fanout.latest[slot]) {
+      msg = ws_fanout.latest[slot];
+      ws_msg_ref(msg);
+    }
+    xSemaphoreGive(ws_fanout.lock);
+    if (!msg) continue;
+
+    err = ws_send_paced(hd, fd, ctx, msg, &slow);
+    ws_msg_unref(msg);
+    if (err != ESP_OK) return err;
+    ctx->latest_version[slot] = version;
+    if (slow) {
+      *pending = true;
+      return ESP_OK;
+    }
   }
+  return ESP_OK;
+}
 
-  for (int i = 0; i < fds; i++) {
-    int client_info = httpd_ws_get_fd_info(resp_arg->hd, client_fds[i]);
-    if (client_info == HTTPD_WS_CLIENT_WEBSOCKET) {
-      ret = httpd_ws_send_frame_async(resp_arg->hd, client_fds[i], &ws_pkt);
+// Runs on the httpd task, queued by the frame task
+static void ws_flush(void *arg) {
+  (void) arg;
+  httpd_handle_t hd = ws_server_handle;
+  bool pending = false;
+  uint32_t subscribed = 0;
+
+  xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+  uint32_t oldest_needed = ws_fanout.head;
+  xSemaphoreGive(ws_fanout.lock);
+
+  // Backwards, since a failed client is swapped out for the last one
+  for (size_t i = ws_client_count; i-- > 0;) {
+    int fd = ws_clients[i].fd;
+    ws_frag_ctx_t *ctx = ws_clients[i].ctx;
+
+    if (esp_timer_get_time() < ctx->resume_us) {
+      pending = true;
+    } else {
+      esp_err_t ret = ws_flush_client(hd, fd, ctx, &pending);
       if (ret != ESP_OK) {
-        ESP_LOGW(WS_TAG, "ws send failed fd=%d err=%d; closing session", client_fds[i], (int) ret);
-        httpd_sess_trigger_close(resp_arg->hd, client_fds[i]);
+        ESP_LOGW(WS_TAG, "ws send failed fd=%d err=%d; closing session", fd, (int) ret);
+        ws_client_remove(fd);
+        httpd_sess_trigger_close(hd, fd);
+        continue;
       }
     }
+    subscribed |= ctx->topics;
+    if ((int32_t) (ctx->event_seq - oldest_needed) < 0) oldest_needed = ctx->event_seq;
   }
 
-cleanup:
-  free(resp_arg->data);
-  free(resp_arg);
+  // Release the events every client has had
+  resp_arg_t *done[WS_EVENT_RING];
+  size_t done_count = 0;
+  xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+  while ((int32_t) (oldest_needed - ws_fanout.tail) > 0) {
+    done[done_count++] = ws_fanout.events[ws_fanout.tail % WS_EVENT_RING];
+    ws_fanout.events[ws_fanout.tail % WS_EVENT_RING] = NULL;
+    ws_fanout.tail++;
+  }
+  xSemaphoreGive(ws_fanout.lock);
+  for (size_t i = 0; i < done_count; i++) ws_msg_unref(done[i]);
+
+  atomic_store(&ws_fanout.subscribed, subscribed);
+  atomic_store(&ws_fanout.flush_queued, false);
+  if (pending) atomic_store(&ws_fanout.dirty, true);
+}
+
+static int ws_frame_rate_hz = WS_FRAME_RATE_HZ_DEFAULT;
+
+/**
+ * Sets how many frames per second the frame task flushes; out-of-range rates keep the default.
+ * Call before the first ws_register(), which starts the task. Rates above the tick rate give one
+ * frame per tick.
+ */
+void ws_set_frame_rate(int hz) {
+  if (hz < 1 || hz > WS_FRAME_RATE_HZ_MAX) {
+    ESP_LOGW(WS_TAG, "Frame rate %d Hz out of range, using %d", hz, WS_FRAME_RATE_HZ_DEFAULT);
+    hz = WS_FRAME_RATE_HZ_DEFAULT;
+  }
+  ws_frame_rate_hz = hz;
+}
+
+static void ws_frame_task(void *arg) {
+  (void) arg;
+  TickType_t period = pdMS_TO_TICKS(1000 / ws_frame_rate_hz);
+  if (period == 0) period = 1;
+  TickType_t last_wake = xTaskGetTickCount();
+
+  while (1) {
+    vTaskDelayUntil(&last_wake, period);
+    if (!ws_server_handle || atomic_load(&ws_fanout.flush_queued)) continue;
+    if (!atomic_exchange(&ws_fanout.dirty, false)) continue;
+
+    atomic_store(&ws_fanout.flush_queued, true);
+    if (httpd_queue_work(ws_server_handle, ws_flush, NULL) != ESP_OK) {
+      atomic_store(&ws_fanout.flush_queued, false);
+      atomic_store(&ws_fanout.dirty, true);
+    }
+  }
+}
+
+// New sessions start at the current end of the event ring and get every latest value
+static void ws_fanout_attach(ws_frag_ctx_t *ctx) {
+  xSemaphoreTake(ws_fanout.lock, portMAX_DELAY);
+  ctx->event_seq = ws_fanout.head;
+  xSemaphoreGive(ws_fanout.lock);
+  memset(ctx->latest_version, 0, sizeof(ctx->latest_version));
+  ctx->resume_us = 0;
+  ctx->topics = WS_TOPIC_ALL;
+  atomic_fetch_or(&ws_fanout.subscribed, ctx->topics);
+  atomic_store(&ws_fanout.dirty, true);
 }
 
-void ws_send_message(resp_arg_t *resp_arg) {
-  if (httpd_queue_work(resp_arg->hd, ws_async_send, resp_arg)) {
-    ESP_LOGE(WS_TAG, "Could not queue message");
-    free(resp_arg->data);
-    free(resp_arg);
+// Handles subscribe/unsubscribe for the session; returns false for any other message
+static bool ws_handle_subscription(ws_frag_ctx_t *ctx, const char *payload, size_t len) {
+  if (!ctx || !strstr(payload, "subscribe")) return false;
+
+  cJSON *root = cJSON_ParseWithLength(payload, len);
+  if (!root) return false;
+  const cJSON *event = cJSON_GetObjectItem(root, "event");
+  bool subscribe = cJSON_IsString(event) && strcmp(event->valuestring, "subscribe") == 0;
+  bool unsubscribe = cJSON_IsString(event) && strcmp(event->valuestring, "unsubscribe") == 0;
+  if (!subscribe && !unsubscribe) {
+    cJSON_Delete(root);
+    return false;
+  }
+
+  uint32_t mask = 0;
+  const cJSON *topic;
+  cJSON_ArrayForEach(topic, cJSON_GetObjectItem(root, "topics")) {
+    if (!cJSON_IsString(topic)) continue;
+    uint32_t bits = ws_topic_lookup(topic->valuestring);
+    if (!bits) ESP_LOGD(WS_TAG, "Unknown topic %s", topic->valuestring);
+    mask |= bits;
   }
+  cJSON_Delete(root);
+
+  if (subscribe) {
+    ctx->topics |= mask;
+    atomic_fetch_or(&ws_fanout.subscribed, mask);
+    atomic_store(&ws_fanout.dirty, true);
+  } else {
+    ctx->topics &= ~mask;
+  }
+  return true;
+}
+
+static void ws_dispatch(int sockfd, const char *payload, size_t len) {
+  ws_frag_ctx_t *ctx = (ws_frag_ctx_t *) httpd_sess_get_ctx(ws_server_handle, sockfd);
+  if (ws_handle_subscription(ctx, payload, len)) return;
+  ws_dispatch_sockfd = sockfd;
+  for (size_t i = 0; i < ws_subscriber_count; i++) {
+    if (ws_subscribers[i]) ws_subscribers[i](payload, len, ws_subscriber_ctx[i]);
+  }
+  ws_dispatch_sockfd = -1;
+}
+
+static void ws_handshake_broadcast_task(void *arg) {
+  (void) arg;
+  const uint32_t interval_ticks = (uint32_t) pdMS_TO_TICKS(WS_HANDSHAKE_INTERVAL_MS);
+
+  while (1) {
+    ws_broadcast(WS_TOPIC_ALL, "{\"event\":\"handshake\"}", NULL, 0);
+    vTaskDelay(interval_ticks);
+  }
+}
+
+void ws_register(httpd_handle_t server) {
+  ws_pool_init();
+  ws_server_handle = server;
+  // A flush queued on a previous server instance never ran, and its sessions are gone
+  atomic_store(&ws_fanout.flush_queued, false);
+  ws_client_count = 0;
+  static bool tasks_started = false;
+  if (!tasks_started) {
+    ws_fanout.lock = xSemaphoreCreateMutex();
+    if (!ws_fanout.lock) {
+      ESP_LOGE(WS_TAG, "Could not create fan-out lock");
+    } else {
+      tasks_started = true;
+      xTaskCreate(ws_frame_task, "ws_frame", WS_FRAME_TASK_STACK, NULL, 5, NULL);
+      xTaskCreate(ws_handshake_broadcast_task, "ws_handshake_broadcast",
+                  WS_HANDSHAKE_TASK_STACK, NULL, 5, NULL);
+    }
+  }
+  ESP_ERROR_CHECK(
+    httpd_register_uri_handler(server, &(httpd_uri_t) {.uri = "/ws",
+                                                        .method = HTTP_GET,
+                                                        .handler = ws_handler,
+                                                        .user_ctx = NULL,
+                                                        .is_websocket = true,
+                                                        .supported_subprotocol =
+                                                          WS_SUBPROTOCOL_BINARY}));
+}
+
+/**
+ * The session that sent the message being handled, for use inside a message subscriber; -1
+ * elsewhere.
+ */
+int ws_current_session(void) { return ws_dispatch_sockfd; }
+
+bool ws_subscribe_message(ws_message_callback_t cb, void *ctx) {
+  if (!cb || ws_subscriber_count >= WS_MAX_SUBSCRIBERS) return false;
+  ws_subscribers[ws_subscriber_count] = cb;
+  ws_subscriber_ctx[ws_subscriber_count] = ctx;
+  ws_subscriber_count++;
+  return true;
 }
 
 static void ws_force_close(httpd_req_t *req, const char *why, esp_err_t err) {
@@ -161,6 +675,17 @@ static ws_frag_ctx_t *ws_get_frag_ctx(int sockfd) {
   return ctx;
 }
 
+/*
+ * True when httpd accepted subprotocol in the handshake. httpd echoes its supported_subprotocol
+ * only when the whole Sec-WebSocket-Protocol header equals it (read into 49 bytes), not when it
+ * is one of several offers, so the same comparison decides whether the client gets binary frames.
+ */
+static bool ws_negotiated_subprotocol(httpd_req_t *req, const char *subprotocol) {
+  char offered[50] = {0};
+  httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Protocol", offered, sizeof(offered) - 1);
+  return offered[0] && strncmp(offered, subprotocol, sizeof(offered)) == 0;
+}
+
 static void ws_clear_frag_ctx(int sockfd) {
   if (!ws_server_handle) return;
   ws_frag_ctx_t *ctx = (ws_frag_ctx_t *) httpd_sess_get_ctx(ws_server_handle, sockfd);
@@ -187,6 +712,14 @@ esp_err_t ws_handler(httpd_req_t *req) {
     if (up_len > 0 && up_len < sizeof(upgrade) &&
         httpd_req_get_hdr_value_str(req, "Upgrade", upgrade, sizeof(upgrade)) == ESP_OK &&
         strcasecmp(upgrade, "websocket") == 0) {
+      ws_frag_ctx_t *ctx = ws_get_frag_ctx(sockfd);
+      if (!ctx) return ESP_ERR_NO_MEM;
+      if (!ws_client_add(sockfd, ctx)) {
+        ESP_LOGW(WS_TAG, "Too many ws clients; refusing fd=%d", sockfd);
+        return ESP_FAIL;
+      }
+      ctx->binary = ws_negotiated_subprotocol(req, WS_SUBPROTOCOL_BINARY);
+      ws_fanout_attach(ctx);
       return ESP_OK;
     }
 
@@ -258,11 +791,7 @@ esp_err_t ws_handler(httpd_req_t *req) {
       ctx->buf[ctx->len] = '\0';
 
       if (ws_pkt.final) {
-        for (size_t i = 0; i < ws_subscriber_count; i++) {
-          if (ws_subscribers[i]) {
-            ws_subscribers[i]((const char *) ctx->buf, ctx->len, ws_subscriber_ctx[i]);
-          }
-        }
+        ws_dispatch(sockfd, (const char *) ctx->buf, ctx->len);
         ws_clear_frag_ctx(sockfd);
       }
 
@@ -291,13 +820,7 @@ esp_err_t ws_handler(httpd_req_t *req) {
         }
         break;
       }
-      if (ws_pkt.len > 0) {
-        for (size_t i = 0; i < ws_subscriber_count; i++) {
-          if (ws_subscribers[i]) {
-            ws_subscribers[i]((const char *) ws_pkt.payload, ws_pkt.len, ws_subscriber_ctx[i]);
-          }
-        }
-      }
+      if (ws_pkt.len > 0) ws_dispatch(sockfd, (const char *) ws_pkt.payload, ws_pkt.len);
       break;
     }
     case HTTPD_WS_TYPE_PING: {
@@ -318,6 +841,8 @@ esp_err_t ws_handler(httpd_req_t *req) {
       break;
     }
     case HTTPD_WS_TYPE_BINARY:
+      // Binary is server-to-client only; commands stay JSON on either subprotocol
+      ESP_LOGD(WS_TAG, "Ignoring binary frame len=%u fd=%d", (unsigned) ws_pkt.len, sockfd);
       break;
     default:
       ESP_LOGW(WS_TAG, "Unhandled ws frame type=%d len=%u fd=%d", (int) ws_pkt.type,
@@ -146,6 +146,34 @@ static cJSON *httpd_read_json_body(httpd_req_t *req) {
   return json;
 }
 
+// Compares entity tags the weak way, as If-None-Match requires: a W/ prefix on either is ignored
+static bool httpd_req_etag_matches(httpd_req_t *req, const char *etag) {
+  if (!etag || !etag[0]) return false;
+  if (strncmp(etag, "W/", 2) == 0) etag += 2;
+  size_t etag_len = strlen(etag);
+
+  char if_none_match[256];
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) !=
+      ESP_OK) {
+    return false;
+  }
+
+  const char *p = if_none_match;
+  while (*p) {
+    while (*p == ' ' || *p == ',') p++;
+    size_t len = strcspn(p, " ,");
+    if (len == 1 && *p == '*') return true;
+    const char *tag = p;
+    if (len > 2 && strncmp(tag, "W/", 2) == 0) {
+      tag += 2;
+      len -= 2;
+    }
+    if (len == etag_len && strncmp(tag, etag, len) == 0) return true;
+    p = tag + len;
+  }
+  return false;
+}
+
 static esp_err_t read_file_to_buf(const char *path, char **out, size_t *len) {
   if (!out) return ESP_ERR_INVALID_ARG;
   FILE *file = fopen(path, "rb");
@@ -0,0 +1,279 @@
+#ifndef WORKOUT_H
+#define WORKOUT_H
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "rep_counter.h"
+#include "store/stats_store.h"
+#include "store/workout_log.h"
+
+/*
+ * Set and session detection from the reported reps. The first rep opens a session and a set;
+ * a set ends after WORKOUT_SET_IDLE_US without reps or when the exercise or user changes, and a
+ * session ends after WORKOUT_SESSION_IDLE_US without a set. Every transition and every rep is
+ * appended to the workout log, and reps and sets are folded into the active user's statistics.
+ * Timeouts run on the monotonic clock, record times on the wall clock, which the frontend sets
+ * on connect (see ws_workout.h).
+ */
+
+#define WORKOUT_TAG "WORKOUT"
+#define WORKOUT_SET_IDLE_US (30LL * 1000000)
+#define WORKOUT_SESSION_IDLE_US (20LL * 60 * 1000000)
+#define WORKOUT_TICK_MS 1000
+#define WORKOUT_TASK_STACK 3072
+
+typedef enum {
+  WORKOUT_IDLE,    // no session
+  WORKOUT_RESTING, // session open, between sets
+  WORKOUT_IN_SET,
+} workout_phase_t;
+
+typedef struct {
+  SemaphoreHandle_t lock;
+  workout_phase_t phase;
+  char exercise[WORKOUT_EXERCISE_NAME_LEN];
+  char user[STATS_USER_NAME_LEN + 1];
+  int user_owner; // session that selected the user; only it may change the user mid-set
+
+  uint16_t session;
+  int64_t session_start_us;
+  uint16_t sets; // in the current session
+
+  int64_t set_start_us;
+  int64_t last_rep_us;
+  int64_t last_set_end_us;
+  uint16_t reps;
+  q16_t best_mpv;
+  q16_t max_velocity_loss;
+
+  rep_counter_t *rep_counter; // told when a set ends, for its velocity-loss baseline
+} workout_t;
+
+static workout_t workout = {0};
+
+static inline int64_t workout_wall_ms(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static inline uint32_t workout_elapsed_ms(int64_t from_us, int64_t to_us) {
+  return to_us > from_us ? (uint32_t) ((to_us - from_us) / 1000) : 0;
+}
+
+static inline int16_t workout_tenths(q16_t value) {
+  int64_t tenths = ((int64_t) value * 10) >> Q16_SHIFT;
+  if (tenths > INT16_MAX) return INT16_MAX;
+  if (tenths < INT16_MIN) return INT16_MIN;
+  return (int16_t) tenths;
+}
+
+static inline uint16_t workout_u16(uint32_t value) {
+  return value > UINT16_MAX ? UINT16_MAX : (uint16_t) value;
+}
+
+// Header common to every record. Called with the lock held.
+static workout_record_t workout_record(workout_record_type_t type) {
+  workout_record_t record = {0};
+  record.type = (uint8_t) type;
+  record.side = WORKOUT_SIDE_NONE;
+  record.time_ms = workout_wall_ms();
+  if (record.time_ms >= WORKOUT_CLOCK_VALID_MS) record.flags |= WORKOUT_RECORD_FLAG_CLOCK_SYNCED;
+  record.session = workout.session;
+  record.set = type == WORKOUT_RECORD_SESSION_START || type == WORKOUT_RECORD_SESSION_END
+                 ? 0
+                 : workout.sets;
+  memcpy(record.exercise, workout.exercise, sizeof(record.exercise));
+  return record;
+}
+
+static void workout_end_set(int64_t now_us) {
+  workout_record_t record = workout_record(WORKOUT_RECORD_SET_END);
+  record.summary.reps = workout.reps;
+  record.summary.duration_ms = workout_elapsed_ms(workout.set_start_us, workout.last_rep_us);
+  record.summary.best_mpv = workout.best_mpv;
+  record.summary.max_velocity_loss = workout.max_velocity_loss;
+  workout_log_append(&record);
+  stats_store_add_set(workout.user, &record);
+  // A finished set is worth a write of its own
+  workout_log_flush();
+
+  ESP_LOGI(WORKOUT_TAG, "Set %u of session %u done: %u reps", (unsigned) workout.sets,
+           (unsigned) workout.session, (unsigned) workout.reps);
+  rep_counter_new_set(workout.rep_counter);
+  workout.phase = WORKOUT_RESTING;
+  workout.last_set_end_us = now_us;
+}
+
+static void workout_end_session(int64_t now_us) {
+  workout_record_t record = workout_record(WORKOUT_RECORD_SESSION_END);
+  record.summary.reps = workout.sets;
+  record.summary.duration_ms = workout_elapsed_ms(workout.session_start_us, now_us);
+  workout_log_append(&record);
+  workout_log_flush();
+
+  ESP_LOGI(WORKOUT_TAG, "Session %u done: %u sets", (unsigned) workout.session,
+           (unsigned) workout.sets);
+  workout.phase = WORKOUT_IDLE;
+}
+
+static void workout_begin_set(int64_t now_us) {
+  if (workout.phase == WORKOUT_IDLE) {
+    workout.session++;
+    workout.sets = 0;
+    workout.session_start_us = now_us;
+    workout_record_t record = workout_record(WORKOUT_RECORD_SESSION_START);
+    workout_log_append(&record);
+  }
+
+  workout.sets++;
+  workout.phase = WORKOUT_IN_SET;
+  workout.set_start_us = now_us;
+  workout.reps = 0;
+  workout.best_mpv = 0;
+  workout.max_velocity_loss = 0;
+  workout_record_t record = workout_record(WORKOUT_RECORD_SET_START);
+  workout_log_append(&record);
+}
+
+/**
+ * Records a reported rep, opening a session and a set as needed.
+ */
+void workout_on_rep(const rep_record_t *rep) {
+  if (!workout.lock || !rep) return;
+  int64_t now_us = esp_timer_get_time();
+
+  xSemaphoreTake(workout.lock, portMAX_DELAY);
+  if (workout.phase != WORKOUT_IN_SET) workout_begin_set(now_us);
+
+  workout.reps++;
+  workout.last_rep_us = now_us;
+  if (rep->mean_propulsive_velocity > workout.best_mpv) {
+    workout.best_mpv = rep->mean_propulsive_velocity;
+  }
+  if (rep->velocity_loss > workout.max_velocity_loss) {
+    workout.max_velocity_loss = rep->velocity_loss;
+  }
+
+  workout_record_t record = workout_record(WORKOUT_RECORD_REP);
+  record.side = rep->fused ? WORKOUT_SIDE_BOTH : (uint8_t) rep->side;
+  if (rep->stop_set) record.flags |= WORKOUT_RECORD_FLAG_STOP_SET;
+  if (rep->bilateral) record.flags |= WORKOUT_RECORD_FLAG_BILATERAL;
+  record.rep.rom = rep->rom;
+  record.rep.peak_velocity = rep->peak_velocity;
+  record.rep.mean_propulsive_velocity = rep->mean_propulsive_velocity;
+  record.rep.velocity_loss = rep->velocity_loss;
+  record.rep.concentric_ms = workout_u16(rep->concentric_ms);
+  record.rep.eccentric_ms = workout_u16(rep->eccentric_ms);
+  record.rep.rom_asymmetry = workout_tenths(rep->rom_asymmetry);
+  record.rep.velocity_asymmetry = workout_tenths(rep->velocity_asymmetry);
+  workout_log_append(&record);
+  stats_store_add_rep(workout.user, &record);
+  xSemaphoreGive(workout.lock);
+}
+
+/**
+ * Sets the exercise that following reps belong to. A change ends the running set.
+ */
+void workout_set_exercise(const char *name) {
+  if (!workout.lock || !name) return;
+
+  char exercise[WORKOUT_EXERCISE_NAME_LEN] = {0};
+  strncpy(exercise, name, sizeof(exercise));
+
+  xSemaphoreTake(workout.lock, portMAX_DELAY);
+  if (memcmp(exercise, workout.exercise, sizeof(exercise)) != 0) {
+    if (workout.phase == WORKOUT_IN_SET) workout_end_set(esp_timer_get_time());
+    rep_counter_new_set(workout.rep_counter);
+    memcpy(workout.exercise, exercise, sizeof(exercise));
+  }
+  xSemaphoreGive(workout.lock);
+}
+
+/**
+ * Sets the user that following reps are credited to; empty for none. session identifies the
+ * client asking. While a set is running only the client that selected the current user may
+ * change it, which ends the set; other clients (e.g. a second display connecting) are ignored.
+ */
+void workout_set_user(const char *name, int session) {
+  if (!workout.lock || !name) return;
+
+  char user[STATS_USER_NAME_LEN + 1] = {0};
+  strncpy(user, name, STATS_USER_NAME_LEN);
+
+  xSemaphoreTake(workout.lock, portMAX_DELAY);
+  if (workout.phase == WORKOUT_IN_SET && session != workout.user_owner) {
+    if (strcmp(user, workout.user) != 0) {
+      ESP_LOGW(WORKOUT_TAG, "Ignoring user change from another client during a set");
+    }
+    xSemaphoreGive(workout.lock);
+    return;
+  }
+
+  if (strcmp(user, workout.user) != 0) {
+    if (workout.phase == WORKOUT_IN_SET) workout_end_set(esp_timer_get_time());
+    rep_counter_new_set(workout.rep_counter);
+    memcpy(workout.user, user, sizeof(user));
+  }
+  workout.user_owner = session;
+  xSemaphoreGive(workout.lock);
+}
+
+static void workout_tick(void) {
+  int64_t now_us = esp_timer_get_time();
+
+  xSemaphoreTake(workout.lock, portMAX_DELAY);
+  if (workout.phase == WORKOUT_IN_SET && now_us - workout.last_rep_us >= WORKOUT_SET_IDLE_US) {
+    workout_end_set(now_us);
+  }
+  if (workout.phase == WORKOUT_RESTING &&
+      now_us - workout.last_set_end_us >= WORKOUT_SESSION_IDLE_US) {
+    workout_end_session(now_us);
+  }
+  xSemaphoreGive(workout.lock);
+}
+
+static void workout_task(void *arg) {
+  (void) arg;
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(WORKOUT_TICK_MS));
+    workout_tick();
+  }
+}
+
+/**
+ * Opens the workout log and statistics and starts the timeout task. Session numbers continue
+ * from the log. rep_counter, if given, starts a new set whenever one ends here.
+ */
+esp_err_t workout_start(rep_counter_t *rep_counter) {
+  if (workout.lock) return ESP_OK;
+  workout.rep_counter = rep_counter;
+  workout.user_owner = -1;
+
+  esp_err_t err = workout_log_init();
+  if (err != ESP_OK) return err;
+  err = stats_store_init();
+  if (err != ESP_OK) return err;
+
+  workout.lock = xSemaphoreCreateMutex();
+  if (!workout.lock) return ESP_ERR_NO_MEM;
+
+  workout_record_t last;
+  if (workout_log_last(&last)) workout.session = last.session;
+
+  if (xTaskCreate(workout_task, "workout", WORKOUT_TASK_STACK, NULL, tskIDLE_PRIORITY + 1, NULL) !=
+      pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Host benchmarks for the firmware's hot paths. Each one compiles the real backend headers
+ * against the IDF shim in shim/, so results show relative cost and allocation behaviour on the
+ * host, not device timings. Like the firmware's main.c, the harness is one translation unit:
+ * each bench_*.h includes the backend headers it runs and bench_main.c includes them all.
+ */
+
+typedef struct {
+  const char *name;
+  const char *summary;
+  void (*run)(void);
+} bench_t;
+
+static inline int64_t bench_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Small deterministic generator, so every mode of a benchmark sees the same workload
+static inline uint32_t bench_random(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef BENCH_ASSETS_H
+#define BENCH_ASSETS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "routes/web/asset_pack.h"
+#include "routes/web/http_fileserver.h"
+#include "shim.h"
+
+/*
+ * Serving the web app through path_handler() in its three modes, on the same files:
+ * - "stat": a filesystem without the build manifest, so every request stat()s each variant;
+ * - "manifest": the manifest loaded at startup, so only the body read touches the filesystem;
+ * - "pack": the memory-mapped asset pack built the way frontend/scripts/pack-assets.mjs does.
+ * A page load asks for every asset as a browser would (Accept-Encoding: gzip, deflate, br); a
+ * revalidation asks again with the ETag it was given, expecting 304s. The files live in a
+ * temporary directory on the host filesystem, which serves them out of the page cache: LittleFS
+ * on SPI flash is far slower per call, so the host understates what the pack saves.
+ */
+
+#define ASSETS_LOADS 2000
+#define ASSETS_REVALIDATIONS 20000
+#define ASSETS_SEED 0x9E3779B9
+#define ASSETS_MAX_IMAGE (2 * 1024 * 1024)
+
+// A typical production build, with the variants frontend/vite.config.ts writes for each file
+typedef struct {
+  const char *path;
+  size_t size;
+  uint8_t variants; // VARIANT_BIT of each file present
+} bench_asset_t;
+
+#define ASSETS_ALL (VARIANT_BIT(ASSET_PACK_IDENTITY) | VARIANT_COMPRESSED_MASK)
+#define ASSETS_BUNDLE (VARIANT_BIT(ASSET_PACK_IDENTITY) | VARIANT_BIT(ASSET_PACK_GZIP))
+#define ASSETS_PLAIN VARIANT_BIT(ASSET_PACK_IDENTITY)
+
+static const bench_asset_t bench_assets_files[] = {
+  {"/assets/index-3f9a1c2e.js", 262144, ASSETS_BUNDLE},
+  {"/assets/index-c81e5b07.css", 24576, ASSETS_BUNDLE},
+  {"/assets/vendor-7b41d0aa.js", 131072, ASSETS_BUNDLE},
+  {"/favicon.ico", 4286, ASSETS_PLAIN},
+  {"/icons/icon-192.png", 9800, ASSETS_PLAIN},
+  {"/icons/icon-512.png", 31000, ASSETS_PLAIN},
+  {"/index.html", 1800, ASSETS_ALL},
+  {"/manifest.webmanifest", 512, ASSETS_ALL},
+};
+
+static const char *const bench_assets_dirs[] = {"/assets", "/icons"};
+
+#define ASSETS_COUNT (sizeof(bench_assets_files) / sizeof(bench_assets_files[0]))
+
+// Rough compression ratios; only the sizes matter to the server
+static size_t bench_assets_size(const bench_asset_t *asset, size_t variant) {
+  static const size_t percent[ASSET_PACK_VARIANTS] = {100, 30, 26};
+  return asset->size * percent[variant] / 100;
+}
+
+static uint64_t bench_assets_hash(size_t asset, size_t variant) {
+  uint32_t state = ASSETS_SEED + (uint32_t) (asset * ASSET_PACK_VARIANTS + variant);
+  return (uint64_t) bench_random(&state) << 32 | bench_random(&state);
+}
+
+static void bench_assets_fill(uint8_t *body, size_t len, size_t asset, size_t variant) {
+  uint32_t state = ASSETS_SEED ^ (uint32_t) (asset * ASSET_PACK_VARIANTS + variant + 1);
+  for (size_t i = 0; i < len; i++) body[i] = (uint8_t) bench_random(&state);
+}
+
+// The variant select_variant() picks for a browser that accepts everything
+static size_t bench_assets_preferred(const bench_asset_t *asset) {
+  if (asset->variants & VARIANT_BIT(ASSET_PACK_BR)) return ASSET_PACK_BR;
+  if (asset->variants & VARIANT_BIT(ASSET_PACK_GZIP)) return ASSET_PACK_GZIP;
+  return ASSET_PACK_IDENTITY;
+}
+
+// Writes every variant and the build manifest under dir
+static bool bench_assets_write_files(const char *dir) {
+  char path[256];
+  for (size_t i = 0; i < sizeof(bench_assets_dirs) / sizeof(bench_assets_dirs[0]); i++) {
+    snprintf(path, sizeof(path), "%s%s", dir, bench_assets_dirs[i]);
+    if (mkdir(path, 0700) != 0) return false;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", dir, STATIC_MANIFEST_NAME);
+  FILE *manifest = fopen(path, "w");
+  if (!manifest) return false;
+
+  bool ok = true;
+  for (size_t i = 0; i < ASSETS_COUNT && ok; i++) {
+    const bench_asset_t *asset = &bench_assets_files[i];
+    for (size_t v = 0; v < ASSET_PACK_VARIANTS && ok; v++) {
+      if (!(asset->variants & VARIANT_BIT(v))) continue;
+      size_t len = bench_assets_size(asset, v);
+      uint8_t *body = malloc(len);
+      snprintf(path, sizeof(path), "%s%s%s", dir, asset->path, variant_suffixes[v]);
+      FILE *file = body ? fopen(path, "wb") : NULL;
+      if (file) {
+        bench_assets_fill(body, len, i, v);
+        ok = fwrite(body, 1, len, file) == len;
+        ok = fclose(file) == 0 && ok;
+      } else {
+        ok = false;
+      }
+      free(body);
+      fprintf(manifest, "%016llx %s%s\n", (unsigned long long) bench_assets_hash(i, v),
+              asset->path, variant_suffixes[v]);
+    }
+  }
+  return fclose(manifest) == 0 && ok;
+}
+
+static void bench_assets_remove_files(const char *dir) {
+  char path[256];
+  for (size_t i = 0; i < ASSETS_COUNT; i++) {
+    for (size_t v = 0; v < ASSET_PACK_VARIANTS; v++) {
+      snprintf(path, sizeof(path), "%s%s%s", dir, bench_assets_files[i].path,
+               variant_suffixes[v]);
+      remove(path);
+    }
+  }
+  snprintf(path, sizeof(path), "%s/%s", dir, STATIC_MANIFEST_NAME);
+  remove(path);
+  for (size_t i = 0; i < sizeof(bench_assets_dirs) / sizeof(bench_assets_dirs[0]); i++) {
+    snprintf(path, sizeof(path), "%s%s", dir, bench_assets_dirs[i]);
+    rmdir(path);
+  }
+  rmdir(dir);
+}
+
+static size_t bench_assets_align(size_t n) { return (n + 3) & ~(size_t) 3; }
+
+static uint32_t bench_assets_add_string(uint8_t *image, size_t *at, const char *value) {
+  size_t offset = *at;
+  strcpy((char *) image + offset, value);
+  *at += strlen(value) + 1;
+  return (uint32_t) offset;
+}
+
+// Lays out the pack as pack-assets.mjs does. The files are sorted by path already.
+static size_t bench_assets_build_pack(uint8_t *image, size_t max) {
+  size_t strings = sizeof(asset_pack_header_t) + ASSETS_COUNT * sizeof(asset_pack_entry_t);
+  size_t strings_size = 0;
+  char etags[ASSETS_COUNT][ASSET_PACK_VARIANTS][STATIC_ETAG_LEN];
+  for (size_t i = 0; i < ASSETS_COUNT; i++) {
+    const bench_asset_t *asset = &bench_assets_files[i];
+    strings_size += strlen(asset->path) + 1;
+    strings_size += strlen(mime_type_for(asset->path, strlen(asset->path))) + 1;
+    for (size_t v = 0; v < ASSET_PACK_VARIANTS; v++) {
+      snprintf(etags[i][v], STATIC_ETAG_LEN, "\"%016llx\"",
+               (unsigned long long) bench_assets_hash(i, v));
+      if (asset->variants & VARIANT_BIT(v)) strings_size += strlen(etags[i][v]) + 1;
+    }
+  }
+
+  size_t data = bench_assets_align(strings + strings_size);
+  size_t size = data;
+  for (size_t i = 0; i < ASSETS_COUNT; i++) {
+    for (size_t v = 0; v < ASSET_PACK_VARIANTS; v++) {
+      if (bench_assets_files[i].variants & VARIANT_BIT(v)) {
+        size = bench_assets_align(size + bench_assets_size(&bench_assets_files[i], v));
+      }
+    }
+  }
+  if (size > max) return 0;
+  memset(image, 0, size);
+
+  asset_pack_header_t *header = (asset_pack_header_t *) image;
+  *header = (asset_pack_header_t) {.magic = ASSET_PACK_MAGIC,
+                                   .version = ASSET_PACK_VERSION,
+                                   .count = (uint16_t) ASSETS_COUNT,
+                                   .entries = sizeof(asset_pack_header_t),
+                                   .strings = (uint32_t) strings,
+                                   .data = (uint32_t) data,
+                                   .size = (uint32_t) size};
+
+  asset_pack_entry_t *entries = (asset_pack_entry_t *) (image + header->entries);
+  size_t string_at = strings;
+  size_t data_at = data;
+  for (size_t i = 0; i < ASSETS_COUNT; i++) {
+    const bench_asset_t *asset = &bench_assets_files[i];
+    const char *content_type = mime_type_for(asset->path, strlen(asset->path));
+    entries[i].path = bench_assets_add_string(image, &string_at, asset->path);
+    entries[i].content_type = bench_assets_add_string(image, &string_at, content_type);
+    for (size_t v = 0; v < ASSET_PACK_VARIANTS; v++) {
+      if (!(asset->variants & VARIANT_BIT(v))) continue;
+      size_t len = bench_assets_size(asset, v);
+      entries[i].variants[v] =
+        (asset_pack_blob_t) {.offset = (uint32_t) data_at,
+                             .length = (uint32_t) len,
+                             .etag = bench_assets_add_string(image, &string_at, etags[i][v])};
+      bench_assets_fill(image + data_at, len, i, v);
+      data_at = bench_assets_align(data_at + len);
+    }
+  }
+  return size;
+}
+
+// The ETag path_handler() answers with for the asset's preferred variant in the current mode
+static void bench_assets_etag(const char *dir, size_t asset, char *out, size_t out_len) {
+  size_t variant = bench_assets_preferred(&bench_assets_files[asset]);
+  if (asset_pack_ready() || static_assets) {
+    snprintf(out, out_len, "\"%016llx\"", (unsigned long long) bench_assets_hash(asset, variant));
+    return;
+  }
+  char path[256];
+  struct stat st = {0};
+  snprintf(path, sizeof(path), "%s%s%s", dir, bench_assets_files[asset].path,
+           variant_suffixes[variant]);
+  stat(path, &st);
+  snprintf(out, out_len, "W/\"%lx-%lx\"", (unsigned long) st.st_mtime,
+           (unsigned long) st.st_size);
+}
+
+static void bench_assets_request(char *dir, const char *path) {
+  httpd_req_t req = {.method = HTTP_GET, .user_ctx = dir};
+  snprintf((char *) req.uri, sizeof(req.uri), "%s", path);
+  path_handler(&req);
+}
+
+static void bench_assets_run(const char *mode, char *dir) {
+  const char *load_headers[] = {"Accept-Encoding", "gzip, deflate, br", NULL};
+  shim_http_set_headers(load_headers);
+  shim_http_stats = (shim_http_stats_t) {0};
+
+  int64_t started = bench_now_ns();
+  for (int load = 0; load < ASSETS_LOADS; load++) {
+    for (size_t i = 0; i < ASSETS_COUNT; i++) bench_assets_request(dir, bench_assets_files[i].path);
+  }
+  int64_t load_ns = bench_now_ns() - started;
+  double page_bytes = (double) shim_http_stats.bytes / ASSETS_LOADS;
+
+  // One ETag per asset, as a browser would have cached them
+  char etags[ASSETS_COUNT][64];
+  for (size_t i = 0; i < ASSETS_COUNT; i++) bench_assets_etag(dir, i, etags[i], sizeof(etags[i]));
+  const char *headers[] = {"Accept-Encoding", "gzip, deflate, br", "If-None-Match", NULL, NULL};
+  uint64_t bytes_before = shim_http_stats.bytes;
+
+  started = bench_now_ns();
+  for (int load = 0; load < ASSETS_REVALIDATIONS; load++) {
+    for (size_t i = 0; i < ASSETS_COUNT; i++) {
+      headers[3] = etags[i];
+      shim_http_set_headers(headers);
+      bench_assets_request(dir, bench_assets_files[i].path);
+    }
+  }
+  int64_t revalidate_ns = bench_now_ns() - started;
+  shim_http_set_headers(NULL);
+
+  // A 304 writes nothing through the shim, so any bytes here mean a body went out
+  printf("%-8s page load %7.1f us (%4.0f KB)  revalidation %6.0f ns/request  %s\n", mode,
+         (double) load_ns / ASSETS_LOADS / 1000, page_bytes / 1024,
+         (double) revalidate_ns / (ASSETS_REVALIDATIONS * ASSETS_COUNT),
+         shim_http_stats.errors || shim_http_stats.bytes != bytes_before ? "UNEXPECTED RESPONSES"
+                                                                           : "ok");
+}
+
+static void bench_assets(void) {
+  char dir[] = "/tmp/esp-lift-assets-XXXXXX";
+  uint8_t *image = malloc(ASSETS_MAX_IMAGE);
+  if (!image || !mkdtemp(dir)) {
+    free(image);
+    fprintf(stderr, "Could not set up the asset benchmark\n");
+    return;
+  }
+
+  size_t image_size = bench_assets_build_pack(image, ASSETS_MAX_IMAGE);
+  if (!bench_assets_write_files(dir) || image_size == 0) {
+    fprintf(stderr, "Could not write the benchmark assets\n");
+    goto cleanup;
+  }
+
+  // path_handler() prefers the pack, then the manifest, so the modes run in that order
+  bench_assets_run("stat", dir);
+  static_manifest_load(dir);
+  bench_assets_run("manifest", dir);
+  shim_partition_set("www", image, image_size);
+  if (asset_pack_open("www") != ESP_OK) {
+    fprintf(stderr, "Could not open the benchmark asset pack\n");
+    goto cleanup;
+  }
+  bench_assets_run("pack", dir);
+
+cleanup:
+  bench_assets_remove_files(dir);
+  free(image);
+}
+
+#endif
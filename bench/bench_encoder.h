@@ -0,0 +1,119 @@
+#ifndef BENCH_ENCODER_H
+#define BENCH_ENCODER_H
+
+#include <string.h>
+
+#include "bench.h"
+#include "encoder.h"
+
+/*
+ * Per-edge encoder cost, before and after the calibrated position moved to Q16.16 and out of
+ * interrupt context. "isr before" is the work the baseline rotation handler did on every edge:
+ * the count, the calibration step and the calibrated position as a double divide and multiply
+ * (its queue send is left out). "isr after" is encoder_push_sample_from_isr(), which is all an
+ * edge costs in interrupt context now, and "service after" is the same per-edge work as before,
+ * encoder_advance() in Q16.16, which the service task now runs per sample. The push is mostly
+ * its timestamp, so "timestamp" times esp_timer_get_time() alone: a clock_gettime() on the host,
+ * a read of the timer peripheral on the device.
+ *
+ * The host has hardware doubles; the ESP32's FPU is single precision, so on the device each
+ * double operation is a soft-float library call, and an ISR that touches the FPU at all has to
+ * save its context first. Neither shows here and the host has no soft-float library to call
+ * instead, so "isr before" is a lower bound and its gap to "service after" is not the device's:
+ * on the host Q16.16 can even come out slower. The output says so.
+ */
+
+#define ENCODER_EDGES 4000000
+#define ENCODER_STROKE 2000 // edges per half rep
+#define ENCODER_BLOCK 128   // edges timed together, then drained outside the timing
+
+static volatile double bench_encoder_double_sink;
+
+// The baseline encoder_update_calibrated()
+static inline void bench_encoder_update_double(encoder_t *enc) {
+  if (enc->state.cal_state != CAL_DONE || enc->state.max_distance <= 0) {
+    bench_encoder_double_sink = 0.0;
+    return;
+  }
+  int32_t dist = enc->state.raw_count + enc->state.offset - enc->state.start_count;
+  if (enc->state.cal_dir == DIR_NEGATIVE) dist = -dist;
+  double norm = (double) dist / (double) enc->state.max_distance;
+  bench_encoder_double_sink = 0.0 + norm * (100.0 - 0.0);
+}
+
+// The baseline rotation handler's work for one edge
+static inline void bench_encoder_isr_before(encoder_t *enc, int32_t step) {
+  enc->state.raw_count += step;
+  encoder_calibration_step(enc, step);
+  bench_encoder_update_double(enc);
+}
+
+// Up and down strokes of a rep, one edge at a time
+static inline int32_t bench_encoder_step(uint32_t edge) {
+  return (edge / ENCODER_STROKE) & 1 ? -1 : 1;
+}
+
+// A calibrated encoder, as after the first rep
+static void bench_encoder_init(encoder_t *enc) {
+  memset(enc, 0, sizeof(*enc));
+  enc->config.calibration_debounce_steps = 8;
+  enc->config.resolution = ENCODER_RESOLUTION_4X;
+  enc->state.resolution = ENCODER_RESOLUTION_4X;
+  for (uint32_t edge = 0; enc->state.cal_state != CAL_DONE; edge++) {
+    encoder_advance(enc, bench_encoder_step(edge));
+  }
+}
+
+typedef enum {
+  ENCODER_MODE_ISR_BEFORE,
+  ENCODER_MODE_ISR_AFTER,
+  ENCODER_MODE_SERVICE_AFTER,
+  ENCODER_MODE_TIMESTAMP,
+} encoder_mode_t;
+
+static void bench_encoder_run(encoder_mode_t mode, const char *name) {
+  static encoder_t enc;
+  encoder_sample_t drained[ENCODER_BLOCK];
+  bench_encoder_init(&enc);
+  int32_t count = enc.state.raw_count;
+
+  int64_t elapsed_ns = 0;
+  for (uint32_t edge = 0; edge < ENCODER_EDGES; edge += ENCODER_BLOCK) {
+    int64_t started = bench_now_ns();
+    for (uint32_t i = edge; i < edge + ENCODER_BLOCK; i++) {
+      int32_t step = bench_encoder_step(i);
+      switch (mode) {
+      case ENCODER_MODE_ISR_BEFORE:
+        bench_encoder_isr_before(&enc, step);
+        break;
+      case ENCODER_MODE_ISR_AFTER:
+        count += step;
+        encoder_push_sample_from_isr(&enc, count);
+        break;
+      case ENCODER_MODE_SERVICE_AFTER:
+        encoder_advance(&enc, step);
+        break;
+      case ENCODER_MODE_TIMESTAMP:
+        count += (int32_t) esp_timer_get_time() & step;
+        break;
+      }
+    }
+    elapsed_ns += bench_now_ns() - started;
+    if (mode == ENCODER_MODE_ISR_AFTER) encoder_ring_pop_batch(&enc.ring, drained, ENCODER_BLOCK);
+  }
+
+  bench_encoder_double_sink = count;
+  printf("%-14s %5.1f ns/edge  overruns %u\n", name, (double) elapsed_ns / ENCODER_EDGES,
+         (unsigned) enc.ring.overruns);
+}
+
+static void bench_encoder(void) {
+  bench_encoder_run(ENCODER_MODE_ISR_BEFORE, "isr before");
+  bench_encoder_run(ENCODER_MODE_ISR_AFTER, "isr after");
+  bench_encoder_run(ENCODER_MODE_SERVICE_AFTER, "service after");
+  bench_encoder_run(ENCODER_MODE_TIMESTAMP, "timestamp");
+  printf("note: host doubles are hardware and no FPU context is saved, so the Q16.16 win on the\n"
+         "      ESP32 (no soft-float calls, no FPU in the ISR) does not show in these numbers\n");
+}
+
+#endif
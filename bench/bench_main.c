@@ -0,0 +1,32 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "bench_assets.h"
+#include "bench_encoder.h"
+#include "bench_ws.h"
+
+static const bench_t benchmarks[] = {
+  {"ws_pool", "long-run heap use of WS publishing, pool vs malloc per message", bench_ws_pool},
+  {"ws_fanout", "per-broadcast cost against connected WS clients", bench_ws_fanout},
+  {"encoder", "per-edge encoder work in and out of the ISR, double vs Q16.16", bench_encoder},
+  {"assets", "serving the web app from the asset pack vs the filesystem", bench_assets},
+};
+
+#define BENCH_COUNT (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+// Runs the benchmarks named on the command line, or all of them
+int main(int argc, char **argv) {
+  for (size_t i = 0; i < BENCH_COUNT; i++) {
+    bool wanted = argc < 2;
+    for (int arg = 1; arg < argc && !wanted; arg++) {
+      wanted = strcmp(argv[arg], benchmarks[i].name) == 0;
+    }
+    if (!wanted) continue;
+    printf("== %s: %s\n", benchmarks[i].name, benchmarks[i].summary);
+    benchmarks[i].run();
+    printf("\n");
+  }
+  return EXIT_SUCCESS;
+}
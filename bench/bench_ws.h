@@ -0,0 +1,231 @@
+#ifndef BENCH_WS_H
+#define BENCH_WS_H
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "shim.h"
+#include "transport/ws/ws_server.h"
+
+/*
+ * Websocket fan-out benchmarks, run on ws_server.h itself with httpd's send replaced by a copy
+ * (see shim.c). Sessions are added to the registry directly and the flush the frame task would
+ * queue is called once per simulated frame.
+ */
+
+#define BENCH_WS_FD_BASE 100
+
+static ws_frag_ctx_t bench_ws_ctx[WS_MAX_CLIENTS];
+
+// Brings the fan-out up without the httpd server and tasks, with clients sessions attached
+static void bench_ws_start(size_t clients) {
+  ws_pool_init();
+  if (!ws_fanout.lock) ws_fanout.lock = xSemaphoreCreateMutex();
+  ws_server_handle = (httpd_handle_t) &bench_ws_ctx;
+  ws_client_count = 0;
+  for (size_t i = 0; i < clients && i < WS_MAX_CLIENTS; i++) {
+    bench_ws_ctx[i] = (ws_frag_ctx_t) {.type = HTTPD_WS_TYPE_CONTINUE};
+    ws_client_add(BENCH_WS_FD_BASE + (int) i, &bench_ws_ctx[i]);
+    ws_fanout_attach(&bench_ws_ctx[i]);
+  }
+}
+
+static void bench_ws_stop(void) {
+  ws_flush(NULL);
+  ws_client_count = 0;
+  for (size_t slot = 0; slot < WS_LATEST_SLOTS; slot++) {
+    ws_msg_unref(ws_fanout.latest[slot]);
+    ws_fanout.latest[slot] = NULL;
+  }
+  ws_server_handle = NULL;
+}
+
+/*
+ * Long-run heap behaviour of the publish path. Each simulated frame (60 Hz on the device)
+ * publishes positions for both encoders a few times, every 30th frame broadcasts a rep-sized
+ * event, and then flushes to three clients. Alongside, the rest of the firmware is modelled as
+ * heap churn: blocks of 32 B to 2 KB held for up to 10 s, as HTTP handlers and cJSON trees do.
+ * "pool" runs ws_server.h; "malloc" is the path it replaced, one malloc plus strdup per message,
+ * freed once sent. Both see the same workload. The allocator is glibc's, not the device heap, so
+ * compare the trend and the heap calls rather than absolute fragmentation.
+ */
+
+#define POOL_FRAMES 1000000
+#define POOL_REPORT_EVERY 250000
+#define POOL_CLIENTS 3
+#define POOL_POSITIONS_PER_FRAME 4
+#define POOL_EVENT_EVERY 30
+#define POOL_CHURN_SLOTS 256
+#define POOL_CHURN_MAX_FRAMES 600
+#define POOL_LEGACY_MAX 64
+
+typedef enum { POOL_MODE_POOL, POOL_MODE_MALLOC } pool_mode_t;
+
+typedef struct {
+  void *block;
+  uint32_t expires;
+} churn_slot_t;
+
+// The per-message allocation ws_broadcast() made before the pool
+typedef struct {
+  char *data;
+  size_t len;
+} legacy_msg_t;
+
+static void pool_churn(churn_slot_t *slots, uint32_t frame, uint32_t *rng) {
+  for (int n = bench_random(rng) % 3; n > 0; n--) {
+    churn_slot_t *slot = &slots[bench_random(rng) % POOL_CHURN_SLOTS];
+    free(slot->block);
+    slot->block = malloc(32 + bench_random(rng) % 2016);
+    if (slot->block) memset(slot->block, 0xA5, 32);
+    slot->expires = frame + 1 + bench_random(rng) % POOL_CHURN_MAX_FRAMES;
+  }
+  for (size_t i = 0; i < POOL_CHURN_SLOTS; i++) {
+    if (slots[i].block && slots[i].expires == frame) {
+      free(slots[i].block);
+      slots[i].block = NULL;
+    }
+  }
+}
+
+// publish_ns covers publishing and flushing only, not the modelled churn
+static void pool_report(pool_mode_t mode, uint32_t frame, int64_t publish_ns, uint64_t heap_calls) {
+  struct mallinfo2 info = mallinfo2();
+  double free_share = info.arena ? 100.0 * (double) info.fordblks / (double) info.arena : 0;
+  printf("%-6s %8u frames  publish %5.0f ns/frame  heap calls %9llu  arena %4zu KB  "
+         "in use %4zu KB  free %4.1f %%\n",
+         mode == POOL_MODE_POOL ? "pool" : "malloc", (unsigned) frame,
+         (double) publish_ns / frame, (unsigned long long) heap_calls, info.arena / 1024,
+         info.uordblks / 1024, free_share);
+}
+
+static void pool_run(pool_mode_t mode) {
+  churn_slot_t churn[POOL_CHURN_SLOTS] = {0};
+  legacy_msg_t legacy[POOL_LEGACY_MAX];
+  size_t legacy_count = 0;
+  uint64_t heap_calls = 0;
+  uint32_t rng = 0x2545F491;
+  char text[WS_POOL_LARGE_SIZE];
+
+  if (mode == POOL_MODE_POOL) bench_ws_start(POOL_CLIENTS);
+  malloc_trim(0);
+
+  int64_t publish_ns = 0;
+  for (uint32_t frame = 1; frame <= POOL_FRAMES; frame++) {
+    pool_churn(churn, frame, &rng);
+    int64_t started = bench_now_ns();
+
+    for (int i = 0; i < 2 * POOL_POSITIONS_PER_FRAME; i++) {
+      snprintf(text, sizeof(text),
+               "{\"event\":\"position\",\"data\":{\"side\":%d,\"position\":%u.%02u,"
+               "\"velocity\":%d}}",
+               i & 1, (unsigned) (bench_random(&rng) % 100), (unsigned) (frame % 100),
+               (int) (bench_random(&rng) % 400) - 200);
+      if (mode == POOL_MODE_POOL) {
+        ws_publish_latest((size_t) (i & 1), text, NULL, 0);
+      } else if (legacy_count < POOL_LEGACY_MAX) {
+        legacy[legacy_count].data = strdup(text);
+        legacy[legacy_count].len = strlen(text);
+        legacy_count++;
+        heap_calls += 2; // the resp_arg_t and the strdup
+      }
+    }
+
+    if (frame % POOL_EVENT_EVERY == 0) {
+      int len = snprintf(text, sizeof(text), "{\"event\":\"rep\",\"data\":{\"frame\":%u",
+                         (unsigned) frame);
+      while (len < 360) len += snprintf(text + len, sizeof(text) - len, ",\"f%d\":%u", len,
+                                        (unsigned) bench_random(&rng) % 1000);
+      snprintf(text + len, sizeof(text) - len, "}}");
+      if (mode == POOL_MODE_POOL) {
+        ws_broadcast(WS_TOPIC_ALL, text, NULL, 0);
+      } else if (legacy_count < POOL_LEGACY_MAX) {
+        legacy[legacy_count].data = strdup(text);
+        legacy[legacy_count].len = strlen(text);
+        legacy_count++;
+        heap_calls += 2;
+      }
+    }
+
+    if (mode == POOL_MODE_POOL) {
+      ws_flush(NULL);
+    } else {
+      for (size_t i = 0; i < legacy_count; i++) {
+        for (int client = 0; client < POOL_CLIENTS; client++) {
+          httpd_ws_frame_t pkt = {.final = true,
+                                  .type = HTTPD_WS_TYPE_TEXT,
+                                  .payload = (uint8_t *) legacy[i].data,
+                                  .len = legacy[i].len};
+          httpd_ws_send_frame_async(NULL, BENCH_WS_FD_BASE + client, &pkt);
+        }
+        free(legacy[i].data);
+        heap_calls += 2;
+      }
+      legacy_count = 0;
+    }
+    publish_ns += bench_now_ns() - started;
+
+    if (frame % POOL_REPORT_EVERY == 0) pool_report(mode, frame, publish_ns, heap_calls);
+  }
+
+  for (size_t i = 0; i < POOL_CHURN_SLOTS; i++) free(churn[i].block);
+  if (mode == POOL_MODE_POOL) {
+    ws_pool_stats_t stats;
+    ws_pool_get_stats(&stats);
+    printf("pool   sent %u  dropped %u  peak slots in use %u of %d\n", (unsigned) stats.sent,
+           (unsigned) stats.dropped, (unsigned) stats.peak,
+           WS_POOL_SMALL_COUNT + WS_POOL_LARGE_COUNT);
+    bench_ws_stop();
+  }
+}
+
+static void bench_ws_pool(void) {
+  pool_run(POOL_MODE_MALLOC);
+  pool_run(POOL_MODE_POOL);
+}
+
+/*
+ * Per-broadcast cost against the number of connected clients: one event broadcast and one
+ * position publish, each followed by the flush that delivers it. The registry holds only
+ * websocket sessions, so the cost should grow with the clients actually connected and nothing
+ * else; the path it replaced asked httpd for every socket and classified each one per message.
+ */
+
+#define FANOUT_BROADCASTS 200000
+
+static void bench_ws_fanout(void) {
+  static const size_t client_counts[] = {1, 2, 4, WS_MAX_CLIENTS};
+  const char *event = "{\"event\":\"setEnd\",\"data\":{\"reps\":8,\"bestMpv\":0.81}}";
+  const char *position = "{\"event\":\"position\",\"data\":{\"side\":0,\"position\":42.5}}";
+
+  for (size_t c = 0; c < sizeof(client_counts) / sizeof(client_counts[0]); c++) {
+    size_t clients = client_counts[c];
+    bench_ws_start(clients);
+    uint64_t frames_before = shim_ws_stats.frames;
+
+    int64_t started = bench_now_ns();
+    for (int i = 0; i < FANOUT_BROADCASTS; i++) {
+      ws_broadcast(WS_TOPIC_ALL, event, NULL, 0);
+      ws_flush(NULL);
+    }
+    int64_t event_ns = bench_now_ns() - started;
+
+    started = bench_now_ns();
+    for (int i = 0; i < FANOUT_BROADCASTS; i++) {
+      ws_publish_latest(0, position, NULL, 0);
+      ws_flush(NULL);
+    }
+    int64_t position_ns = bench_now_ns() - started;
+
+    uint64_t frames = shim_ws_stats.frames - frames_before;
+    bench_ws_stop();
+    printf("%zu client(s)  event %6.0f ns  position %6.0f ns  per client %5.0f ns  frames %llu\n",
+           clients, (double) event_ns / FANOUT_BROADCASTS, (double) position_ns / FANOUT_BROADCASTS,
+           (double) (event_ns + position_ns) / (2.0 * FANOUT_BROADCASTS * clients),
+           (unsigned long long) frames);
+  }
+}
+
+#endif
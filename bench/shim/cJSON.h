@@ -0,0 +1,38 @@
+#pragma once
+// Host shim: declarations only. The benchmarks and host tests never parse or build JSON; see
+// shim.c.
+#include <stddef.h>
+
+typedef int cJSON_bool;
+typedef struct cJSON {
+  struct cJSON *next, *prev, *child;
+  int type;
+  char *valuestring;
+  int valueint;
+  double valuedouble;
+  char *string;
+} cJSON;
+
+cJSON *cJSON_Parse(const char *value);
+cJSON *cJSON_ParseWithLength(const char *value, size_t length);
+char *cJSON_PrintUnformatted(const cJSON *item);
+const char *cJSON_GetErrorPtr(void);
+void cJSON_Delete(cJSON *item);
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name);
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *name);
+cJSON_bool cJSON_IsString(const cJSON *item);
+cJSON_bool cJSON_IsNumber(const cJSON *item);
+cJSON_bool cJSON_IsArray(const cJSON *item);
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_CreateString(const char *string);
+cJSON *cJSON_CreateNumber(double num);
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item);
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
+cJSON_bool cJSON_ReplaceItemInObject(cJSON *object, const char *string, cJSON *newitem);
+void cJSON_DeleteItemFromArray(cJSON *array, int which);
+void cJSON_DeleteItemFromObject(cJSON *object, const char *string);
+
+#define cJSON_ArrayForEach(element, array)                                                        \
+  for (element = (array) ? (array)->child : NULL; element; element = element->next)
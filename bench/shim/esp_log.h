@@ -0,0 +1,15 @@
+#pragma once
+// Host shim: logging is compiled (so formats are checked) but silent while benchmarks run
+#include <stdio.h>
+
+#include "esp_err.h"
+
+#define ESP_SHIM_LOG(tag, fmt, ...)                                                               \
+  do {                                                                                            \
+    if (0) printf("%s: " fmt, tag, ##__VA_ARGS__);                                                \
+  } while (0)
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_SHIM_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_SHIM_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ESP_SHIM_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) ESP_SHIM_LOG(tag, fmt, ##__VA_ARGS__)
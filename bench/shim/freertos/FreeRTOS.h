@@ -0,0 +1,23 @@
+#pragma once
+// Host shim: mutexes and queues are pthread-backed; tasks are never started, the benchmarks call
+// the task bodies' work themselves
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef struct shim_queue *QueueHandle_t;
+typedef struct shim_queue *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+#define portYIELD_FROM_ISR(woken) (void) (woken)
@@ -0,0 +1,7 @@
+#pragma once
+#include "FreeRTOS.h"
+
+// Never blocks: the benchmarks are single-threaded, so a wait could not end anyway
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
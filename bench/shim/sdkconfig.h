@@ -0,0 +1,3 @@
+#pragma once
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ 1000
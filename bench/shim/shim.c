@@ -0,0 +1,505 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "shim.h"
+#include "uuid.h"
+
+/*
+ * Host implementations behind the shim headers. Only what the benchmarks and host tests exercise
+ * does real work; the calls that the included headers reference but never reach on the host
+ * abort, so a benchmark or test that strays onto them fails loudly instead of running a stub.
+ */
+
+#define SHIM_UNREACHABLE() shim_unreachable(__func__)
+
+static void shim_unreachable(const char *fn) {
+  fprintf(stderr, "%s is not available on the host\n", fn);
+  abort();
+}
+
+const char *esp_err_to_name(esp_err_t err) { return err == ESP_OK ? "ESP_OK" : "ESP_ERR"; }
+
+int64_t esp_timer_get_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Timers can be created, but nothing on the host arms one
+struct esp_timer {
+  esp_timer_create_args_t args;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
+                           esp_timer_handle_t *out_handle) {
+  esp_timer_handle_t timer = calloc(1, sizeof(*timer));
+  if (!timer) return ESP_ERR_NO_MEM;
+  timer->args = *create_args;
+  *out_handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  (void) timer;
+  (void) timeout_us;
+  SHIM_UNREACHABLE();
+  return ESP_FAIL;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  (void) timer;
+  SHIM_UNREACHABLE();
+  return ESP_FAIL;
+}
+
+// Queues and mutexes
+
+struct shim_queue {
+  pthread_mutex_t mutex;
+  uint8_t *items;
+  size_t item_size;
+  size_t length;
+  size_t head;
+  size_t count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  QueueHandle_t queue = calloc(1, sizeof(*queue));
+  if (!queue) return NULL;
+  queue->items = calloc(length ? length : 1, item_size ? item_size : 1);
+  if (!queue->items) {
+    free(queue);
+    return NULL;
+  }
+  pthread_mutex_init(&queue->mutex, NULL);
+  queue->item_size = item_size;
+  queue->length = length;
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+  (void) wait;
+  pthread_mutex_lock(&queue->mutex);
+  BaseType_t sent = queue->count < queue->length;
+  if (sent) {
+    size_t tail = (queue->head + queue->count++) % queue->length;
+    memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return sent ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  (void) wait;
+  pthread_mutex_lock(&queue->mutex);
+  BaseType_t received = queue->count > 0;
+  if (received) {
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return received ? pdTRUE : pdFALSE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  SemaphoreHandle_t mutex = calloc(1, sizeof(*mutex));
+  if (mutex) pthread_mutex_init(&mutex->mutex, NULL);
+  return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait) {
+  (void) wait;
+  return pthread_mutex_lock(&mutex->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  return pthread_mutex_unlock(&mutex->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex) {
+  if (!mutex) return;
+  pthread_mutex_destroy(&mutex->mutex);
+  free(mutex);
+}
+
+// Tasks
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  (void) fn;
+  (void) name;
+  (void) stack;
+  (void) arg;
+  (void) priority;
+  if (handle) *handle = NULL;
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  (void) ticks;
+  sched_yield();
+}
+
+void vTaskDelayUntil(TickType_t *last_wake, TickType_t period) {
+  (void) last_wake;
+  (void) period;
+  SHIM_UNREACHABLE();
+}
+
+TickType_t xTaskGetTickCount(void) { return (TickType_t) (esp_timer_get_time() / 1000); }
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  (void) task;
+  (void) value;
+  (void) action;
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *woken) {
+  (void) task;
+  (void) value;
+  (void) action;
+  if (woken) *woken = pdFALSE;
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value,
+                           TickType_t wait) {
+  (void) clear_on_entry;
+  (void) clear_on_exit;
+  (void) value;
+  (void) wait;
+  SHIM_UNREACHABLE();
+  return pdFALSE;
+}
+
+// HTTP server: queued work runs inline, and websocket frames and response bytes are copied into a
+// scratch buffer, standing in for the socket send
+
+shim_ws_stats_t shim_ws_stats;
+shim_http_stats_t shim_http_stats;
+static uint8_t shim_ws_sink[4096];
+static const char *const *shim_http_headers;
+
+void shim_http_set_headers(const char *const *headers) { shim_http_headers = headers; }
+
+static const char *shim_http_header(const char *field) {
+  for (const char *const *h = shim_http_headers; h && h[0]; h += 2) {
+    if (strcasecmp(h[0], field) == 0) return h[1];
+  }
+  return NULL;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri) {
+  (void) handle;
+  (void) uri;
+  return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg) {
+  (void) handle;
+  work(arg);
+  return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t handle, int fd, httpd_ws_frame_t *frame) {
+  (void) handle;
+  (void) fd;
+  size_t len = frame->len < sizeof(shim_ws_sink) ? frame->len : sizeof(shim_ws_sink);
+  memcpy(shim_ws_sink, frame->payload, len);
+  shim_ws_stats.frames++;
+  shim_ws_stats.bytes += frame->len;
+  return ESP_OK;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int fd) {
+  (void) handle;
+  (void) fd;
+  return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame) {
+  (void) req;
+  (void) frame;
+  SHIM_UNREACHABLE();
+  return ESP_FAIL;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len) {
+  (void) req;
+  (void) frame;
+  (void) max_len;
+  SHIM_UNREACHABLE();
+  return ESP_FAIL;
+}
+
+void *httpd_sess_get_ctx(httpd_handle_t handle, int fd) {
+  (void) handle;
+  (void) fd;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+void httpd_sess_set_ctx(httpd_handle_t handle, int fd, void *ctx, httpd_free_ctx_fn_t free_fn) {
+  (void) handle;
+  (void) fd;
+  (void) ctx;
+  (void) free_fn;
+  SHIM_UNREACHABLE();
+}
+
+// No socket behind a request, so the peer address lookup fails as for a closed connection
+int httpd_req_to_sockfd(httpd_req_t *req) {
+  (void) req;
+  return -1;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *req, const char *field) {
+  (void) req;
+  const char *value = shim_http_header(field);
+  return value ? strlen(value) : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val,
+                                      size_t val_size) {
+  (void) req;
+  const char *value = shim_http_header(field);
+  if (!value) return ESP_ERR_NOT_FOUND;
+  if (val_size == 0) return ESP_ERR_INVALID_SIZE;
+  snprintf(val, val_size, "%s", value);
+  return strlen(value) < val_size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len) {
+  (void) req;
+  (void) buf;
+  (void) buf_len;
+  SHIM_UNREACHABLE();
+  return -1;
+}
+
+int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len) {
+  (void) req;
+  for (size_t done = 0; done < buf_len; done += sizeof(shim_ws_sink)) {
+    size_t len = buf_len - done < sizeof(shim_ws_sink) ? buf_len - done : sizeof(shim_ws_sink);
+    memcpy(shim_ws_sink, buf + done, len);
+  }
+  shim_http_stats.bytes += buf_len;
+  return (int) buf_len;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+  (void) req;
+  (void) status;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+  (void) req;
+  (void) field;
+  (void) value;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+  if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = buf ? (ssize_t) strlen(buf) : 0;
+  httpd_send(req, buf, (size_t) buf_len);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg) {
+  (void) error;
+  shim_http_stats.errors++;
+  return httpd_resp_send(req, msg, HTTPD_RESP_USE_STRLEN);
+}
+
+// Partitions: one, backed by memory the benchmark supplies
+
+static esp_partition_t shim_partition;
+static const uint8_t *shim_partition_image;
+
+void shim_partition_set(const char *label, const void *image, size_t size) {
+  shim_partition = (esp_partition_t) {.type = ESP_PARTITION_TYPE_DATA, .size = (uint32_t) size};
+  snprintf(shim_partition.label, sizeof(shim_partition.label), "%s", label);
+  shim_partition_image = image;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  (void) subtype;
+  if (!shim_partition_image || type != shim_partition.type) return NULL;
+  return label && strcmp(label, shim_partition.label) != 0 ? NULL : &shim_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst,
+                             size_t size) {
+  if (offset > partition->size || size > partition->size - offset) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, shim_partition_image + offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out,
+                             esp_partition_mmap_handle_t *handle) {
+  (void) memory;
+  if (offset > partition->size || size > partition->size - offset) return ESP_ERR_INVALID_SIZE;
+  *out = shim_partition_image + offset;
+  *handle = 0;
+  return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) { (void) handle; }
+
+// cJSON: the request paths that parse, print or build JSON are never run on the host
+
+cJSON *cJSON_Parse(const char *value) {
+  (void) value;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t length) {
+  (void) value;
+  (void) length;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item) {
+  (void) item;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+const char *cJSON_GetErrorPtr(void) { return NULL; }
+
+void cJSON_Delete(cJSON *item) { (void) item; }
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name) {
+  (void) object;
+  (void) name;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *item) {
+  (void) item;
+  SHIM_UNREACHABLE();
+  return 0;
+}
+
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *name) {
+  (void) object;
+  (void) name;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item) {
+  (void) item;
+  SHIM_UNREACHABLE();
+  return 0;
+}
+
+cJSON_bool cJSON_IsArray(const cJSON *item) {
+  (void) item;
+  SHIM_UNREACHABLE();
+  return 0;
+}
+
+cJSON *cJSON_CreateObject(void) {
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON *cJSON_CreateString(const char *string) {
+  (void) string;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON *cJSON_CreateNumber(double num) {
+  (void) num;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item) {
+  (void) array;
+  (void) item;
+  SHIM_UNREACHABLE();
+  return 0;
+}
+
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name) {
+  (void) object;
+  (void) name;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string) {
+  (void) object;
+  (void) name;
+  (void) string;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number) {
+  (void) object;
+  (void) name;
+  (void) number;
+  SHIM_UNREACHABLE();
+  return NULL;
+}
+
+cJSON_bool cJSON_ReplaceItemInObject(cJSON *object, const char *string, cJSON *newitem) {
+  (void) object;
+  (void) string;
+  (void) newitem;
+  SHIM_UNREACHABLE();
+  return 0;
+}
+
+void cJSON_DeleteItemFromArray(cJSON *array, int which) {
+  (void) array;
+  (void) which;
+  SHIM_UNREACHABLE();
+}
+
+void cJSON_DeleteItemFromObject(cJSON *object, const char *string) {
+  (void) object;
+  (void) string;
+  SHIM_UNREACHABLE();
+}
+
+// uuid: only exercises.h references it, when a new category is created
+
+void uuid_generate(uuid_t out) {
+  (void) out;
+  SHIM_UNREACHABLE();
+}
+
+void uuid_unparse(const uuid_t uu, char *out) {
+  (void) uu;
+  (void) out;
+  SHIM_UNREACHABLE();
+}
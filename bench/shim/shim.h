@@ -0,0 +1,26 @@
+#pragma once
+// Hooks into the host shim for the benchmarks and host tests
+#include <stddef.h>
+#include <stdint.h>
+
+// Frames passed to httpd_ws_send_frame_async() so far; payloads are copied into a scratch buffer
+typedef struct {
+  uint64_t frames;
+  uint64_t bytes;
+} shim_ws_stats_t;
+
+extern shim_ws_stats_t shim_ws_stats;
+
+// Bytes written to HTTP responses, heads included, and error responses sent
+typedef struct {
+  uint64_t bytes;
+  uint64_t errors;
+} shim_http_stats_t;
+
+extern shim_http_stats_t shim_http_stats;
+
+// Request headers for the next requests, as name, value pairs ending in NULL
+void shim_http_set_headers(const char *const *headers);
+
+// Backs the partition with label by image, which has to stay valid while it is mapped
+void shim_partition_set(const char *label, const void *image, size_t size);
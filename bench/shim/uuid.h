@@ -0,0 +1,9 @@
+#pragma once
+// Host shim for the ESP-IDF uuid component
+
+#define UUID_STR_LEN 37
+
+typedef unsigned char uuid_t[16];
+
+void uuid_generate(uuid_t out);
+void uuid_unparse(const uuid_t uu, char *out);
@@ -0,0 +1,136 @@
+// Packs the built web app into one image for the device's www partition, served
+// straight from memory-mapped flash (see backend/routes/web/asset_pack.h).
+//
+//   node scripts/pack-assets.mjs [dist] [www.pack] [max bytes]
+//
+// Layout, little-endian:
+//   header   magic "LPK1", u16 version, u16 count, u32 entries, u32 strings,
+//            u32 data, u32 total size, 8 reserved bytes (32 bytes)
+//   entries  sorted by path: u32 path, u32 content type, then identity, gzip
+//            and br variants as {u32 offset, u32 length, u32 etag} (44 bytes)
+//   strings  NUL-terminated; offsets are from the start of the image
+//   data     variant bodies, 4-byte aligned; length 0 marks a missing variant
+import { createHash } from 'node:crypto';
+import { readFileSync, readdirSync, statSync, writeFileSync } from 'node:fs';
+import { extname, join, relative, sep } from 'node:path';
+
+const MAGIC = 0x314b504c;
+const VERSION = 1;
+const HEADER_SIZE = 32;
+const ENTRY_SIZE = 44;
+const VARIANTS = ['', '.gz', '.br'];
+
+const CONTENT_TYPES = {
+  '.html': 'text/html',
+  '.css': 'text/css',
+  '.js': 'application/javascript',
+  '.json': 'application/json',
+  '.png': 'image/png',
+  '.ico': 'image/x-icon',
+  '.svg': 'image/svg+xml',
+  '.mp3': 'audio/mpeg',
+  '.webmanifest': 'application/manifest+json',
+};
+
+const [dist = 'dist', out = 'www.pack', maxBytes] = process.argv.slice(2);
+
+const listFiles = (dir) =>
+  readdirSync(dir).flatMap((name) => {
+    const path = join(dir, name);
+    return statSync(path).isDirectory() ? listFiles(path) : [path];
+  });
+
+// Group the precompressed siblings under the path clients ask for
+const assets = new Map();
+for (const file of listFiles(dist)) {
+  let path = '/' + relative(dist, file).split(sep).join('/');
+  // The pack carries its own ETags
+  if (path === '/assets.sha256') continue;
+  let variant = 0;
+  for (let i = 1; i < VARIANTS.length; i++) {
+    if (path.endsWith(VARIANTS[i])) {
+      path = path.slice(0, -VARIANTS[i].length);
+      variant = i;
+    }
+  }
+  if (!assets.has(path)) assets.set(path, [null, null, null]);
+  assets.get(path)[variant] = readFileSync(file);
+}
+
+const paths = [...assets.keys()].sort((a, b) =>
+  Buffer.compare(Buffer.from(a), Buffer.from(b))
+);
+
+const strings = [];
+let stringsSize = 0;
+const stringOffsets = new Map();
+const addString = (value) => {
+  if (!stringOffsets.has(value)) {
+    stringOffsets.set(value, stringsSize);
+    const bytes = Buffer.from(value + '\0');
+    strings.push(bytes);
+    stringsSize += bytes.length;
+  }
+  return stringOffsets.get(value);
+};
+
+const entries = paths.map((path) => ({
+  path: addString(path),
+  contentType: addString(
+    CONTENT_TYPES[extname(path)] ?? 'application/octet-stream'
+  ),
+  variants: assets.get(path).map((body) => {
+    if (!body) return null;
+    // Strong validator: the digest of the exact bytes sent
+    const digest = createHash('sha256').update(body).digest('hex');
+    return { body, etag: addString(`"${digest.slice(0, 16)}"`) };
+  }),
+}));
+
+const align = (n) => (n + 3) & ~3;
+const entriesOffset = HEADER_SIZE;
+const stringsOffset = entriesOffset + entries.length * ENTRY_SIZE;
+const dataOffset = align(stringsOffset + stringsSize);
+
+let dataSize = 0;
+for (const entry of entries) {
+  for (const variant of entry.variants) {
+    if (!variant) continue;
+    variant.offset = dataOffset + dataSize;
+    dataSize = align(dataSize + variant.body.length);
+  }
+}
+const totalSize = dataOffset + dataSize;
+
+const image = Buffer.alloc(totalSize);
+image.writeUInt32LE(MAGIC, 0);
+image.writeUInt16LE(VERSION, 4);
+image.writeUInt16LE(entries.length, 6);
+image.writeUInt32LE(entriesOffset, 8);
+image.writeUInt32LE(stringsOffset, 12);
+image.writeUInt32LE(dataOffset, 16);
+image.writeUInt32LE(totalSize, 20);
+
+entries.forEach((entry, i) => {
+  let at = entriesOffset + i * ENTRY_SIZE;
+  image.writeUInt32LE(stringsOffset + entry.path, at);
+  image.writeUInt32LE(stringsOffset + entry.contentType, at + 4);
+  at += 8;
+  for (const variant of entry.variants) {
+    if (variant) {
+      image.writeUInt32LE(variant.offset, at);
+      image.writeUInt32LE(variant.body.length, at + 4);
+      image.writeUInt32LE(stringsOffset + variant.etag, at + 8);
+      variant.body.copy(image, variant.offset);
+    }
+    at += 12;
+  }
+});
+Buffer.concat(strings).copy(image, stringsOffset);
+
+if (maxBytes && totalSize > Number(maxBytes)) {
+  console.error(`${out}: ${totalSize} bytes exceeds ${maxBytes}`);
+  process.exit(1);
+}
+writeFileSync(out, image);
+console.log(`${out}: ${entries.length} assets, ${totalSize} bytes`);
@@ -21,7 +21,12 @@ import {
   useAppSelector,
   setWakelockTimeoutAt,
 } from './store';
-import { wsConnect, wsDisconnect, wsSendThresholds } from './wsMiddleware';
+import {
+  wsConnect,
+  wsDisconnect,
+  wsSendThresholds,
+  wsSendUser,
+} from './wsMiddleware';
 import SetHistory from './components/SetHistory';
 import { Exercise, HardwareConfig } from './models';
 import DebugPanel from './components/DebugPanel';
@@ -94,6 +99,8 @@ export default function App() {
   const wsReadyState = useAppSelector((s) => s.machine.wsReadyState);
   const wsErrored = useAppSelector((s) => s.machine.wsErrored);
   const calibrationEvent = useAppSelector((s) => s.machine.calibrationEvent);
+  const stopSetEvent = useAppSelector((s) => s.machine.stopSetEvent);
+  const selectedUserName = useAppSelector((s) => s.machine.selectedUser?.name);
 
   const { data: exercisesData, error: exercisesError } = useGetExercisesQuery();
   const { data: settingsData, error: settingsError } = useGetSettingsQuery();
@@ -232,6 +239,15 @@ export default function App() {
     }
   }, [calibrationEvent, notify]);
 
+  // --- Velocity loss notifications ---
+  useEffect(() => {
+    if (!stopSetEvent) return;
+    notify(
+      `Velocity dropped ${Math.round(stopSetEvent.velocityLoss)}% — end the set`,
+      { variant: 'info' }
+    );
+  }, [stopSetEvent, notify]);
+
   // --- Bump wakelock on position events ---
   useEffect(() => {
     if (!mountedRef.current) {
@@ -245,7 +261,13 @@ export default function App() {
   useEffect(() => {
     if (wsReadyState !== WebSocket.OPEN) return;
     dispatch(
-      wsSendThresholds({ threshold: sliderThreshold, repBand: sliderRepBand })
+      wsSendThresholds({
+        threshold: sliderThreshold,
+        repBand: sliderRepBand,
+        velocityLoss: selectedExercise?.velocityLoss,
+        type: selectedExercise?.type,
+        exercise: selectedExercise?.name,
+      })
     );
   }, [
     wsReadyState,
@@ -255,6 +277,12 @@ export default function App() {
     dispatch,
   ]);
 
+  // --- Credit reps to the selected user on change or reconnect ---
+  useEffect(() => {
+    if (wsReadyState !== WebSocket.OPEN) return;
+    dispatch(wsSendUser({ name: selectedUserName }));
+  }, [wsReadyState, selectedUserName, dispatch]);
+
   useEffect(() => {
     (async () => {
       dispatch(hydrateConfig());
@@ -7,6 +7,23 @@ export interface SetRecord {
   userName?: string;
 }
 
+export interface RepKinematics {
+  rom: number;
+  concentric_ms: number;
+  eccentric_ms: number;
+  tut_ms: number;
+  peak_velocity: number;
+  mean_velocity: number;
+  mean_propulsive_velocity: number;
+  velocity_loss: number;
+}
+
+export interface RepAsymmetry {
+  rom: number;
+  velocity: number;
+  sync_ms: number;
+}
+
 export interface User {
   name: string;
   color: string;
@@ -16,6 +33,7 @@ export interface Exercise {
   name: string;
   thresholdPercentage: number;
   repBand: number;
+  velocityLoss?: number;
   type: 'singular' | 'alternating';
   categoryId?: string;
   categoryName?: string;
@@ -42,5 +60,86 @@ export interface HardwareConfig {
   movement?: {
     debounceInterval?: number;
     calibrationDebounceSteps?: number;
+    encoderDriver?: 'gpio' | 'pcnt' | 'fake';
+    encoderSamplePeriod?: number;
+    encoderResolution?: 1 | 4;
+    // Report reps at the end of the cycle, with eccentric timing
+    repOnReturn?: boolean;
+    // WebSocket flushes per second; positions in between coalesce
+    wsFrameRate?: number;
   };
 }
+
+export interface HistoryRecord {
+  type: 'session_start' | 'session_end' | 'set_start' | 'set_end' | 'rep';
+  t: number;
+  synced: boolean;
+  session: number;
+  set: number;
+  exercise: string;
+  side?: 'left' | 'right' | 'both';
+  rom?: number;
+  peak_velocity?: number;
+  mean_propulsive_velocity?: number;
+  velocity_loss?: number;
+  concentric_ms?: number;
+  eccentric_ms?: number;
+  stop_set?: boolean;
+  rom_asymmetry?: number;
+  velocity_asymmetry?: number;
+  reps?: number;
+  sets?: number;
+  duration_ms?: number;
+  best_mpv?: number;
+  max_velocity_loss?: number;
+}
+
+export type HistoryMetric =
+  | 'mpv'
+  | 'peak_velocity'
+  | 'rom'
+  | 'velocity_loss'
+  | 'set_reps';
+
+export interface HistoryQuery {
+  from?: number;
+  to?: number;
+  exercise?: string;
+  metric?: HistoryMetric;
+  points?: number;
+  mode?: 'bucket' | 'lttb';
+}
+
+export type HistoryResponse =
+  | { records: HistoryRecord[] }
+  | {
+      metric: HistoryMetric;
+      mode: 'bucket';
+      points: {
+        t: number;
+        count: number;
+        min: number;
+        max: number;
+        mean: number;
+      }[];
+    }
+  | { metric: HistoryMetric; mode: 'lttb'; points: [number, number][] };
+
+export interface StatsWeek {
+  startMs: number;
+  reps: number;
+  sets: number;
+  rom: number;
+}
+
+export interface UserStats {
+  user: string;
+  exercise: string | null; // null: totals across exercises
+  lastMs: number;
+  totalReps: number;
+  totalSets: number;
+  bestMpv: number;
+  bestPeakVelocity: number;
+  bestRom: number;
+  weeks: StatsWeek[];
+}
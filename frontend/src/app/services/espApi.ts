@@ -1,5 +1,12 @@
 import { createApi, fetchBaseQuery } from '@reduxjs/toolkit/query/react';
-import { Category, Exercise, HardwareConfig } from '../models';
+import {
+  Category,
+  Exercise,
+  HardwareConfig,
+  HistoryQuery,
+  HistoryResponse,
+  UserStats,
+} from '../models';
 
 export const espApi = createApi({
   reducerPath: 'espApi',
@@ -64,6 +71,15 @@ export const espApi = createApi({
         responseHandler: 'text',
       }),
     }),
+    getHistory: builder.query<HistoryResponse, HistoryQuery>({
+      query: (params) => ({ url: 'history', params }),
+    }),
+    getStats: builder.query<{ stats: UserStats[] }, string | void>({
+      query: (user) => ({
+        url: 'stats',
+        params: user ? { user } : undefined,
+      }),
+    }),
     zeroEncoder: builder.mutation<string, void>({
       query: () => ({
         url: 'calibrate/zero',
@@ -83,4 +99,6 @@ export const {
   useCalibrateMutation,
   useRestartMutation,
   useZeroEncoderMutation,
+  useGetHistoryQuery,
+  useGetStatsQuery,
 } = espApi;
@@ -37,6 +37,7 @@ type MachineState = {
   wsReadyState: number;
   wsErrored: boolean;
   calibrationEvent: { name: string; state: string; at: number } | null;
+  stopSetEvent: { name: string; velocityLoss: number; at: number } | null;
 
   /* Rep Target */
   repTarget: {
@@ -87,6 +88,7 @@ const initialState: MachineState = {
   wsReadyState: -1,
   wsErrored: false,
   calibrationEvent: null,
+  stopSetEvent: null,
   repTarget: {
     enabled: false,
     reps: 10,
@@ -136,6 +138,12 @@ const machineSlice = createSlice({
     ) => {
       state.calibrationEvent = { ...action.payload, at: Date.now() };
     },
+    setStopSetEvent: (
+      state,
+      action: PayloadAction<{ name: string; velocityLoss: number }>
+    ) => {
+      state.stopSetEvent = { ...action.payload, at: Date.now() };
+    },
     setRepTarget: (
       state,
       action: PayloadAction<{
@@ -201,6 +209,12 @@ const machineSlice = createSlice({
       state.repsRight += 1;
       state.reps += state.isAlternating ? 0.5 : 1;
     },
+    // Singular rep the device fused from both sides
+    incrementBoth: (state) => {
+      state.repsLeft += 1;
+      state.repsRight += 1;
+      state.reps += 1;
+    },
     setLastMessageTime: (state, action: PayloadAction<number>) => {
       state.lastMessageTime = action.payload;
     },
@@ -323,6 +337,7 @@ const {
   setWakelockTimeoutAt,
   setWsStatus,
   setCalibrationEvent,
+  setStopSetEvent,
   setRepTarget,
   setSelectedExerciseState,
   setSliderPositionLeft,
@@ -332,6 +347,7 @@ const {
   updateExerciseRepBand,
   incrementLeft,
   incrementRight,
+  incrementBoth,
   setLastMessageTime,
   setLastMovementTime,
   setTimerIntervalId,
@@ -372,6 +388,7 @@ export {
   setWakelockTimeoutAt,
   setWsStatus,
   setCalibrationEvent,
+  setStopSetEvent,
 };
 
 export const clearHistoryForDate =
@@ -516,10 +533,12 @@ export const tick = (): AppThunk => (dispatch, getState) => {
 };
 
 export const applyRepCompleted =
-  (side: 'left' | 'right'): AppThunk =>
+  (side: 'left' | 'right' | 'both'): AppThunk =>
   (dispatch, getState) => {
     dispatch(startTimer());
-    if (side === 'right') {
+    if (side === 'both') {
+      dispatch(incrementBoth());
+    } else if (side === 'right') {
       dispatch(incrementRight());
     } else {
       dispatch(incrementLeft());
@@ -6,17 +6,55 @@ import {
   setSliderPositionRight,
   setWsStatus,
   setCalibrationEvent,
+  setStopSetEvent,
 } from './store';
 import { applyRepCompleted } from './store';
+import type { Exercise, RepAsymmetry, RepKinematics } from './models';
 
 export const wsConnect = createAction('ws/connect');
 export const wsDisconnect = createAction('ws/disconnect');
 export const wsSendThresholds = createAction<{
   threshold: number;
   repBand: number;
+  velocityLoss?: number;
+  type?: Exercise['type'];
+  exercise?: string;
 }>('ws/sendThresholds');
 
+export const wsSendUser = createAction<{ name?: string }>('ws/sendUser');
+
+// Topics: 'position', 'position:<encoder>', 'rep', 'telemetry' or 'all'
+export const wsSubscribe = createAction<string[]>('ws/subscribe');
+export const wsUnsubscribe = createAction<string[]>('ws/unsubscribe');
+
 const HANDSHAKE_INTERVAL_MS = 15000;
+// Position updates arrive as 16-byte binary frames when the device accepts this
+const BINARY_SUBPROTOCOL = 'lift.bin.v1';
+const FRAME_POSITION = 0x01;
+// Encoder ids in device registration order
+const ENCODER_NAMES = ['left', 'right'];
+const CAL_STATES = ['idle', 'seek_max', 'done'] as const;
+
+type PositionEvent = {
+  name: string;
+  calibrated: number;
+  cal_state: (typeof CAL_STATES)[number];
+};
+
+// Layout matches ws_position_frame_t on the device
+const decodePositionFrame = (buffer: ArrayBuffer): PositionEvent | null => {
+  if (buffer.byteLength < 16) return null;
+  const view = new DataView(buffer);
+  if (view.getUint8(0) !== FRAME_POSITION) return null;
+  const name = ENCODER_NAMES[view.getUint8(1)];
+  const calState = CAL_STATES[view.getUint8(14)];
+  if (!name || !calState) return null;
+  return {
+    name,
+    calibrated: Math.ceil(view.getInt32(8, true) / 65536),
+    cal_state: calState,
+  };
+};
 
 export const createWsMiddleware = (): Middleware => {
   return (store) => {
@@ -69,13 +107,19 @@ export const createWsMiddleware = (): Middleware => {
         setWsStatus({ readyState: WebSocket.CONNECTING, errored: false })
       );
 
-      socket = new WebSocket(getUrl());
+      // Older firmware ignores the offer and keeps sending JSON
+      socket = new WebSocket(getUrl(), [BINARY_SUBPROTOCOL]);
+      socket.binaryType = 'arraybuffer';
 
       socket.onopen = () => {
         reconnectAttempt = 0;
         handshakeExpired = false;
         dispatch(setLastMessageTime(Date.now()));
         dispatch(setWsStatus({ readyState: WebSocket.OPEN, errored: false }));
+        // The device has no clock of its own; its workout log uses ours
+        send(JSON.stringify({ event: 'clock', epochMs: Date.now() }));
+        // Sessions start subscribed to everything; nothing here reads telemetry
+        send(JSON.stringify({ event: 'unsubscribe', topics: ['telemetry'] }));
 
         heartbeatTimer = window.setInterval(() => {
           const state = store.getState() as {
@@ -100,11 +144,43 @@ export const createWsMiddleware = (): Middleware => {
         if (!intentionalClose) scheduleReconnect();
       };
 
+      const applyPosition = (data: PositionEvent) => {
+        const calibrated = Math.min(Math.max(0, data.calibrated ?? 0), 100);
+        if (data.name === 'right') dispatch(setSliderPositionRight(calibrated));
+        else dispatch(setSliderPositionLeft(calibrated));
+
+        if (data.cal_state === 'seek_max' || data.cal_state === 'idle') {
+          dispatch(
+            setCalibrationEvent({ name: data.name, state: data.cal_state })
+          );
+        }
+      };
+
       socket.onmessage = (e) => {
+        if (e.data instanceof ArrayBuffer) {
+          const position = decodePositionFrame(e.data);
+          if (!position) return;
+          dispatch(setLastMessageTime(Date.now()));
+          handshakeExpired = false;
+          applyPosition(position);
+          return;
+        }
+
         const data: {
-          event?: 'position' | 'rep' | 'threshold' | 'handshake';
+          event?:
+            | 'position'
+            | 'rep'
+            | 'stop_set'
+            | 'threshold'
+            | 'handshake'
+            | 'telemetry';
           name: string;
           calibrated: number;
+          velocity?: number;
+          acceleration?: number;
+          kinematics?: RepKinematics;
+          asymmetry?: RepAsymmetry;
+          velocity_loss?: number;
           cal_state: 'idle' | 'seek_max' | 'done';
         } = JSON.parse(e.data);
 
@@ -116,24 +192,27 @@ export const createWsMiddleware = (): Middleware => {
         const eventType = data.event ?? 'position';
 
         if (eventType === 'rep') {
-          if (data.name === 'right' || data.name === 'left') {
+          if (
+            data.name === 'right' ||
+            data.name === 'left' ||
+            data.name === 'both'
+          ) {
             dispatch(applyRepCompleted(data.name));
           }
           return;
         }
 
-        if (eventType === 'position') {
-          const calibrated = Math.min(Math.max(0, data.calibrated ?? 0), 100);
-          if (data.name === 'right')
-            dispatch(setSliderPositionRight(calibrated));
-          else dispatch(setSliderPositionLeft(calibrated));
-
-          if (data.cal_state === 'seek_max' || data.cal_state === 'idle') {
-            dispatch(
-              setCalibrationEvent({ name: data.name, state: data.cal_state })
-            );
-          }
+        if (eventType === 'stop_set') {
+          dispatch(
+            setStopSetEvent({
+              name: data.name,
+              velocityLoss: data.velocity_loss ?? 0,
+            })
+          );
+          return;
         }
+
+        if (eventType === 'position') applyPosition(data);
       };
     };
 
@@ -156,7 +235,8 @@ export const createWsMiddleware = (): Middleware => {
       } else if (wsDisconnect.match(action)) {
         disconnect();
       } else if (wsSendThresholds.match(action)) {
-        const { threshold, repBand } = action.payload;
+        const { threshold, repBand, velocityLoss, type, exercise } =
+          action.payload;
         const clamped = Math.min(Math.max(0, threshold), 100);
         send(
           JSON.stringify({
@@ -164,6 +244,9 @@ export const createWsMiddleware = (): Middleware => {
             name: 'left',
             threshold: clamped,
             repBand,
+            velocityLoss,
+            type,
+            exercise,
           })
         );
         send(
@@ -172,8 +255,19 @@ export const createWsMiddleware = (): Middleware => {
             name: 'right',
             threshold: clamped,
             repBand,
+            velocityLoss,
+            type,
+            exercise,
           })
         );
+      } else if (wsSubscribe.match(action)) {
+        send(JSON.stringify({ event: 'subscribe', topics: action.payload }));
+      } else if (wsUnsubscribe.match(action)) {
+        send(JSON.stringify({ event: 'unsubscribe', topics: action.payload }));
+      } else if (wsSendUser.match(action)) {
+        send(
+          JSON.stringify({ event: 'user', name: action.payload.name ?? null })
+        );
       }
 
       return next(action);
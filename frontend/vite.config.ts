@@ -1,9 +1,77 @@
-import { defineConfig } from 'vite';
+import { defineConfig, type Plugin } from 'vite';
 import react from '@vitejs/plugin-react';
 import tsConfigPaths from 'vite-tsconfig-paths';
+import {
+  readFileSync,
+  readdirSync,
+  statSync,
+  writeFileSync,
+} from 'node:fs';
+import { createHash } from 'node:crypto';
+import { join, relative, resolve, sep } from 'node:path';
+import { brotliCompressSync, constants, gzipSync } from 'node:zlib';
 
 const espHost = 'esp-lift2.arpa';
 
+const COMPRESSIBLE = /\.(html|js|css|svg|json|webmanifest|ico)$/;
+const MIN_COMPRESS_BYTES = 1024;
+const MANIFEST_NAME = 'assets.sha256';
+
+const listFiles = (dir: string): string[] =>
+  readdirSync(dir).flatMap((name) => {
+    const path = join(dir, name);
+    return statSync(path).isDirectory() ? listFiles(path) : [path];
+  });
+
+// Writes .br and .gz siblings for the device's file server to negotiate.
+// The uncompressed file always stays as the fallback for clients that
+// accept neither. To keep the www partition within size, the hashed
+// bundles in assets/ get no .br, only .gz, which every browser accepts.
+// Then lists a content hash for every file shipped, which the server
+// loads as its strong ETags.
+const precompress = (): Plugin => {
+  let outDir = 'dist';
+  return {
+    name: 'precompress',
+    apply: 'build',
+    configResolved(config) {
+      outDir = resolve(config.root, config.build.outDir);
+    },
+    closeBundle() {
+      for (const path of listFiles(outDir)) {
+        if (!COMPRESSIBLE.test(path)) continue;
+        const raw = readFileSync(path);
+        if (raw.length < MIN_COMPRESS_BYTES) continue;
+
+        const gz = gzipSync(raw, { level: 9 });
+        if (gz.length >= raw.length * 0.9) continue;
+        writeFileSync(`${path}.gz`, gz);
+        if (relative(outDir, path).startsWith(`assets${sep}`)) continue;
+
+        const br = brotliCompressSync(raw, {
+          params: {
+            [constants.BROTLI_PARAM_QUALITY]: constants.BROTLI_MAX_QUALITY,
+            [constants.BROTLI_PARAM_SIZE_HINT]: raw.length,
+          },
+        });
+        if (br.length < gz.length) writeFileSync(`${path}.br`, br);
+      }
+
+      const manifest = listFiles(outDir)
+        .map((path) => relative(outDir, path))
+        .filter((name) => name !== MANIFEST_NAME)
+        .map((name) => {
+          const hash = createHash('sha256')
+            .update(readFileSync(join(outDir, name)))
+            .digest('hex')
+            .slice(0, 16);
+          return `${hash} /${name.split(sep).join('/')}\n`;
+        });
+      writeFileSync(join(outDir, MANIFEST_NAME), manifest.join(''));
+    },
+  };
+};
+
 export default defineConfig({
   server: {
     proxy: {
@@ -27,5 +95,6 @@ export default defineConfig({
       },
     }),
     tsConfigPaths(),
+    precompress(),
   ],
 });
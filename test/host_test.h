@@ -0,0 +1,37 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Minimal assertions for the host tests: a failed check prints where and exits non-zero, which
+ * is all ctest needs.
+ */
+
+#define CHECK(cond)                                                                               \
+  do {                                                                                            \
+    if (!(cond)) {                                                                                \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                    \
+      exit(EXIT_FAILURE);                                                                         \
+    }                                                                                             \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                \
+  do {                                                                                            \
+    long long actual_ = (long long) (actual);                                                     \
+    long long expected_ = (long long) (expected);                                                 \
+    if (actual_ != expected_) {                                                                   \
+      fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, actual_, \
+              expected_);                                                                         \
+      exit(EXIT_FAILURE);                                                                         \
+    }                                                                                             \
+  } while (0)
+
+#define RUN(test)                                                                                 \
+  do {                                                                                            \
+    test();                                                                                       \
+    printf("ok %s\n", #test);                                                                     \
+  } while (0)
+
+#endif
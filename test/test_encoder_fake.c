@@ -0,0 +1,74 @@
+#include "drivers/encoder_fake.h"
+#include "host_test.h"
+
+static void test_4x_counts_every_edge(void) {
+  encoder_fake_t fake;
+  encoder_fake_init(&fake, ENCODER_FAKE_RESOLUTION_4X);
+
+  CHECK_EQ(encoder_fake_move(&fake, 10), 10);
+  CHECK_EQ(encoder_fake_move(&fake, -3), -3);
+  CHECK_EQ(fake.count, 7);
+  CHECK_EQ(fake.illegal_transitions, 0);
+}
+
+static void test_1x_counts_falling_edges_of_a(void) {
+  encoder_fake_t fake;
+  encoder_fake_init(&fake, ENCODER_FAKE_RESOLUTION_1X);
+
+  CHECK_EQ(encoder_fake_move(&fake, 40), 10);
+  CHECK_EQ(encoder_fake_move(&fake, -20), -5);
+  CHECK_EQ(fake.count, 5);
+}
+
+// At 4x jitter across one edge cancels out. At 1x every fall of A counts in the direction B
+// gives, so jitter on that edge accumulates; that is the GPIO backend's behaviour too.
+static void test_jitter_on_an_edge(void) {
+  encoder_fake_t fake;
+  encoder_fake_init(&fake, ENCODER_FAKE_RESOLUTION_4X);
+
+  for (int i = 0; i < 100; i++) {
+    encoder_fake_move(&fake, 1);
+    encoder_fake_move(&fake, -1);
+  }
+  CHECK_EQ(fake.count, 0);
+
+  encoder_fake_init(&fake, ENCODER_FAKE_RESOLUTION_1X);
+  encoder_fake_move(&fake, 2); // one edge before A falls
+  for (int i = 0; i < 100; i++) {
+    encoder_fake_move(&fake, 1);
+    encoder_fake_move(&fake, -1);
+  }
+  CHECK_EQ(fake.count, 100); // A falls once per wiggle; rising back never counts
+}
+
+static void test_both_channels_flipping_is_illegal(void) {
+  encoder_fake_t fake;
+  encoder_fake_init(&fake, ENCODER_FAKE_RESOLUTION_4X);
+
+  encoder_fake_move(&fake, 5);
+  CHECK_EQ(encoder_fake_glitch(&fake), 0);
+  CHECK_EQ(fake.count, 5);
+  CHECK_EQ(fake.illegal_transitions, 1);
+
+  // Decoding resumes from the new levels
+  CHECK_EQ(encoder_fake_move(&fake, 4), 4);
+  CHECK_EQ(fake.illegal_transitions, 1);
+}
+
+static void test_table_matches_1x_direction(void) {
+  // Forward at 4x is also forward at 1x: A falling with B high
+  CHECK_EQ(quadrature_decode_4x(0x3, 0x1), 1);
+  CHECK_EQ(quadrature_decode_1x(0x3, 0x1), 1);
+  CHECK_EQ(quadrature_decode_4x(0x2, 0x0), -1);
+  CHECK_EQ(quadrature_decode_1x(0x2, 0x0), -1);
+  CHECK_EQ(quadrature_decode_1x(0x1, 0x3), 0);
+}
+
+int main(void) {
+  RUN(test_4x_counts_every_edge);
+  RUN(test_1x_counts_falling_edges_of_a);
+  RUN(test_jitter_on_an_edge);
+  RUN(test_both_channels_flipping_is_illegal);
+  RUN(test_table_matches_1x_direction);
+  return EXIT_SUCCESS;
+}
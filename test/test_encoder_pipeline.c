@@ -0,0 +1,157 @@
+#include "drivers/encoder_fake.h"
+#include "encoder.h"
+#include "host_test.h"
+#include "rep_counter.h"
+
+/*
+ * Simulated motion from the fake encoder through the path the device runs: samples into
+ * encoder_consume_sample() (calibration, calibrated position, velocity), its events into
+ * rep_counter_check(). Encoder ids double as rep counter sides.
+ */
+
+#define SAMPLE_MS 5
+#define STROKE_EDGES 4000
+
+typedef struct {
+  encoder_t encoders[REP_SIDE_COUNT];
+  encoder_fake_t fakes[REP_SIDE_COUNT];
+  rep_counter_t counter;
+  int64_t now_us;
+  int reps;
+  int stops;
+  rep_record_t last;
+} pipeline_t;
+
+static pipeline_t pipeline;
+
+static void on_event(encoder_event_t *event) {
+  if (event->type != EVENT_SAMPLE) return;
+  rep_record_t record;
+  if (rep_counter_check(&pipeline.counter, (rep_side_t) event->source->id, event->calibrated,
+                        event->velocity, event->timestamp_us, event->source->state.cal_state,
+                        &record)) {
+    pipeline.reps++;
+    if (record.stop_set) pipeline.stops++;
+    pipeline.last = record;
+  }
+}
+
+static void pipeline_init(int resolution, double velocity_loss) {
+  // A fresh counter per test; the shim's mutex and timer are never released
+  rep_counter_init(&pipeline.counter, NULL);
+  for (int side = 0; side < REP_SIDE_COUNT; side++) {
+    encoder_t *enc = &pipeline.encoders[side];
+    *enc = (encoder_t) {.id = (uint8_t) side};
+    enc->config.resolution = resolution;
+    enc->config.calibration_debounce_steps = 8;
+    enc->config.on_event_cb = on_event;
+    enc->state.resolution = resolution;
+    encoder_fake_init(&pipeline.fakes[side], resolution == ENCODER_RESOLUTION_4X
+                                               ? ENCODER_FAKE_RESOLUTION_4X
+                                               : ENCODER_FAKE_RESOLUTION_1X);
+    rep_counter_set_threshold(&pipeline.counter, (rep_side_t) side, 80.0, 10.0, velocity_loss);
+  }
+  pipeline.now_us = 0;
+  pipeline.reps = 0;
+  pipeline.stops = 0;
+}
+
+// Moves one side's shaft and hands the decoded count to the service task's sample path
+static void pipeline_move_to(rep_side_t side, int32_t position) {
+  pipeline.now_us += SAMPLE_MS * 1000;
+  encoder_fake_move_to(&pipeline.fakes[side], position);
+  encoder_consume_sample(&pipeline.encoders[side], (uint32_t) pipeline.now_us,
+                         pipeline.fakes[side].count);
+}
+
+static void pipeline_rep(rep_side_t side, uint32_t up_ms) {
+  encoder_fake_rep_t rep = encoder_fake_default_rep;
+  rep.stroke_edges = STROKE_EDGES;
+  rep.up_ms = up_ms;
+  for (uint32_t ms = 0; ms <= encoder_fake_rep_ms(&rep); ms += SAMPLE_MS) {
+    pipeline_move_to(side, encoder_fake_rep_position(&rep, ms));
+  }
+}
+
+static void test_first_rep_calibrates(void) {
+  pipeline_init(ENCODER_RESOLUTION_4X, 0);
+  encoder_t *enc = &pipeline.encoders[REP_SIDE_LEFT];
+
+  pipeline_rep(REP_SIDE_LEFT, 800);
+  CHECK_EQ(enc->state.cal_state, CAL_DONE);
+  CHECK_EQ(enc->state.max_distance, STROKE_EDGES);
+  CHECK_EQ(enc->state.calibrated, CAL_MIN);
+
+  pipeline_move_to(REP_SIDE_LEFT, STROKE_EDGES / 2);
+  CHECK_EQ(enc->state.calibrated, Q16_FROM_INT(50));
+  pipeline_move_to(REP_SIDE_LEFT, STROKE_EDGES);
+  CHECK_EQ(enc->state.calibrated, CAL_MAX);
+  CHECK_EQ(enc->state.illegal_transitions, 0);
+}
+
+// The calibration rep only arms the counter; every rep after it is counted at the crossing
+static void test_reps_are_counted(void) {
+  pipeline_init(ENCODER_RESOLUTION_4X, 0);
+
+  for (int i = 0; i < 6; i++) pipeline_rep(REP_SIDE_LEFT, 800);
+  CHECK_EQ(pipeline.reps, 5);
+  CHECK_EQ(pipeline.last.side, REP_SIDE_LEFT);
+  CHECK(pipeline.last.rom >= Q16_FROM_INT(80) && pipeline.last.rom <= Q16_FROM_INT(81));
+  // 100 % in 800 ms
+  CHECK(pipeline.last.mean_velocity >= Q16_FROM_INT(120) &&
+        pipeline.last.mean_velocity <= Q16_FROM_INT(130));
+  CHECK(pipeline.last.peak_velocity >= Q16_FROM_INT(110) &&
+        pipeline.last.peak_velocity <= Q16_FROM_INT(140));
+}
+
+static void test_1x_resolution(void) {
+  pipeline_init(ENCODER_RESOLUTION_1X, 0);
+
+  for (int i = 0; i < 3; i++) pipeline_rep(REP_SIDE_LEFT, 800);
+  CHECK_EQ(pipeline.encoders[REP_SIDE_LEFT].state.max_distance, STROKE_EDGES / 4);
+  CHECK_EQ(pipeline.reps, 2);
+}
+
+static void test_velocity_loss_stops_the_set_once(void) {
+  pipeline_init(ENCODER_RESOLUTION_4X, 20.0);
+
+  pipeline_rep(REP_SIDE_LEFT, 800); // calibration
+  static const uint32_t up_ms[] = {800, 820, 900, 1100, 1200};
+  for (size_t i = 0; i < sizeof(up_ms) / sizeof(up_ms[0]); i++) {
+    pipeline_rep(REP_SIDE_LEFT, up_ms[i]);
+    // 800 / 1100 is the first rep more than 20 % slower than the best
+    CHECK_EQ(pipeline.stops, up_ms[i] >= 1100 ? 1 : 0);
+    if (up_ms[i] == 1100) CHECK(pipeline.last.stop_set);
+  }
+  CHECK_EQ(pipeline.reps, 5);
+}
+
+// A rep on the same side twice in a row is rejected and must leave the set untouched
+static void test_alternating_rejected_rep_is_not_measured(void) {
+  pipeline_init(ENCODER_RESOLUTION_4X, 20.0);
+  rep_counter_set_type(&pipeline.counter, EXERCISE_ALTERNATING);
+  pipeline_rep(REP_SIDE_LEFT, 800); // calibration
+  pipeline_rep(REP_SIDE_RIGHT, 800);
+
+  pipeline_rep(REP_SIDE_LEFT, 800);
+  CHECK_EQ(pipeline.reps, 1);
+  pipeline_rep(REP_SIDE_LEFT, 1200); // rejected
+  CHECK_EQ(pipeline.reps, 1);
+  CHECK_EQ(pipeline.stops, 0);
+
+  pipeline_rep(REP_SIDE_RIGHT, 800);
+  pipeline_rep(REP_SIDE_LEFT, 1200);
+  CHECK_EQ(pipeline.reps, 3);
+  CHECK_EQ(pipeline.stops, 1);
+  CHECK(pipeline.last.stop_set);
+  CHECK_EQ(pipeline.last.side, REP_SIDE_LEFT);
+}
+
+int main(void) {
+  RUN(test_first_rep_calibrates);
+  RUN(test_reps_are_counted);
+  RUN(test_1x_resolution);
+  RUN(test_velocity_loss_stops_the_set_once);
+  RUN(test_alternating_rejected_rep_is_not_measured);
+  return EXIT_SUCCESS;
+}
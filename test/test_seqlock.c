@@ -0,0 +1,98 @@
+#include <pthread.h>
+#include <stdint.h>
+
+#include "encoder.h"
+#include "host_test.h"
+
+/*
+ * One writer keeps rewriting an encoder's state inside encoder_write_begin()/encoder_write_end(),
+ * as the service task does, with every field derived from one generation counter. Readers take
+ * snapshots through encoder_snapshot() and check every snapshot is self-consistent and never
+ * older than the previous one. z_seen and illegal_transitions are written outside the seqlock and
+ * are left alone.
+ */
+
+#define WRITES 2000000
+#define READERS 3
+
+static encoder_t enc;
+static atomic_bool writer_done;
+
+static void state_fill(encoder_state_t *state, uint32_t generation) {
+  state->raw_count = (int32_t) generation;
+  state->offset = -(int32_t) (generation * 3u);
+  state->last_time = generation * 1000u;
+  state->cal_state = (calibration_state_t) (generation % 3);
+  state->cal_dir = generation & 1 ? DIR_POSITIVE : DIR_NEGATIVE;
+  state->start_count = (int32_t) (generation * 5u);
+  state->max_distance = (int32_t) (generation * 7u);
+  state->reverse_accum = (int32_t) (generation % 11);
+  state->resolution = (int32_t) (generation % 4);
+  state->calibrated = (q16_t) (generation * 13u);
+  state->velocity = -(q16_t) (generation * 17u);
+  state->acceleration = (q16_t) (generation ^ 0x5a5a5a5au);
+}
+
+static bool state_consistent(const encoder_state_t *state) {
+  encoder_state_t expected = {0};
+  state_fill(&expected, (uint32_t) state->raw_count);
+  return state->offset == expected.offset && state->last_time == expected.last_time &&
+         state->cal_state == expected.cal_state && state->cal_dir == expected.cal_dir &&
+         state->start_count == expected.start_count &&
+         state->max_distance == expected.max_distance &&
+         state->reverse_accum == expected.reverse_accum &&
+         state->resolution == expected.resolution && state->calibrated == expected.calibrated &&
+         state->velocity == expected.velocity && state->acceleration == expected.acceleration;
+}
+
+static void *writer(void *arg) {
+  (void) arg;
+  for (uint32_t generation = 1; generation <= WRITES; generation++) {
+    encoder_write_begin(&enc);
+    state_fill(&enc.state, generation);
+    encoder_write_end(&enc);
+  }
+  atomic_store(&writer_done, true);
+  return NULL;
+}
+
+static void *reader(void *arg) {
+  unsigned long *snapshots = arg;
+  int32_t previous = 0;
+
+  while (!atomic_load(&writer_done)) {
+    encoder_state_t snapshot;
+    encoder_snapshot(&enc, &snapshot);
+    CHECK(state_consistent(&snapshot));
+    CHECK(snapshot.raw_count >= previous);
+    previous = snapshot.raw_count;
+    (*snapshots)++;
+  }
+  return NULL;
+}
+
+static void test_snapshots_are_consistent(void) {
+  state_fill(&enc.state, 0);
+
+  pthread_t readers[READERS];
+  unsigned long snapshots[READERS] = {0};
+  for (int i = 0; i < READERS; i++) {
+    CHECK_EQ(pthread_create(&readers[i], NULL, reader, &snapshots[i]), 0);
+  }
+  pthread_t writer_thread;
+  CHECK_EQ(pthread_create(&writer_thread, NULL, writer, NULL), 0);
+
+  pthread_join(writer_thread, NULL);
+  for (int i = 0; i < READERS; i++) {
+    pthread_join(readers[i], NULL);
+    CHECK(snapshots[i] > 0);
+    printf("reader %d: %lu snapshots\n", i, snapshots[i]);
+  }
+  CHECK_EQ(atomic_load(&enc.seq), 2u * WRITES);
+  CHECK_EQ(enc.state.raw_count, WRITES);
+}
+
+int main(void) {
+  RUN(test_snapshots_are_consistent);
+  return EXIT_SUCCESS;
+}